@@ -40,7 +40,14 @@ namespace helper
     void GLClearError();
     bool GLLogCall(const char* fnName, const char* fileName, int line);
 
+    // decode + upload, main thread only
     void loadTexture(const char* path, GLuint& texture);
+    // file -> pixels, no GL calls so it can run on any thread. free with freeTextureImageData
+    bool decodeTexture(const char* path, TextureImageData& data);
+    // pixels -> mipmapped GL texture, needs the context
+    void uploadTexture(const TextureImageData& data, GLuint& texture);
     void freeTextureImageData(TextureImageData& data);
     int getMipmapLevels(int w, int h);
+    // in the current context's extension list
+    bool hasExtension(const char* name);
 }
@@ -15,6 +15,7 @@
 #include <cstdlib>
 #include <cstdio>
 #include <cmath>
+#include <cstring>
 
 static std::string readShader(const std::string& path)
 {
@@ -251,19 +252,31 @@ bool helper::GLLogCall(const char* fnName, const char* fileName, int line)
 }
 
 void helper::loadTexture(const char* path, GLuint& texture)
+{
+    helper::TextureImageData data;
+    if (!helper::decodeTexture(path, data))
+        return;
+
+    helper::uploadTexture(data, texture);
+    helper::freeTextureImageData(data);
+}
+
+bool helper::decodeTexture(const char* path, helper::TextureImageData& data)
 {
     // stbi_set_flip_vertically_on_load(true);
-    int w, h, ch;
-    unsigned char* data = stbi_load(path, &w, &h, &ch, 0);
-    if (!data)
+    data.data = stbi_load(path, &data.width, &data.height, &data.channels, 0);
+    if (!data.data)
     {
-        std::cerr << "Failed to load texture1 file." << std::endl;
-        stbi_image_free(data);
-        return;
+        fmt::print(stderr, "[TEXTURE-ERROR] Failed to load {}\n", path);
+        return false;
     }
 
     fmt::print("[TEXTURE-INFO] Successfully loaded {}\n", path);
+    return true;
+}
 
+void helper::uploadTexture(const helper::TextureImageData& data, GLuint& texture)
+{
     glGenTextures(1, &texture);
     glBindTexture(GL_TEXTURE_2D, texture);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
@@ -271,13 +284,21 @@ void helper::loadTexture(const char* path, GLuint& texture)
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-    GLenum pixelFormat = ch == 3 ? GL_RGB : GL_RGBA;
-    if (data)
+    // immutable storage sized by the channels in the file, grey reads back as r,r,r(,a)
+    const GLenum internalFormats[] = { GL_R8, GL_RG8, GL_RGB8, GL_RGBA8 };
+    const GLenum pixelFormats[] = { GL_RED, GL_RG, GL_RGB, GL_RGBA };
+    int channel = data.channels - 1;
+    glTexStorage2D(GL_TEXTURE_2D, helper::getMipmapLevels(data.width, data.height), internalFormats[channel], data.width, data.height);
+    if (data.channels <= 2)
     {
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, w, h, 0, pixelFormat, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
+        GLint swizzle[4] = { GL_RED, GL_RED, GL_RED, data.channels == 2 ? GL_GREEN : GL_ONE };
+        glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
     }
-    stbi_image_free(data);
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, data.width, data.height, pixelFormats[channel], GL_UNSIGNED_BYTE, data.data);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glGenerateMipmap(GL_TEXTURE_2D);
 }
 
 void helper::freeTextureImageData(helper::TextureImageData& data)
@@ -294,4 +315,17 @@ int helper::getMipmapLevels(int w, int h)
 {
     float bigger = static_cast<float>(w > h ? w : h);
     return static_cast<int>(std::log2f(bigger)) + 1;
+}
+
+bool helper::hasExtension(const char* name)
+{
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (GLint i = 0; i < count; i++)
+    {
+        const char* extension = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i));
+        if (extension != nullptr && std::strcmp(extension, name) == 0)
+            return true;
+    }
+    return false;
 }
\ No newline at end of file
@@ -14,6 +14,8 @@
 #include <glm/gtc/type_ptr.hpp>
 
 #include <string>
+#include <algorithm>
+#include <random>
 #include <functional>
 #include <iostream>
 
@@ -21,6 +23,20 @@
 #include "Model.h"
 #include "Shader.h"
 #include "Camera.h"
+#include "TransformBuffer.h"
+#include "SceneGraph.h"
+#include "EntityStore.h"
+#include "Frustum.h"
+#include "ThreadPool.h"
+#include "OcclusionCuller.h"
+#include "OcclusionQueries.h"
+#include "DepthPrepass.h"
+#include "ClusteredLighting.h"
+#include "ShadowAtlas.h"
+#include "GpuDrivenRenderer.h"
+#include "ImpostorRenderer.h"
+#include "VertexPool.h"
+#include "TextureUploader.h"
 
 App::App(int w, int h)
 {
@@ -98,6 +114,10 @@ App::App(int w, int h)
 
 App::~App()
 {
+    // models hand their textures back while the context is still current
+    mModels.clear();
+    mTextureRegistry.reset();
+
     glfwDestroyWindow(mWindow);
     glfwTerminate();
 }
@@ -108,7 +128,16 @@ void App::Run()
     mShader->AddShader(GL_VERTEX_SHADER, "resources/shader.vert");
     mShader->AddShader(GL_FRAGMENT_SHADER, "resources/shader.frag");
     mShader->Link();
-    mShader->SetInt("shadowMap", 0);
+    mFeedbackShader = std::make_unique<Shader>();
+    mFeedbackShader->AddShader(GL_VERTEX_SHADER, "resources/shader.vert");
+    mFeedbackShader->AddShader(GL_FRAGMENT_SHADER, "resources/shader.frag", "#define TEXTURE_FEEDBACK\n");
+    mFeedbackShader->Link();
+    for (Shader* shader : { mShader.get(), mFeedbackShader.get() })
+    {
+        shader->SetInt("shadowMap", 0);
+        // GpuDrivenRenderer's unit, must not share unit 0 with the 2D shadow atlas even when unused
+        shader->SetInt("materialLayers", 14);
+    }
 
     mDrawLightCubeShader = std::make_unique<Shader>();
     mDrawLightCubeShader->AddShader(GL_VERTEX_SHADER, "resources/lightcube.vert");
@@ -127,6 +156,29 @@ void App::Run()
     mDepthShader->Link();
 
 
+    mThreadPool = std::make_unique<ThreadPool>();
+    mOcclusionCuller = std::make_unique<OcclusionCuller>();
+    mOcclusionQueries = std::make_unique<OcclusionQueries>();
+    mDepthPrepass = std::make_unique<DepthPrepass>();
+    // bindings 1-3, binding 0 is the TransformBuffer
+    mClusteredLighting = std::make_unique<ClusteredLighting>(1, 2, 3);
+    mShadowAtlas = std::make_unique<ShadowAtlas>(4);
+    // bindings 5-9
+    mGpuDriven = std::make_unique<GpuDrivenRenderer>(5);
+    // binding 10
+    mImpostors = std::make_unique<ImpostorRenderer>(10);
+    // bindings 11-12
+    mVertexPool = std::make_unique<VertexPool>(11, 12);
+    mTextureUploader = std::make_unique<TextureUploader>(*mThreadPool);
+    mTextureUploader->SetMaxSize(mTextureMaxSize);
+    // binding 13
+    mTextureFeedback = std::make_unique<TextureFeedback>(13);
+    mTextureResidency = std::make_unique<TextureResidency>(*mTextureUploader, mTextureBudget, mTextureFeedback->GetCapacity());
+    mTextureRegistry = std::make_unique<TextureRegistry>(*mThreadPool, *mTextureUploader, *mTextureResidency);
+    mMaterialArrays = std::make_unique<MaterialArrays>(*mTextureUploader, *mTextureResidency);
+    // binding 14
+    mBindlessMaterials = std::make_unique<BindlessMaterials>(14);
+
     LoadData();
 
     mCamera = std::make_shared<Camera>(mScreenWidth, mScreenHeight);
@@ -214,26 +266,6 @@ void App::Run()
     int nbFrames = 0;
     // ------------------------------------
 
-    const GLuint SHADOW_W = 1024, SHADOW_H = 1024;
-    GLuint depthMap = 0;
-    glGenTextures(1, &depthMap);
-    glBindTexture(GL_TEXTURE_2D, depthMap);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT, SHADOW_W, SHADOW_H, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
-    float borderColor[] = { 1.0f, 1.0f, 1.0f, 1.0f };
-    glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, borderColor);
-
-    GLuint depthMapFBO = 0;
-    glGenFramebuffers(1, &depthMapFBO);
-    glBindFramebuffer(GL_FRAMEBUFFER, depthMapFBO);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthMap, 0);
-    glDrawBuffer(GL_NONE);
-    glReadBuffer(GL_NONE);
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
     // ImGUI stuffs
     // ------------------------------------
     IMGUI_CHECKVERSION();
@@ -311,6 +343,7 @@ void App::Run()
         static float colors[3] = { 0.5f, 0.5f, 0.5f };
         static float planes[2] = { 1.0f, 20.0f };
         static float size = 10.0f;
+        static float shadowBudget = 6.0f;  // million texels rendered per frame
         {
             if (ImGui::TreeNode("Light Settings"))
             {
@@ -326,6 +359,9 @@ void App::Run()
                 ImGui::Text("Ortho Size");
                 ImGui::SliderFloat("##Ortho Size", &size, 1.0f, 100.0f, "%.2f", ImGuiSliderFlags_AlwaysClamp);
 
+                ImGui::Text("Shadow Budget (Mtexels/frame)");
+                ImGui::SliderFloat("##Shadow Budget", &shadowBudget, 0.25f, 16.0f, "%.2f", ImGuiSliderFlags_AlwaysClamp | ImGuiSliderFlags_Logarithmic);
+
                 ImGui::Text("Light Color");
                 ImGui::ColorPicker3("##Light Color", colors);
                 ImGui::TreePop();
@@ -335,76 +371,464 @@ void App::Run()
         float& near_plane = planes[0];
         float& far_plane = planes[1];
         glm::mat4 lightSpaceMatrix;
-        // generate depthmap
+
+        // instanced copies of the necoarc model
+        {
+            static int instanceCount = 0;
+            static float instanceSpacing = 2.0f;
+            bool changed = false;
+            if (ImGui::TreeNode("Instancing"))
+            {
+                ImGui::Text("Instance Count");
+                changed |= ImGui::SliderInt("##Instance Count", &instanceCount, 0, 4096, "%d", ImGuiSliderFlags_AlwaysClamp | ImGuiSliderFlags_Logarithmic);
+                ImGui::Text("Spacing");
+                changed |= ImGui::SliderFloat("##Spacing", &instanceSpacing, 0.5f, 5.0f, "%.1f", ImGuiSliderFlags_AlwaysClamp);
+                ImGui::TreePop();
+            }
+            if (changed)
+                LayoutInstances(instanceCount, instanceSpacing);
+        }
+
+        // extra unshadowed lights, shaded through the light clusters
+        {
+            static int extraLightCount = 0;
+            if (ImGui::TreeNode("Lights"))
+            {
+                ImGui::Text("Extra Lights");
+                if (ImGui::SliderInt("##Extra Lights", &extraLightCount, 0, 1024, "%d", ImGuiSliderFlags_AlwaysClamp | ImGuiSliderFlags_Logarithmic))
+                    SpawnLights(extraLightCount);
+                ImGui::TreePop();
+            }
+        }
+
+        // screen-space error budget of the LOD chains, shadow tiles use coarser levels
+        static float lodThreshold = 1.0f;  // pixels
+        static int shadowLodBias = 1;
+        // distant instanced copies become impostors, crossfading over "impostorFade" units
+        static bool impostors = true;
+        static float impostorDistance = 25.0f;
+        static float impostorFade = 5.0f;
+        {
+            if (ImGui::TreeNode("Level of Detail"))
+            {
+                ImGui::Text("Error Threshold (px)");
+                ImGui::SliderFloat("##LOD Error Threshold", &lodThreshold, 0.1f, 16.0f, "%.1f", ImGuiSliderFlags_AlwaysClamp | ImGuiSliderFlags_Logarithmic);
+                ImGui::Text("Shadow LOD Bias");
+                ImGui::SliderInt("##Shadow LOD Bias", &shadowLodBias, 0, 3, "%d", ImGuiSliderFlags_AlwaysClamp);
+                ImGui::Checkbox("Impostors", &impostors);
+                ImGui::Text("Impostor Distance");
+                ImGui::SliderFloat("##Impostor Distance", &impostorDistance, 2.0f, 200.0f, "%.1f", ImGuiSliderFlags_AlwaysClamp | ImGuiSliderFlags_Logarithmic);
+                ImGui::Text("Crossfade Width");
+                ImGui::SliderFloat("##Crossfade Width", &impostorFade, 0.0f, 20.0f, "%.1f", ImGuiSliderFlags_AlwaysClamp);
+                ImGui::TreePop();
+            }
+        }
+
+        // attribute fetch or vertex pulling, switched per frame for every pass
+        static bool benchmarkVertexFetch = false;
+        static float vertexFetchMs[3] = {};
+        {
+            static int vertexFetch = static_cast<int>(VertexFetch::Attributes);
+            if (ImGui::TreeNode("Vertex Fetch"))
+            {
+                ImGui::Combo("##Vertex Fetch", &vertexFetch, "Attributes\0Pulled\0Pulled quantized\0");
+                ImGui::Text("%d vertices: %d KB float, %d KB quantized",
+                    static_cast<int>(mVertexPool->GetVertexCount()),
+                    static_cast<int>(mVertexPool->GetFloatBytes() / 1024),
+                    static_cast<int>(mVertexPool->GetQuantizedBytes() / 1024));
+                benchmarkVertexFetch = ImGui::Button("Benchmark");
+                ImGui::SameLine();
+                ImGui::Text("%.3f / %.3f / %.3f ms", vertexFetchMs[0], vertexFetchMs[1], vertexFetchMs[2]);
+                ImGui::TreePop();
+            }
+            mVertexPool->SetFetch(static_cast<VertexFetch>(vertexFetch));
+        }
+
+        // texture residency, trimmed to the budget before anything is drawn
+        {
+            static int textureBudgetMB = static_cast<int>(mTextureBudget / (1024 * 1024));
+            if (ImGui::TreeNode("Texture Memory"))
+            {
+                ImGui::Text("Budget (MB)");
+                ImGui::SliderInt("##Texture Budget", &textureBudgetMB, 1, 4096, "%d", ImGuiSliderFlags_AlwaysClamp | ImGuiSliderFlags_Logarithmic);
+                ImGui::TreePop();
+            }
+            mTextureResidency->SetBudget(static_cast<size_t>(textureBudgetMB) * 1024 * 1024);
+            // the mip levels shader.frag asked for a few frames ago
+            if (mTextureFeedback->Update(mFeedbackShader->GetId(), mTextureFeedbackLevels))
+                mTextureResidency->ApplyFeedback(mTextureFeedbackLevels);
+            mTextureResidency->SetFeedbackActive(mTextureFeedbackDrawn);
+            mTextureResidency->Update();
+
+            static bool bindless = false;
+            if (mBindlessMaterials->IsSupported())
+                ImGui::Checkbox("Bindless Textures", &bindless);
+            mBindlessMaterials->SetEnabled(bindless);
+            // handles for what the residency swapped just now
+            mBindlessMaterials->Update();
+            if (bindless)
+            {
+                ImGui::Text("Bindless: %d materials, %d handles made resident",
+                    static_cast<int>(mBindlessMaterials->GetMaterialCount()), static_cast<int>(mBindlessMaterials->GetHandleCount()));
+            }
+
+            ImGui::Text("Textures: %.1f / %d MB, %d resident, %d reduced",
+                mTextureResidency->GetUsedBytes() / (1024.0f * 1024.0f), textureBudgetMB,
+                static_cast<int>(mTextureResidency->GetTextureCount()), static_cast<int>(mTextureResidency->GetReducedCount()));
+            ImGui::Text("Texture memory saved over RGBA8: %.1f MB",
+                (mTextureResidency->GetRgba8Bytes() - mTextureResidency->GetUsedBytes()) / (1024.0f * 1024.0f));
+            ImGui::Text("Texture downgrades: %d, restores: %d, feedback latency: %d frames",
+                static_cast<int>(mTextureResidency->GetDowngradeCount()), static_cast<int>(mTextureResidency->GetRestoreCount()),
+                static_cast<int>(mTextureFeedback->GetLatency()));
+        }
+
+        // world/normal matrices, computed once per object per frame
+        {
+            glm::mat4 model = glm::mat4(1.0);
+            model = glm::rotate(model, glm::radians(modelRotation), glm::vec3(0.0, 1.0, 0.0));
+            SetModelPlacement(*mEntities.GetModel(mNecoarcEntity), mEntities.GetNode(mNecoarcEntity), model);
+
+            model = glm::mat4(1.0f);
+            model = glm::translate(model, glm::make_vec3(lightPositionFloat));
+            model = glm::scale(model, glm::vec3(cubeSize));
+            SetModelPlacement(*mEntities.GetModel(mLightEntity), mEntities.GetNode(mLightEntity), model);
+            mEntities.SetLight(mLightEntity, glm::make_vec3(colors), far_plane);
+
+            // only dirty subtrees are recomputed and re-uploaded
+            mScene.Update();
+            mTransforms->Resize(mScene.GetCount());
+            for (size_t i = mScene.GetChangedBegin(); i < mScene.GetChangedEnd(); i++)
+            {
+                GLuint node = static_cast<GLuint>(i);
+                if (mScene.IsChanged(node))
+                    mTransforms->Set(node, mScene.GetWorld(node));
+            }
+
+            mTransforms->Update();
+            mTransforms->Bind();
+
+            mEntities.UpdateBounds(mScene);
+            mEntities.SelectLods(mScene, camPos, mScreenHeight * mProjection[1][1] * 0.5f, lodThreshold);
+        }
+
+        // shadow atlas tiles due this frame
         {
+            // shadowed point lights look at the scene origin
             glm::mat4 lightProjection, lightView;
             lightProjection = glm::ortho(-size, size, -size, size, near_plane, far_plane);
             lightView = glm::lookAt(glm::make_vec3(lightPositionFloat), glm::vec3(0.0f), glm::vec3(0.0, 1.0, 0.0));
             lightSpaceMatrix = lightProjection * lightView;
 
-            // render scene from light's point of view
-            mDepthShader->SetUniformMat4("lightSpaceMatrix", lightSpaceMatrix);
-            mShader->SetUniformMat4("lightSpaceMatrix", lightSpaceMatrix);
+            BuildShadowRequests(lightSpaceMatrix, mShadowRequests);
+            mShadowAtlas->SetBudget(static_cast<uint64_t>(shadowBudget * 1000000.0f));
+            mShadowAtlas->Update(mShadowRequests, mShadowUpdates);
 
-            glViewport(0, 0, SHADOW_W, SHADOW_H);
-            glBindFramebuffer(GL_FRAMEBUFFER, depthMapFBO);
             // glCullFace(GL_FRONT);
-            glClear(GL_DEPTH_BUFFER_BIT);
-
             GLuint shaderId = mDepthShader->GetId();
+            for (const ShadowUpdate& update : mShadowUpdates)
+            {
+                // render scene from light's point of view
+                mDepthShader->SetUniformMat4("viewProjection", update.viewProjection);
+                mShadowAtlas->BeginTile(update);
 
-            glm::mat4 model = glm::mat4(1.0);
-            model = glm::rotate(model, glm::radians(modelRotation), glm::vec3(0.0, 1.0, 0.0));
-            mDepthShader->SetUniformMat4("model", model);
-            mModel->Draw(shaderId);
-
-            model = glm::mat4(1.0);
-            mDepthShader->SetUniformMat4("model", model);
-            mFloorModel->Draw(shaderId);
-
-            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+                mEntities.BuildDrawList(Frustum(update.viewProjection), RenderFlag_CastsShadow, RenderFlag_Emissive, mDrawList);
+                for (const DrawItem& item : mDrawList)
+                    item.model->DrawDepth(shaderId, item.baseObject, item.instanceCount, item.lod + shadowLodBias);
+            }
+            mShadowAtlas->EndTiles(mScreenWidth, mScreenHeight);
+            mShadowAtlas->Bind();
             // glCullFace(GL_BACK);
+
+            ImGui::Text("Shadow tiles: %d, atlas used: %.0f%%, updated: %d",
+                static_cast<int>(mShadowAtlas->GetTileCount()),
+                100.0f * mShadowAtlas->GetAllocatedTexels() / (static_cast<float>(mShadowAtlas->GetSize()) * mShadowAtlas->GetSize()),
+                static_cast<int>(mShadowAtlas->GetUpdateCount()));
         }
 
-        glViewport(0, 0, mScreenWidth, mScreenHeight);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
         if (!mIsDepthShaderDebugMode)
         {
             glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, depthMap);
+            glBindTexture(GL_TEXTURE_2D, mShadowAtlas->GetTexture());
+
+            mShader->SetFloat3("lightColor", colors);
+            mFeedbackShader->SetFloat3("lightColor", colors);
+            mDrawLightCubeShader->SetFloat3("lightColor", colors);
+            mImpostors->GetShader().SetFloat3("lightColor", colors);
+
+            mClusteredLighting->Update(mView, mEntities, mShadowAtlas->GetShadowSlots(), *mThreadPool);
+            mClusteredLighting->Bind();
+            mClusteredLighting->SetShaderUniforms(*mShader, mScreenWidth, mScreenHeight);
+            mClusteredLighting->SetShaderUniforms(*mFeedbackShader, mScreenWidth, mScreenHeight);
+            mClusteredLighting->SetShaderUniforms(mImpostors->GetShader(), mScreenWidth, mScreenHeight);
+            ImGui::Text("Lights: %d, cluster entries: %d, max per cluster: %d, assign %.2f ms",
+                static_cast<int>(mClusteredLighting->GetLightCount()),
+                static_cast<int>(mClusteredLighting->GetIndexCount()),
+                static_cast<int>(mClusteredLighting->GetMaxLightsPerCluster()),
+                mClusteredLighting->GetAssignMs());
+
+            Frustum cameraFrustum(mProjection * mView);
+            size_t drawnCount = 0;
+
+            static int occlusionMode = 1;
+            ImGui::Combo("Occlusion Culling", &occlusionMode, "Off\0CPU depth buffer\0GPU queries\0");
+
+            static int prepassMode = static_cast<int>(DepthPrepassMode::Auto);
+            ImGui::Combo("Depth Pre-pass", &prepassMode, "Off\0On\0Auto\0");
+
+            static bool meshletCulling = true;
+            ImGui::Checkbox("Meshlet Culling", &meshletCulling);
+
+            static bool gpuDriven = mValidateGpuDriven;
+            static bool hiZOcclusion = true;
+            static bool materialArrays = false;
+            ImGui::Checkbox("GPU-driven Draws", &gpuDriven);
+            if (gpuDriven)
+            {
+                ImGui::SameLine();
+                ImGui::Checkbox("Hi-Z Occlusion", &hiZOcclusion);
+                ImGui::SameLine();
+                ImGui::Checkbox("Material Arrays", &materialArrays);
+            }
 
             GLuint shaderId = mShader->GetId();
+            if (gpuDriven)
+            {
+                // objects, culling and draw commands stay on the GPU
+                if (materialArrays && !mMaterialArrays->IsBuilt())
+                    mMaterialArrays->Build();
+                mGpuDriven->SetMaterialArrays(materialArrays ? mMaterialArrays.get() : nullptr);
+                mGpuDriven->UpdateObjects(mEntities, RenderFlag_None, RenderFlag_Emissive);
+                mGpuDriven->Cull(mProjection * mView, hiZOcclusion);
+                // nothing here discards, early tests are exact
+                mGpuDriven->Draw(mFeedbackShader->GetId());
+                mTextureFeedbackDrawn = true;
+                // the depth so far is next frame's occluder pyramid
+                if (hiZOcclusion)
+                    mGpuDriven->UpdateHiZ(mProjection * mView, mScreenWidth, mScreenHeight);
+                drawnCount += mGpuDriven->GetDrawnCount();
+
+                ImGui::Text("GPU objects: %d, drawn: %d, %d multi-draws for %d meshes (%s)",
+                    static_cast<int>(mGpuDriven->GetObjectCount()),
+                    static_cast<int>(mGpuDriven->GetDrawnCount()),
+                    static_cast<int>(mGpuDriven->GetDrawCallCount()),
+                    static_cast<int>(mGpuDriven->GetBatchCount()),
+                    mGpuDriven->IsUsingIndirectCount() && !materialArrays ? "indirect count" : "zeroed commands");
+                if (materialArrays)
+                {
+                    ImGui::Text("Material arrays: %d layers in %d arrays, %.1f MB",
+                        static_cast<int>(mMaterialArrays->GetLayerCount()),
+                        static_cast<int>(mMaterialArrays->GetArrayCount()),
+                        mMaterialArrays->GetBytes() / (1024.0f * 1024.0f));
+                }
 
-            glm::mat4 model = glm::mat4(1.0);
-            model = glm::rotate(model, glm::radians(modelRotation), glm::vec3(0.0, 1.0, 0.0));
-            mShader->SetUniformMat4("model", model);
-            mModel->Draw(shaderId);
+                static int validationResult = -1;
+                if (ImGui::Button("Validate against CPU path") || mValidateGpuDriven)
+                {
+                    validationResult = static_cast<int>(ValidateGpuDriven(cameraFrustum));
+                    mGpuDrivenValidation = validationResult;
+                }
+                // started with --validate-gpu-driven: one frame is enough
+                if (mValidateGpuDriven)
+                {
+                    mValidateGpuDriven = false;
+                    glfwSetWindowShouldClose(mWindow, true);
+                }
+                if (validationResult >= 0)
+                {
+                    ImGui::SameLine();
+                    ImGui::Text("%d pixels differ", validationResult);
+                }
+            }
+            else
+            {
+                mEntities.BuildDrawList(cameraFrustum, RenderFlag_None, RenderFlag_Emissive, mDrawList);
+                if (occlusionMode == 1)
+                {
+                    RasterizeOccluders();
+
+                    mDrawList.erase(std::remove_if(mDrawList.begin(), mDrawList.end(),
+                                        [this](const DrawItem& item)
+                                        { return !mOcclusionCuller->IsVisible(item.boundsMin, item.boundsMax); }),
+                        mDrawList.end());
+
+                    ImGui::Text("Occluder tris: %d, tested: %d, culled: %d (%s)",
+                        static_cast<int>(mOcclusionCuller->GetOccluderTriangleCount()),
+                        static_cast<int>(mOcclusionCuller->GetTestedCount()),
+                        static_cast<int>(mOcclusionCuller->GetCulledCount()),
+                        mOcclusionCuller->IsUsingAVX2() ? "AVX2" : "scalar");
+                }
 
-            model = glm::mat4(1.0);
-            model = glm::scale(model, glm::vec3(3.0f));
-            mShader->SetUniformMat4("model", model);
-            mFloorModel->Draw(shaderId);
+                int lodHistogram[4] = {};
+                for (const DrawItem& item : mDrawList)
+                    lodHistogram[glm::min(item.lod, 3)]++;
+                ImGui::Text("LOD 0/1/2/3: %d/%d/%d/%d", lodHistogram[0], lodHistogram[1], lodHistogram[2], lodHistogram[3]);
 
-            mShader->SetUniformVec3("lightPos", glm::make_vec3(lightPositionFloat));
+                // GPU queries test boxes against the depth buffer, a full pre-pass depth would hide nothing.
+                // their queries also can't overlap the pre-pass sample counting
+                bool gpuQueries = occlusionMode == 2;
 
-            mShader->SetFloat3("lightColor", colors);
-            mDrawLightCubeShader->SetFloat3("lightColor", colors);
+                // frustum and back-face culling per meshlet, queried meshes need their whole draw
+                mMeshletLists.resize(mDrawList.size());
+                if (meshletCulling && !gpuQueries)
+                {
+                    mThreadPool->ParallelFor(mDrawList.size(), [this, &cameraFrustum, &camPos](size_t i)
+                        {
+                            const DrawItem& item = mDrawList[i];
+                            std::vector<MeshletDrawList>& lists = mMeshletLists[i];
+                            // instanced draws and coarser levels keep their regular draw
+                            if (item.instanceCount != 1 || item.lod != 0 || !item.model->HasMeshlets())
+                            {
+                                lists.clear();
+                                return;
+                            }
+                            item.model->CullMeshlets(mScene.GetWorld(item.baseObject), cameraFrustum, camPos, lists);
+                        });
+
+                    size_t meshletTriangles = 0, culledTriangles = 0;
+                    for (const std::vector<MeshletDrawList>& lists : mMeshletLists)
+                    {
+                        for (const MeshletDrawList& list : lists)
+                        {
+                            meshletTriangles += list.triangleCount;
+                            culledTriangles += list.culledTriangleCount;
+                        }
+                    }
+                    ImGui::Text("Meshlets: %.1f%% of %d triangles culled",
+                        meshletTriangles > 0 ? 100.0f * culledTriangles / meshletTriangles : 0.0f,
+                        static_cast<int>(meshletTriangles));
+                }
+                else
+                {
+                    for (std::vector<MeshletDrawList>& lists : mMeshletLists)
+                        lists.clear();
+                }
+                // queried items keep their whole group
+                if (impostors && !gpuQueries)
+                {
+                    mImpostors->Prepare(mDrawList, mScene, cameraFrustum, camPos, impostorDistance, impostorFade);
+                    ImGui::Text("Impostors: %d, mesh copies: %d",
+                        static_cast<int>(mImpostors->GetImpostorCount()),
+                        static_cast<int>(mImpostors->GetMeshCopyCount()));
+                }
+                else
+                {
+                    mImpostors->Clear(mDrawList.size());
+                }
 
-            model = glm::mat4(1.0f);
-            model = glm::translate(model, glm::make_vec3(lightPositionFloat));
-            model = glm::scale(model, glm::vec3(cubeSize));
+                mDepthPrepass->SetMode(gpuQueries ? DepthPrepassMode::Off : static_cast<DepthPrepassMode>(prepassMode));
+                if (mDepthPrepass->BeginFrame(!gpuQueries))
+                {
+                    // depth.vert with the camera matrix, position-only vertex stream
+                    mDepthPrepass->BeginPrepass();
+                    mDepthShader->SetUniformMat4("viewProjection", mProjection * mView);
+                    GLuint depthShaderId = mDepthShader->GetId();
+                    for (size_t i = 0; i < mDrawList.size(); i++)
+                    {
+                        const DrawItem& item = mDrawList[i];
+                        if (!mMeshletLists[i].empty())
+                            item.model->DrawMeshletsDepth(depthShaderId, item.baseObject, mMeshletLists[i]);
+                        else if (mImpostors->IsSplit(i))
+                            mImpostors->DrawMeshesDepth(depthShaderId, i);
+                        else
+                            item.model->DrawDepth(depthShaderId, item.baseObject, item.instanceCount, item.lod);
+                    }
+                    mDepthPrepass->EndPrepass();
+                }
+
+                mDepthPrepass->BeginMainPass();
+                // with the pre-pass depth in place early tests are exact, only visible fragments report mips.
+                // without it dithered copies discard after writing depth, no feedback and streamed textures go to full size
+                mTextureFeedbackDrawn = mDepthPrepass->IsEnabled();
+                if (mTextureFeedbackDrawn)
+                    shaderId = mFeedbackShader->GetId();
+                if (occlusionMode == 1)
+                {
+                    // single copies are also tested per mesh, unless their meshlets were culled already
+                    for (size_t i = 0; i < mDrawList.size(); i++)
+                    {
+                        const DrawItem& item = mDrawList[i];
+                        if (!mMeshletLists[i].empty())
+                            item.model->DrawMeshlets(shaderId, item.baseObject, mMeshletLists[i]);
+                        else if (mImpostors->IsSplit(i))
+                            mImpostors->DrawMeshes(shaderId, i);
+                        else if (item.instanceCount == 1)
+                            item.model->DrawVisible(shaderId, item.baseObject, mScene.GetWorld(item.baseObject), *mOcclusionCuller, item.lod);
+                        else
+                            item.model->Draw(shaderId, item.baseObject, item.instanceCount, item.lod);
+                    }
+                    drawnCount += mDrawList.size();
+                }
+                else if (occlusionMode == 2)
+                {
+                    static int requeryInterval = 4;
+                    ImGui::SliderInt("Requery Interval", &requeryInterval, 1, 16);
+                    mOcclusionQueries->SetRequeryInterval(requeryInterval);
+
+                    mOcclusionQueries->BeginFrame(mProjection * mView, camPos);
+                    for (const DrawItem& item : mDrawList)
+                    {
+                        item.model->Draw(shaderId, item.baseObject, item.instanceCount,
+                            mScene.GetWorld(item.baseObject), item.boundsMin, item.boundsMax,
+                            *mOcclusionQueries, item.lod);
+                    }
+                    mOcclusionQueries->EndFrame();
+                    drawnCount += mDrawList.size();
+
+                    int resolved = mOcclusionQueries->GetResolvedCount();
+                    ImGui::Text("Queries: %d issued, %d resolved, %.0f%% occluded",
+                        mOcclusionQueries->GetIssuedCount(), resolved,
+                        resolved > 0 ? 100.0f * mOcclusionQueries->GetOccludedCount() / resolved : 0.0f);
+                    ImGui::Text("Culled triangles: %d", static_cast<int>(mOcclusionQueries->GetCulledTriangleCount()));
+                }
+                else
+                {
+                    for (size_t i = 0; i < mDrawList.size(); i++)
+                    {
+                        const DrawItem& item = mDrawList[i];
+                        if (!mMeshletLists[i].empty())
+                            item.model->DrawMeshlets(shaderId, item.baseObject, mMeshletLists[i]);
+                        else if (mImpostors->IsSplit(i))
+                            mImpostors->DrawMeshes(shaderId, i);
+                        else
+                            item.model->Draw(shaderId, item.baseObject, item.instanceCount, item.lod);
+                    }
+                    drawnCount += mDrawList.size();
+                }
+                mDepthPrepass->EndMainPass();
+                shaderId = mShader->GetId();
 
-            mDrawLightCubeShader->Use();
-            mDrawLightCubeShader->SetUniformMat4("model", model);
-            mLightCubeModel->Draw(mDrawLightCubeShader->GetId());
+                // regular depth test again, impostors write their own depth
+                mImpostors->DrawFadingMeshes(shaderId);
+                mImpostors->DrawImpostors(mProjection * mView, camPos);
+
+                if (benchmarkVertexFetch)
+                    BenchmarkVertexFetch(vertexFetchMs);
+
+                if (!gpuQueries)
+                {
+                    ImGui::Text("Overdraw: %.2fx, pre-pass %s",
+                        mDepthPrepass->GetOverdraw(),
+                        mDepthPrepass->IsEnabled() ? "on" : "off");
+                }
+            }
+
+            // emissive objects (light cube) use their own shader
+            shaderId = mDrawLightCubeShader->GetId();
+            mEntities.BuildDrawList(cameraFrustum, RenderFlag_Emissive, RenderFlag_None, mDrawList);
+            for (const DrawItem& item : mDrawList)
+                item.model->Draw(shaderId, item.baseObject, item.instanceCount);
+            drawnCount += mDrawList.size();
+
+            ImGui::Text("Entities: %d, drawn: %d", static_cast<int>(mEntities.GetCount()), static_cast<int>(drawnCount));
         }
         else
         {
             mDebugDepthShader->SetFloat("near_plane", near_plane);
             mDebugDepthShader->SetFloat("far_plane", far_plane);
             glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, depthMap);
+            glBindTexture(GL_TEXTURE_2D, mShadowAtlas->GetTexture());
             {
                 static GLuint quadVAO = 0;
                 GLuint quadVBO;
@@ -474,11 +898,322 @@ void App::Run()
     }
 }
 
+void App::RasterizeOccluders()
+{
+    // occluders come from the current (frustum culled) draw list
+    mOcclusionCuller->BeginFrame(mProjection * mView);
+    for (const DrawItem& item : mDrawList)
+    {
+        if (!(item.flags & RenderFlag_Occluder) || item.instanceCount != 1)
+            continue;
+
+        const std::vector<glm::vec3>& positions = item.model->GetOccluderPositions();
+        const std::vector<GLuint>& indices = item.model->GetOccluderIndices();
+        mOcclusionCuller->AddOccluder(
+            positions.data(), positions.size(),
+            indices.data(), indices.size(),
+            mScene.GetWorld(item.baseObject));
+    }
+    mOcclusionCuller->Rasterize(*mThreadPool);
+}
+
+size_t App::ValidateGpuDriven(const Frustum& cameraFrustum)
+{
+    // both paths render the opaque pass at LOD 0 into the same offscreen target,
+    // on a deterministic (software) GL the two images have to be identical
+    GLuint framebuffer, color, depth;
+    glGenFramebuffers(1, &framebuffer);
+    glGenRenderbuffers(1, &color);
+    glGenRenderbuffers(1, &depth);
+    glBindRenderbuffer(GL_RENDERBUFFER, color);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, mScreenWidth, mScreenHeight);
+    glBindRenderbuffer(GL_RENDERBUFFER, depth);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, mScreenWidth, mScreenHeight);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth);
+
+    size_t pixelCount = static_cast<size_t>(mScreenWidth) * mScreenHeight;
+    std::vector<uint32_t> cpuPixels(pixelCount), gpuPixels(pixelCount);
+    GLuint shaderId = mShader->GetId();
+
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    mEntities.BuildDrawList(cameraFrustum, RenderFlag_None, RenderFlag_Emissive, mDrawList);
+    for (const DrawItem& item : mDrawList)
+        item.model->Draw(shaderId, item.baseObject, item.instanceCount);
+    glReadPixels(0, 0, mScreenWidth, mScreenHeight, GL_RGBA, GL_UNSIGNED_BYTE, cpuPixels.data());
+
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    mGpuDriven->UpdateObjects(mEntities, RenderFlag_None, RenderFlag_Emissive);
+    mGpuDriven->Cull(mProjection * mView, false);
+    mGpuDriven->Draw(shaderId);
+    glReadPixels(0, 0, mScreenWidth, mScreenHeight, GL_RGBA, GL_UNSIGNED_BYTE, gpuPixels.data());
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDeleteFramebuffers(1, &framebuffer);
+    glDeleteRenderbuffers(1, &color);
+    glDeleteRenderbuffers(1, &depth);
+
+    size_t differing = 0;
+    for (size_t i = 0; i < pixelCount; i++)
+        differing += cpuPixels[i] != gpuPixels[i] ? 1 : 0;
+
+    fmt::print("[GPU-DRIVEN] Validation: {} of {} pixels differ\n", differing, pixelCount);
+    return differing;
+}
+
+void App::BenchmarkVertexFetch(float* milliseconds)
+{
+    // redraws the opaque list on top of the finished frame: nearly every fragment fails the depth test,
+    // so the timings are dominated by vertex work. repeated to rise above the timer resolution
+    static constexpr int Repetitions = 16;
+
+    GLuint query;
+    glGenQueries(1, &query);
+    GLuint shaderId = mShader->GetId();
+    VertexFetch previous = mVertexPool->GetFetch();
+
+    const char* names[] = { "attributes", "pulled", "pulled quantized" };
+    for (int fetch = 0; fetch < 3; fetch++)
+    {
+        mVertexPool->SetFetch(static_cast<VertexFetch>(fetch));
+
+        glBeginQuery(GL_TIME_ELAPSED, query);
+        for (int r = 0; r < Repetitions; r++)
+        {
+            for (const DrawItem& item : mDrawList)
+                item.model->Draw(shaderId, item.baseObject, item.instanceCount, item.lod);
+        }
+        glEndQuery(GL_TIME_ELAPSED);
+
+        // blocks, fine for a one-off measurement
+        GLuint64 elapsed = 0;
+        glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsed);
+        milliseconds[fetch] = static_cast<float>(elapsed / 1e6 / Repetitions);
+        fmt::print("[VERTEX] {}: {:.3f} ms\n", names[fetch], milliseconds[fetch]);
+    }
+
+    mVertexPool->SetFetch(previous);
+    glDeleteQueries(1, &query);
+}
+
 void App::LoadData()
 {
-    mModel = std::make_unique<Model>("resources/necoarc.obj");
-    mFloorModel = std::make_unique<Model>("resources/floor.obj");
-    mLightCubeModel = std::make_unique<Model>("resources/cube.obj");
+    mModels.emplace_back(std::make_unique<Model>("resources/necoarc.obj", *mTextureRegistry));
+    Model* necoarcModel = mModels.back().get();
+    mModels.emplace_back(std::make_unique<Model>("resources/floor.obj", *mTextureRegistry));
+    Model* floorModel = mModels.back().get();
+    // light cube never casts shadow, so skip its position-only stream
+    mModels.emplace_back(std::make_unique<Model>("resources/cube.obj", *mTextureRegistry, false));
+    Model* lightCubeModel = mModels.back().get();
+
+    // the light cube has nothing to simplify
+    necoarcModel->GenerateLods(*mThreadPool);
+    floorModel->GenerateLods(*mThreadPool);
+    necoarcModel->BuildMeshlets(*mThreadPool);
+    floorModel->BuildMeshlets(*mThreadPool);
+    mGpuDriven->AddModel(*necoarcModel);
+    mGpuDriven->AddModel(*floorModel);
+    // queued only, the arrays are built when first switched on
+    mMaterialArrays->AddModel(*necoarcModel);
+    mMaterialArrays->AddModel(*floorModel);
+    // the light cube's shader has no bindless path, it keeps binding
+    mBindlessMaterials->AddModel(*necoarcModel);
+    mBindlessMaterials->AddModel(*floorModel);
+    // impostors are baked from full resolution textures, not the streaming start tier, their cache keeps the bake
+    std::vector<TextureSlot*> impostorTextures;
+    necoarcModel->GetTextureSlots(impostorTextures);
+    mTextureResidency->Require(impostorTextures);
+    // only necoarc has instanced copies
+    mImpostors->AddModel(*necoarcModel);
+    // models drawn with shader.vert / depth.vert, the light cube keeps its attributes
+    mVertexPool->AddModel(*necoarcModel);
+    mVertexPool->AddModel(*floorModel);
+
+    mTransforms = std::make_unique<TransformBuffer>(0);
+
+    mNecoarcEntity = SpawnModel(necoarcModel, glm::mat4(1.0f), RenderFlag_CastsShadow | RenderFlag_Occluder);
+    mFloorEntity = SpawnModel(floorModel, glm::scale(glm::mat4(1.0f), glm::vec3(3.0f)), RenderFlag_CastsShadow | RenderFlag_Occluder);
+    mLightEntity = SpawnModel(lightCubeModel, glm::mat4(1.0f), RenderFlag_Emissive);
+    mEntities.SetLight(mLightEntity, glm::vec3(0.5f), 20.0f);
+    mEntities.SetLightCastsShadow(mLightEntity, true);
+
+    // instances occupy the tail of the scene, their bounds are kept in world space
+    mInstanceBase = static_cast<GLuint>(mScene.GetCount());
+    mInstancesEntity = mEntities.Create();
+    mEntities.SetRenderable(mInstancesEntity, necoarcModel, mInstanceBase, 0, RenderFlag_CastsShadow);
+}
+
+EntityHandle App::SpawnModel(Model* model, const glm::mat4& placement, uint32_t flags)
+{
+    GLuint root = AddModelNodes(*model, SceneGraph::NoParent, placement);
+
+    EntityHandle entity = mEntities.Create(root);
+    mEntities.SetLocalBounds(entity, model->GetBoundsMin(), model->GetBoundsMax());
+    mEntities.SetRenderable(entity, model, root, 1, flags);
+
+    return entity;
+}
+
+GLuint App::AddModelNodes(const Model& model, GLuint parent, const glm::mat4& placement)
+{
+    // copy the model's node hierarchy into the scene as one contiguous range,
+    // placement goes into the range's root so Model::Draw can index it with node offsets
+    GLuint root = static_cast<GLuint>(mScene.GetCount());
+
+    const std::vector<ModelNode>& nodes = model.GetNodes();
+    if (nodes.empty())
+    {
+        mScene.AddNode(parent, placement);
+        return root;
+    }
+
+    for (const ModelNode& node : nodes)
+    {
+        if (node.parent == SceneGraph::NoParent)
+            mScene.AddNode(parent, placement * node.transform);
+        else
+            mScene.AddNode(root + node.parent, node.transform);
+    }
+
+    return root;
+}
+
+void App::SetModelPlacement(const Model& model, GLuint root, const glm::mat4& placement)
+{
+    const std::vector<ModelNode>& nodes = model.GetNodes();
+    mScene.SetLocal(root, nodes.empty() ? placement : placement * nodes[0].transform);
+}
+
+void App::SpawnLights(int count)
+{
+    for (EntityHandle light : mExtraLights)
+        mEntities.Destroy(light);
+    mExtraLights.clear();
+
+    // same layout every time, so changing the count only adds/removes lights
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+    for (int i = 0; i < count; i++)
+    {
+        glm::vec3 position = glm::vec3(
+            (unit(rng) - 0.5f) * 30.0f,
+            0.2f + unit(rng) * 2.5f,
+            (unit(rng) - 0.5f) * 30.0f);
+
+        float hue = unit(rng);
+        glm::vec3 color = glm::vec3(
+            0.5f + 0.5f * glm::cos(glm::radians(360.0f * hue)),
+            0.5f + 0.5f * glm::cos(glm::radians(360.0f * hue - 120.0f)),
+            0.5f + 0.5f * glm::cos(glm::radians(360.0f * hue + 120.0f)));
+
+        EntityHandle light = mEntities.Create();
+        mEntities.SetLight(light, color, 1.5f + unit(rng) * 2.5f);
+        mEntities.SetLightPosition(light, position);
+
+        // every third light is a shadowed spot pointing down
+        if (i % 3 == 2)
+        {
+            mEntities.SetSpotLight(light, glm::vec3(0.0f, -1.0f, 0.0f), glm::cos(glm::radians(25.0f)), glm::cos(glm::radians(35.0f)));
+            mEntities.SetLightCastsShadow(light, true);
+        }
+
+        mExtraLights.emplace_back(light);
+    }
+}
+
+void App::BuildShadowRequests(const glm::mat4& pointLightMatrix, std::vector<ShadowRequest>& out) const
+{
+    out.clear();
+
+    const std::vector<uint8_t>& castsShadow = mEntities.GetLightCastsShadow();
+    const std::vector<glm::vec3>& positions = mEntities.GetLightPositions();
+    const std::vector<glm::vec3>& colors = mEntities.GetLightColors();
+    const std::vector<float>& radii = mEntities.GetLightRadii();
+    const std::vector<glm::vec3>& directions = mEntities.GetLightDirections();
+    const std::vector<glm::vec2>& spotCos = mEntities.GetLightSpotCos();
+    glm::vec3 camPos = mCamera->GetPos();
+
+    for (size_t i = 0; i < mEntities.GetLightCount(); i++)
+    {
+        if (!castsShadow[i])
+            continue;
+
+        ShadowRequest request;
+        request.light = static_cast<uint32_t>(i);
+
+        bool isSpot = spotCos[i].y >= -1.0f;
+        if (!isSpot)
+        {
+            request.viewProjection = pointLightMatrix;
+            request.priority = 1.0f;
+            out.emplace_back(request);
+            continue;
+        }
+
+        // perspective along the cone
+        float outerAngle = glm::min(glm::acos(spotCos[i].y), glm::radians(80.0f));
+        glm::vec3 up = glm::abs(directions[i].y) > 0.99f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+        request.viewProjection =
+            glm::perspective(2.0f * outerAngle, 1.0f, 0.05f, radii[i]) *
+            glm::lookAt(positions[i], positions[i] + directions[i], up);
+
+        // projected size of the light's sphere on screen, brighter lights matter more
+        float distance = glm::length(positions[i] - camPos);
+        float coverage = distance > radii[i] ? glm::min(1.0f, radii[i] * mProjection[1][1] / distance) : 1.0f;
+        float importance = glm::min(1.0f, glm::max(colors[i].x, glm::max(colors[i].y, colors[i].z)));
+        request.priority = coverage * importance;
+        out.emplace_back(request);
+    }
+}
+
+void App::LayoutInstances(int count, float spacing)
+{
+    // rows of copies behind the main model, each with its own tint
+    mScene.Truncate(mInstanceBase);
+    mTransforms->Resize(mInstanceBase);
+
+    Model* model = mEntities.GetModel(mInstancesEntity);
+    glm::vec3 boundsMin = glm::vec3(0.0f);
+    glm::vec3 boundsMax = glm::vec3(0.0f);
+
+    int columns = static_cast<int>(glm::ceil(glm::sqrt(static_cast<float>(count))));
+    for (int i = 0; i < count; i++)
+    {
+        int column = i % columns;
+        int row = i / columns;
+
+        glm::vec3 pos = glm::vec3(
+            (column - (columns - 1) * 0.5f) * spacing,
+            0.0f,
+            -(row + 1) * spacing);
+
+        float hue = static_cast<float>(i) / static_cast<float>(count);
+        glm::vec4 color = glm::vec4(
+            0.6f + 0.4f * glm::cos(glm::radians(360.0f * hue)),
+            0.6f + 0.4f * glm::cos(glm::radians(360.0f * hue - 120.0f)),
+            0.6f + 0.4f * glm::cos(glm::radians(360.0f * hue + 120.0f)),
+            1.0f);
+
+        glm::mat4 placement = glm::translate(glm::mat4(1.0f), pos);
+        GLuint root = AddModelNodes(*model, SceneGraph::NoParent, placement);
+
+        mTransforms->Resize(mScene.GetCount());
+        for (GLuint node = root; node < mScene.GetCount(); node++)
+            mTransforms->SetColor(node, color);
+
+        glm::vec3 instanceMin, instanceMax;
+        TransformAABB(placement, model->GetBoundsMin(), model->GetBoundsMax(), instanceMin, instanceMax);
+        boundsMin = i == 0 ? instanceMin : glm::min(boundsMin, instanceMin);
+        boundsMax = i == 0 ? instanceMax : glm::max(boundsMax, instanceMax);
+    }
+
+    // the whole group is culled as one object
+    mEntities.SetLocalBounds(mInstancesEntity, boundsMin, boundsMax);
+    mEntities.SetInstanceCount(mInstancesEntity, count);
 }
 
 void App::ProcessInput(float dt)
@@ -524,6 +1259,7 @@ void App::CameraSetup()
     glm::vec3 camZ = mCamera->GetZ();
 
     mShader->SetUniformVec3("camPos", camPos);
+    mFeedbackShader->SetUniformVec3("camPos", camPos);
 
     if (ImGui::TreeNode("Camera Settings"))
     {
@@ -559,8 +1295,13 @@ void App::CameraSetup()
         static_cast<float>(mScreenHeight),
         0.1f,
         100.0f);
-    mShader->SetUniformMat4("projection", projection);
     mDrawLightCubeShader->SetUniformMat4("projection", projection);
+    mProjection = projection;
+    mClusteredLighting->SetProjection(
+        glm::radians(static_cast<float>(fov)),
+        static_cast<float>(mScreenWidth) / static_cast<float>(mScreenHeight),
+        0.1f,
+        100.0f);
 
     glm::mat4 view = glm::mat4(1.0);
     view = glm::lookAt(
@@ -568,6 +1309,10 @@ void App::CameraSetup()
         camPos - camZ,              // target
         glm::vec3(0.0, 1.0, 0.0));  // up vector
 
-    mShader->SetUniformMat4("view", view);
     mDrawLightCubeShader->SetUniformMat4("view", view);
+    mView = view;
+
+    // one matrix, so the depth pre-pass and the main pass compute bit-identical positions
+    mShader->SetUniformMat4("viewProjection", projection * view);
+    mFeedbackShader->SetUniformMat4("viewProjection", projection * view);
 }
\ No newline at end of file
@@ -8,6 +8,24 @@
 #include "Model.h"
 #include "Shader.h"
 #include "Camera.h"
+#include "TransformBuffer.h"
+#include "SceneGraph.h"
+#include "EntityStore.h"
+#include "ThreadPool.h"
+#include "OcclusionCuller.h"
+#include "OcclusionQueries.h"
+#include "DepthPrepass.h"
+#include "ClusteredLighting.h"
+#include "ShadowAtlas.h"
+#include "GpuDrivenRenderer.h"
+#include "ImpostorRenderer.h"
+#include "VertexPool.h"
+#include "TextureUploader.h"
+#include "TextureFeedback.h"
+#include "TextureResidency.h"
+#include "TextureRegistry.h"
+#include "MaterialArrays.h"
+#include "BindlessMaterials.h"
 
 class App
 {
@@ -33,6 +51,17 @@ public:
 
     const std::shared_ptr<Shader>& GetShader() const { return mShader; }
 
+    // before Run: texture memory budget, and the largest texture size loaded (0: full resolution)
+    void SetTextureMemory(size_t budgetBytes, int maxSize)
+    {
+        mTextureBudget = budgetBytes;
+        mTextureMaxSize = maxSize;
+    }
+    // before Run: the first frame is drawn with GPU-driven draws, compared against the CPU path, then Run returns
+    void SetValidateGpuDriven(bool validate) { mValidateGpuDriven = validate; }
+    // differing pixels of the last validation, -1: none ran
+    const int64_t GetGpuDrivenValidation() const { return mGpuDrivenValidation; }
+
 
 private:
     void LoadData();
@@ -40,6 +69,17 @@ private:
 
     void RenderScene();
     void CameraSetup();
+    void LayoutInstances(int count, float spacing);
+    void SpawnLights(int count);
+    void BuildShadowRequests(const glm::mat4& pointLightMatrix, std::vector<ShadowRequest>& out) const;
+    void RasterizeOccluders();
+    // pixels that differ between the CPU and the GPU-driven opaque pass
+    size_t ValidateGpuDriven(const Frustum& cameraFrustum);
+    // GPU ms of the current opaque draw list per VertexFetch mode
+    void BenchmarkVertexFetch(float* milliseconds);
+    GLuint AddModelNodes(const Model& model, GLuint parent, const glm::mat4& placement);
+    EntityHandle SpawnModel(Model* model, const glm::mat4& placement, uint32_t flags);
+    void SetModelPlacement(const Model& model, GLuint root, const glm::mat4& placement);
 
 private:
     GLFWwindow* mWindow = nullptr;
@@ -48,11 +88,55 @@ private:
     bool mIsImGUIMode = false;
     bool mIsDepthShaderDebugMode = false;
 
-    std::unique_ptr<Model> mModel;
-    std::unique_ptr<Model> mFloorModel;
-    std::unique_ptr<Model> mLightCubeModel;
-    
+    // loaded assets, scene objects reference them through renderable components
+    std::vector<std::unique_ptr<Model>> mModels;
+
+    // scene node i owns TransformBuffer entry i
+    SceneGraph mScene;
+    std::unique_ptr<TransformBuffer> mTransforms;
+
+    EntityStore mEntities;
+    EntityHandle mNecoarcEntity;
+    EntityHandle mFloorEntity;
+    EntityHandle mLightEntity;
+    EntityHandle mInstancesEntity;  // extra necoarc copies drawn with one instanced draw per mesh
+    std::vector<DrawItem> mDrawList;
+    std::vector<std::vector<MeshletDrawList>> mMeshletLists;  // per mDrawList entry, empty: regular draw
+
+    std::unique_ptr<ThreadPool> mThreadPool;
+    std::unique_ptr<OcclusionCuller> mOcclusionCuller;
+    std::unique_ptr<OcclusionQueries> mOcclusionQueries;
+    std::unique_ptr<DepthPrepass> mDepthPrepass;
+    std::unique_ptr<ClusteredLighting> mClusteredLighting;
+    std::vector<EntityHandle> mExtraLights;  // node-less point/spot lights
+    std::unique_ptr<ShadowAtlas> mShadowAtlas;
+    std::vector<ShadowRequest> mShadowRequests;
+    std::vector<ShadowUpdate> mShadowUpdates;
+    std::unique_ptr<GpuDrivenRenderer> mGpuDriven;
+    std::unique_ptr<ImpostorRenderer> mImpostors;
+    std::unique_ptr<VertexPool> mVertexPool;
+    std::unique_ptr<TextureUploader> mTextureUploader;
+    std::unique_ptr<TextureFeedback> mTextureFeedback;
+    std::vector<uint32_t> mTextureFeedbackLevels;
+    bool mTextureFeedbackDrawn = true;  // last frame drew with mFeedbackShader
+    std::unique_ptr<TextureResidency> mTextureResidency;
+    std::unique_ptr<TextureRegistry> mTextureRegistry;
+    std::unique_ptr<MaterialArrays> mMaterialArrays;
+    std::unique_ptr<BindlessMaterials> mBindlessMaterials;
+    size_t mTextureBudget = 512 * 1024 * 1024;
+    int mTextureMaxSize = 0;  // 0: full resolution
+    bool mValidateGpuDriven = false;
+    int64_t mGpuDrivenValidation = -1;
+
+    // instances occupy the scene nodes from mInstanceBase to the end
+    GLuint mInstanceBase = 0;
+
+    glm::mat4 mProjection = glm::mat4(1.0f);
+    glm::mat4 mView = glm::mat4(1.0f);
+
     std::shared_ptr<Shader> mShader;
+    // shader.frag with mip streaming feedback and early fragment tests, only where those tests are exact
+    std::unique_ptr<Shader> mFeedbackShader;
 
     std::unique_ptr<Shader> mDrawLightCubeShader;
     std::unique_ptr<Shader> mDepthShader;
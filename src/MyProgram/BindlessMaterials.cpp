@@ -0,0 +1,91 @@
+#include "BindlessMaterials.h"
+
+#include <gl/gl3w.h>
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "Model.h"
+#include "TextureResidency.h"
+#include "helper.h"
+
+BindlessMaterials::BindlessMaterials(GLuint binding)
+    : mBinding(binding)
+{
+    // not core in any version, shader.frag checks the same extension
+    if (helper::hasExtension("GL_ARB_bindless_texture"))
+    {
+        mGetTextureHandle = reinterpret_cast<PFNGLGETTEXTUREHANDLEARBPROC>(gl3wGetProcAddress("glGetTextureHandleARB"));
+        mMakeTextureHandleResident = reinterpret_cast<PFNGLMAKETEXTUREHANDLERESIDENTARBPROC>(gl3wGetProcAddress("glMakeTextureHandleResidentARB"));
+        if (mMakeTextureHandleResident == nullptr)
+            mGetTextureHandle = nullptr;
+    }
+    if (mGetTextureHandle == nullptr)
+        fmt::print("[BINDLESS] No bindless textures, materials are bound per draw\n");
+
+    glCreateBuffers(1, &mBuffer);
+}
+
+BindlessMaterials::~BindlessMaterials()
+{
+    // handles go with their textures, deleting a texture makes them non-resident
+    glDeleteBuffers(1, &mBuffer);
+}
+
+void BindlessMaterials::AddModel(Model& model)
+{
+    for (Mesh& mesh : model.GetMeshes())
+    {
+        auto diffuse = std::find_if(mesh.textures.begin(), mesh.textures.end(),
+            [](const Texture& texture) { return texture.type == "texture_diffuse" && texture.slot != nullptr; });
+        if (diffuse == mesh.textures.end())
+            continue;
+
+        auto search = mBySlot.find(diffuse->slot);
+        if (search == mBySlot.end())
+        {
+            search = mBySlot.emplace(diffuse->slot, static_cast<int>(mMaterials.size())).first;
+            mMaterials.push_back({ diffuse->slot, 0 });
+            mGpuMaterials.push_back({ 0, -1, 0, glm::vec2(0.0f) });
+        }
+        mesh.SetMaterial(this, search->second);
+    }
+}
+
+void BindlessMaterials::Update()
+{
+    if (!mEnabled || mMaterials.empty())
+        return;
+
+    // a handle fixes its texture, a texture swapped by the residency needs a new one. the name alone can't tell,
+    // a swap may get the deleted texture's name back
+    bool dirty = false;
+    for (size_t i = 0; i < mMaterials.size(); i++)
+    {
+        Material& material = mMaterials[i];
+        if (material.generation == material.slot->generation)
+            continue;
+
+        GLuint64 handle = mGetTextureHandle(material.slot->texture);
+        mMakeTextureHandleResident(handle);
+        material.generation = material.slot->generation;
+        mGpuMaterials[i] = { handle, material.slot->feedbackId, 0,
+            glm::vec2(static_cast<float>(material.slot->width), static_cast<float>(material.slot->height)) };
+        mHandleCount++;
+        dirty = true;
+    }
+
+    GLsizeiptr size = static_cast<GLsizeiptr>(mGpuMaterials.size() * sizeof(GpuMaterial));
+    if (size > mCapacity)
+    {
+        mCapacity = std::max(size, mCapacity * 2);
+        glNamedBufferData(mBuffer, mCapacity, nullptr, GL_DYNAMIC_DRAW);
+        dirty = true;
+    }
+    if (dirty)
+        glNamedBufferSubData(mBuffer, 0, size, mGpuMaterials.data());
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, mBinding, mBuffer);
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <gl/gl3w.h>
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+class Model;
+struct TextureSlot;
+
+// ARB_bindless_texture path for material textures. every mesh with a diffuse texture gets a material id, its
+// "Materials" SSBO entry holds the resident handle of the texture and its streaming feedback id. enabled,
+// Mesh::BindTextures only sets "materialIndex" and shader.frag samples through the handle, no texture unit is
+// touched per draw. residency swaps the texture behind a slot, Update follows the slot's generation with a new handle.
+// without the extension IsSupported() is false and meshes keep binding their textures. GL thread only
+class BindlessMaterials
+{
+public:
+    BindlessMaterials(GLuint binding);
+    ~BindlessMaterials();
+
+    BindlessMaterials(const BindlessMaterials&) = delete;
+    BindlessMaterials& operator=(const BindlessMaterials&) = delete;
+
+public:
+    // gives the model's meshes their material ids, meshes sharing a diffuse texture share the material.
+    // the model's textures have to outlive this
+    void AddModel(Model& model);
+    // once per frame before drawing, after the residency update: refreshes swapped handles and binds the SSBO
+    void Update();
+
+    // ignored without the extension
+    void SetEnabled(bool enabled) { mEnabled = enabled && IsSupported(); }
+    const bool IsEnabled() const { return mEnabled; }
+    const bool IsSupported() const { return mGetTextureHandle != nullptr; }
+    const size_t GetMaterialCount() const { return mMaterials.size(); }
+    // handles made resident, swaps included
+    const size_t GetHandleCount() const { return mHandleCount; }
+
+private:
+    // std430 layout of shader.frag
+    struct GpuMaterial
+    {
+        GLuint64 diffuse;
+        GLint feedbackId;
+        GLint padding;
+        glm::vec2 size;  // at full resolution
+    };
+
+    struct Material
+    {
+        TextureSlot* slot;
+        uint32_t generation;  // of the slot when the handle was made, 0: no handle yet
+    };
+
+private:
+    PFNGLGETTEXTUREHANDLEARBPROC mGetTextureHandle = nullptr;
+    PFNGLMAKETEXTUREHANDLERESIDENTARBPROC mMakeTextureHandleResident = nullptr;
+
+    GLuint mBinding;
+    GLuint mBuffer = 0;
+    GLsizeiptr mCapacity = 0;
+    bool mEnabled = false;
+
+    std::vector<Material> mMaterials;
+    std::vector<GpuMaterial> mGpuMaterials;
+    std::unordered_map<TextureSlot*, int> mBySlot;
+    size_t mHandleCount = 0;
+};
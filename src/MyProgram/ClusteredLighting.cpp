@@ -0,0 +1,270 @@
+#include "ClusteredLighting.h"
+
+#include <gl/gl3w.h>
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <vector>
+
+#include "EntityStore.h"
+#include "Shader.h"
+#include "ThreadPool.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CLUSTER_USE_SSE
+#include <xmmintrin.h>
+#endif
+
+ClusteredLighting::ClusteredLighting(GLuint lightsBinding, GLuint gridBinding, GLuint indexBinding)
+    : mLightsBinding(lightsBinding)
+    , mGridBinding(gridBinding)
+    , mIndexBinding(indexBinding)
+{
+    glGenBuffers(1, &mLightsBuffer);
+    glGenBuffers(1, &mGridBuffer);
+    glGenBuffers(1, &mIndexBuffer);
+
+    mSlices.resize(ClusterZ);
+    mGrid.resize(ClusterCount);
+}
+
+ClusteredLighting::~ClusteredLighting()
+{
+    glDeleteBuffers(1, &mLightsBuffer);
+    glDeleteBuffers(1, &mGridBuffer);
+    glDeleteBuffers(1, &mIndexBuffer);
+}
+
+void ClusteredLighting::SetProjection(float fovY, float aspect, float nearPlane, float farPlane)
+{
+    if (fovY == mFovY && aspect == mAspect && nearPlane == mNear && farPlane == mFar)
+        return;
+
+    mFovY = fovY;
+    mAspect = aspect;
+    mNear = nearPlane;
+    mFar = farPlane;
+    BuildClusterBounds();
+}
+
+void ClusteredLighting::BuildClusterBounds()
+{
+    mClusterMin.resize(ClusterCount);
+    mClusterMax.resize(ClusterCount);
+
+    float tanY = std::tan(mFovY * 0.5f);
+    float tanX = tanY * mAspect;
+
+    for (uint32_t z = 0; z < ClusterZ; z++)
+    {
+        // exponential slices, matching the log() lookup in shader.frag
+        float depthNear = mNear * std::pow(mFar / mNear, static_cast<float>(z) / ClusterZ);
+        float depthFar = mNear * std::pow(mFar / mNear, static_cast<float>(z + 1) / ClusterZ);
+
+        for (uint32_t y = 0; y < ClusterY; y++)
+        {
+            float ndcMinY = -1.0f + 2.0f * y / ClusterY;
+            float ndcMaxY = -1.0f + 2.0f * (y + 1) / ClusterY;
+
+            for (uint32_t x = 0; x < ClusterX; x++)
+            {
+                float ndcMinX = -1.0f + 2.0f * x / ClusterX;
+                float ndcMaxX = -1.0f + 2.0f * (x + 1) / ClusterX;
+
+                // the tile's side planes go through the eye, so the box spans both depth ends
+                glm::vec3 bmin, bmax;
+                bmin.x = std::min(ndcMinX * tanX * depthNear, ndcMinX * tanX * depthFar);
+                bmax.x = std::max(ndcMaxX * tanX * depthNear, ndcMaxX * tanX * depthFar);
+                bmin.y = std::min(ndcMinY * tanY * depthNear, ndcMinY * tanY * depthFar);
+                bmax.y = std::max(ndcMaxY * tanY * depthNear, ndcMaxY * tanY * depthFar);
+                bmin.z = -depthFar;
+                bmax.z = -depthNear;
+
+                uint32_t cluster = x + ClusterX * (y + ClusterY * z);
+                mClusterMin[cluster] = bmin;
+                mClusterMax[cluster] = bmax;
+            }
+        }
+    }
+}
+
+void ClusteredLighting::Update(const glm::mat4& view, const EntityStore& entities, const std::vector<int>& shadowSlots, ThreadPool& pool)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    const std::vector<glm::vec3>& positions = entities.GetLightPositions();
+    const std::vector<glm::vec3>& colors = entities.GetLightColors();
+    const std::vector<float>& radii = entities.GetLightRadii();
+    const std::vector<glm::vec3>& directions = entities.GetLightDirections();
+    const std::vector<glm::vec2>& spotCos = entities.GetLightSpotCos();
+
+    size_t lightCount = entities.GetLightCount();
+    mLights.resize(lightCount);
+    mViewSpheres.resize(lightCount);
+    for (size_t i = 0; i < lightCount; i++)
+    {
+        GpuLight& light = mLights[i];
+        light.positionRadius = glm::vec4(positions[i], radii[i]);
+        light.color = glm::vec4(colors[i], 1.0f);
+        light.direction = glm::vec4(directions[i], 0.0f);
+        int shadow = i < shadowSlots.size() ? shadowSlots[i] : -1;
+        light.params = glm::vec4(spotCos[i], static_cast<float>(shadow), 0.0f);
+
+        // spot lights use their whole sphere, conservative but cheap
+        mViewSpheres[i] = glm::vec4(glm::vec3(view * glm::vec4(positions[i], 1.0f)), radii[i]);
+    }
+
+    pool.ParallelFor(ClusterZ, [this](size_t slice) { AssignSlice(static_cast<uint32_t>(slice)); });
+
+    // concatenate the slices into one compact index list
+    mIndices.clear();
+    mMaxLightsPerCluster = 0;
+    for (uint32_t z = 0; z < ClusterZ; z++)
+    {
+        const SliceResult& result = mSlices[z];
+        uint32_t offset = static_cast<uint32_t>(mIndices.size());
+        for (uint32_t c = 0; c < ClusterX * ClusterY; c++)
+        {
+            mGrid[z * ClusterX * ClusterY + c] = glm::uvec2(offset, result.counts[c]);
+            offset += result.counts[c];
+            mMaxLightsPerCluster = std::max(mMaxLightsPerCluster, result.counts[c]);
+        }
+        mIndices.insert(mIndices.end(), result.indices.begin(), result.indices.end());
+    }
+
+    Upload(mLightsBuffer, mLightsCapacity, mLights.data(), mLights.size() * sizeof(GpuLight));
+    Upload(mGridBuffer, mGridCapacity, mGrid.data(), mGrid.size() * sizeof(glm::uvec2));
+    Upload(mIndexBuffer, mIndexCapacity, mIndices.data(), mIndices.size() * sizeof(uint32_t));
+
+    auto end = std::chrono::steady_clock::now();
+    mAssignMs = std::chrono::duration<float, std::milli>(end - start).count();
+}
+
+void ClusteredLighting::AssignSlice(uint32_t slice)
+{
+    SliceResult& result = mSlices[slice];
+    ViewLights& candidates = result.candidates;
+    result.indices.clear();
+    result.counts.assign(ClusterX * ClusterY, 0);
+
+    // lights overlapping the slice's depth range, in SoA form
+    uint32_t first = slice * ClusterX * ClusterY;
+    float sliceMinZ = mClusterMin[first].z;
+    float sliceMaxZ = mClusterMax[first].z;
+
+    candidates.x.clear();
+    candidates.y.clear();
+    candidates.z.clear();
+    candidates.radiusSq.clear();
+    candidates.index.clear();
+    for (size_t i = 0; i < mViewSpheres.size(); i++)
+    {
+        const glm::vec4& sphere = mViewSpheres[i];
+        if (sphere.z - sphere.w > sliceMaxZ || sphere.z + sphere.w < sliceMinZ)
+            continue;
+
+        candidates.x.emplace_back(sphere.x);
+        candidates.y.emplace_back(sphere.y);
+        candidates.z.emplace_back(sphere.z);
+        candidates.radiusSq.emplace_back(sphere.w * sphere.w);
+        candidates.index.emplace_back(static_cast<uint32_t>(i));
+    }
+    if (candidates.index.empty())
+        return;
+
+    // padding never passes the test (distance^2 >= 0 > -1)
+    size_t count = candidates.index.size();
+    size_t padded = (count + 3) & ~size_t(3);
+    candidates.x.resize(padded, 0.0f);
+    candidates.y.resize(padded, 0.0f);
+    candidates.z.resize(padded, 0.0f);
+    candidates.radiusSq.resize(padded, -1.0f);
+
+    for (uint32_t c = 0; c < ClusterX * ClusterY; c++)
+    {
+        const glm::vec3& bmin = mClusterMin[first + c];
+        const glm::vec3& bmax = mClusterMax[first + c];
+        size_t before = result.indices.size();
+
+#ifdef CLUSTER_USE_SSE
+        // squared distance from sphere center to box, 4 lights at a time
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 minX = _mm_set1_ps(bmin.x), maxX = _mm_set1_ps(bmax.x);
+        const __m128 minY = _mm_set1_ps(bmin.y), maxY = _mm_set1_ps(bmax.y);
+        const __m128 minZ = _mm_set1_ps(bmin.z), maxZ = _mm_set1_ps(bmax.z);
+        for (size_t i = 0; i < padded; i += 4)
+        {
+            __m128 cx = _mm_loadu_ps(&candidates.x[i]);
+            __m128 cy = _mm_loadu_ps(&candidates.y[i]);
+            __m128 cz = _mm_loadu_ps(&candidates.z[i]);
+            __m128 r2 = _mm_loadu_ps(&candidates.radiusSq[i]);
+
+            __m128 dx = _mm_add_ps(_mm_max_ps(_mm_sub_ps(minX, cx), zero), _mm_max_ps(_mm_sub_ps(cx, maxX), zero));
+            __m128 dy = _mm_add_ps(_mm_max_ps(_mm_sub_ps(minY, cy), zero), _mm_max_ps(_mm_sub_ps(cy, maxY), zero));
+            __m128 dz = _mm_add_ps(_mm_max_ps(_mm_sub_ps(minZ, cz), zero), _mm_max_ps(_mm_sub_ps(cz, maxZ), zero));
+            __m128 distSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+
+            int hits = _mm_movemask_ps(_mm_cmple_ps(distSq, r2));
+            while (hits)
+            {
+                int lane = 0;
+                while (!(hits & (1 << lane)))
+                    lane++;
+                hits &= hits - 1;
+                result.indices.emplace_back(candidates.index[i + lane]);
+            }
+        }
+#else
+        for (size_t i = 0; i < count; i++)
+        {
+            float dx = std::max(bmin.x - candidates.x[i], 0.0f) + std::max(candidates.x[i] - bmax.x, 0.0f);
+            float dy = std::max(bmin.y - candidates.y[i], 0.0f) + std::max(candidates.y[i] - bmax.y, 0.0f);
+            float dz = std::max(bmin.z - candidates.z[i], 0.0f) + std::max(candidates.z[i] - bmax.z, 0.0f);
+            if (dx * dx + dy * dy + dz * dz <= candidates.radiusSq[i])
+                result.indices.emplace_back(candidates.index[i]);
+        }
+#endif
+
+        result.counts[c] = static_cast<uint32_t>(result.indices.size() - before);
+    }
+}
+
+void ClusteredLighting::Upload(GLuint buffer, GLsizeiptr& capacity, const void* data, GLsizeiptr size)
+{
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+    if (size > capacity)
+    {
+        // grow geometrically, an empty SSBO can't be bound
+        capacity = std::max<GLsizeiptr>(std::max(size, capacity * 2), 256);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, capacity, nullptr, GL_DYNAMIC_DRAW);
+    }
+    if (size > 0)
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, size, data);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void ClusteredLighting::Bind()
+{
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, mLightsBinding, mLightsBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, mGridBinding, mGridBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, mIndexBinding, mIndexBuffer);
+}
+
+void ClusteredLighting::SetShaderUniforms(Shader& shader, int screenWidth, int screenHeight)
+{
+    // slice = log(depth) * scale + bias
+    float scale = ClusterZ / std::log(mFar / mNear);
+    float bias = -ClusterZ * std::log(mNear) / std::log(mFar / mNear);
+
+    shader.Use();
+    GLuint id = shader.GetId();
+    glUniform3ui(glGetUniformLocation(id, "clusterCount"), ClusterX, ClusterY, ClusterZ);
+    glUniform2f(glGetUniformLocation(id, "clusterTileSize"),
+        static_cast<float>(screenWidth) / ClusterX,
+        static_cast<float>(screenHeight) / ClusterY);
+    glUniform2f(glGetUniformLocation(id, "clusterDepthParams"), scale, bias);
+    glUniform2f(glGetUniformLocation(id, "nearFar"), mNear, mFar);
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <gl/gl3w.h>
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+class EntityStore;
+class Shader;
+class ThreadPool;
+
+// one entry of the "Lights" SSBO (std430 layout)
+struct GpuLight
+{
+    glm::vec4 positionRadius;  // world space
+    glm::vec4 color;
+    glm::vec4 direction;       // spot direction, world space
+    glm::vec4 params;          // x: spot inner cos, y: spot outer cos, z: "Shadows" index (-1: none)
+};
+
+// clustered forward lighting
+// the view frustum is split into ClusterX * ClusterY screen tiles and ClusterZ exponential depth slices.
+// each frame the lights are assigned to the clusters their sphere touches (worker threads, SIMD sphere/AABB),
+// the fragment shader then only walks the compact light index list of its own cluster
+//   "Lights"       : GpuLight per light
+//   "ClusterGrid"  : uvec2(offset, count) into "LightIndices" per cluster
+//   "LightIndices" : light indices, grouped by cluster
+class ClusteredLighting
+{
+public:
+    static constexpr uint32_t ClusterX = 16;
+    static constexpr uint32_t ClusterY = 9;
+    static constexpr uint32_t ClusterZ = 24;
+    static constexpr uint32_t ClusterCount = ClusterX * ClusterY * ClusterZ;
+
+public:
+    ClusteredLighting(GLuint lightsBinding, GLuint gridBinding, GLuint indexBinding);
+    ~ClusteredLighting();
+
+    ClusteredLighting(const ClusteredLighting&) = delete;
+    ClusteredLighting& operator=(const ClusteredLighting&) = delete;
+
+public:
+    // cluster bounds are rebuilt only when these change, fovY in radians
+    void SetProjection(float fovY, float aspect, float nearPlane, float farPlane);
+
+    // assigns the lights of "entities" to clusters and uploads all three buffers.
+    // shadowSlots[i] is light i's shadow atlas entry, missing entries mean no shadow
+    void Update(const glm::mat4& view, const EntityStore& entities, const std::vector<int>& shadowSlots, ThreadPool& pool);
+    void Bind();
+    // cluster lookup uniforms of shader.frag
+    void SetShaderUniforms(Shader& shader, int screenWidth, int screenHeight);
+
+public:
+    size_t GetLightCount() const { return mLights.size(); }
+    size_t GetIndexCount() const { return mIndices.size(); }
+    uint32_t GetMaxLightsPerCluster() const { return mMaxLightsPerCluster; }
+    float GetAssignMs() const { return mAssignMs; }
+
+private:
+    void BuildClusterBounds();
+    void AssignSlice(uint32_t slice);
+    void Upload(GLuint buffer, GLsizeiptr& capacity, const void* data, GLsizeiptr size);
+
+private:
+    // lights in view space, SoA and padded to a multiple of 4 for the SIMD test
+    struct ViewLights
+    {
+        std::vector<float> x, y, z, radiusSq;
+        std::vector<uint32_t> index;
+    };
+
+    // per slice output, merged after all slices are done
+    struct SliceResult
+    {
+        ViewLights candidates;  // lights overlapping the slice's depth range
+        std::vector<uint32_t> indices;
+        std::vector<uint32_t> counts;  // per cluster of the slice
+    };
+
+    GLuint mLightsBinding, mGridBinding, mIndexBinding;
+    GLuint mLightsBuffer = 0, mGridBuffer = 0, mIndexBuffer = 0;
+    GLsizeiptr mLightsCapacity = 0, mGridCapacity = 0, mIndexCapacity = 0;
+
+    float mFovY = 0.0f, mAspect = 0.0f, mNear = 0.0f, mFar = 0.0f;
+    std::vector<glm::vec3> mClusterMin;  // view space
+    std::vector<glm::vec3> mClusterMax;
+
+    std::vector<GpuLight> mLights;
+    std::vector<glm::vec4> mViewSpheres;  // view space center, radius
+    std::vector<SliceResult> mSlices;
+    std::vector<glm::uvec2> mGrid;
+    std::vector<uint32_t> mIndices;
+
+    uint32_t mMaxLightsPerCluster = 0;
+    float mAssignMs = 0.0f;
+};
@@ -0,0 +1,122 @@
+#include "DepthPrepass.h"
+
+#include <gl/gl3w.h>
+
+DepthPrepass::DepthPrepass()
+{
+    for (FrameQueries& frame : mFrames)
+    {
+        glGenQueries(1, &frame.prepass);
+        glGenQueries(1, &frame.main);
+    }
+}
+
+DepthPrepass::~DepthPrepass()
+{
+    for (FrameQueries& frame : mFrames)
+    {
+        glDeleteQueries(1, &frame.prepass);
+        glDeleteQueries(1, &frame.main);
+    }
+}
+
+bool DepthPrepass::BeginFrame(bool measure)
+{
+    CollectResults();
+    mMeasuring = measure;
+
+    switch (mMode)
+    {
+    case DepthPrepassMode::Off:
+        mEnabled = false;
+        break;
+    case DepthPrepassMode::On:
+        mEnabled = true;
+        break;
+    case DepthPrepassMode::Auto:
+        // overdraw can only be measured in frames with a pre-pass, so probe now and then
+        if (mOverdraw == 0.0f || ++mFramesSinceProbe >= ProbeInterval)
+        {
+            mEnabled = true;
+            mFramesSinceProbe = 0;
+        }
+        else
+        {
+            mEnabled = mOverdraw >= mAutoThreshold;
+        }
+        break;
+    }
+
+    return mEnabled;
+}
+
+void DepthPrepass::BeginPrepass()
+{
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    glDepthFunc(GL_LESS);
+    glDepthMask(GL_TRUE);
+
+    if (mMeasuring)
+        glBeginQuery(GL_SAMPLES_PASSED, mFrames[mCurrent].prepass);
+}
+
+void DepthPrepass::EndPrepass()
+{
+    if (mMeasuring)
+        glEndQuery(GL_SAMPLES_PASSED);
+
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+}
+
+void DepthPrepass::BeginMainPass()
+{
+    if (mEnabled)
+    {
+        // same vertex math as the pre-pass (invariant gl_Position), so depths match exactly
+        glDepthFunc(GL_EQUAL);
+        glDepthMask(GL_FALSE);
+    }
+
+    if (mMeasuring)
+        glBeginQuery(GL_SAMPLES_PASSED, mFrames[mCurrent].main);
+}
+
+void DepthPrepass::EndMainPass()
+{
+    if (mMeasuring)
+    {
+        glEndQuery(GL_SAMPLES_PASSED);
+
+        mFrames[mCurrent].issued = true;
+        mFrames[mCurrent].withPrepass = mEnabled;
+        mCurrent = (mCurrent + 1) % FrameLatency;
+    }
+
+    glDepthFunc(GL_LESS);
+    glDepthMask(GL_TRUE);
+}
+
+void DepthPrepass::CollectResults()
+{
+    for (FrameQueries& frame : mFrames)
+    {
+        if (!frame.issued)
+            continue;
+
+        GLuint available = 0;
+        glGetQueryObjectuiv(frame.main, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+            continue;
+
+        frame.issued = false;
+        if (!frame.withPrepass)
+            continue;
+
+        // pre-pass samples = what a GL_LESS main pass would have shaded, main pass samples = visible pixels
+        GLuint prepassSamples = 0, mainSamples = 0;
+        glGetQueryObjectuiv(frame.prepass, GL_QUERY_RESULT, &prepassSamples);
+        glGetQueryObjectuiv(frame.main, GL_QUERY_RESULT, &mainSamples);
+        if (mainSamples > 0)
+            mOverdraw = static_cast<float>(prepassSamples) / static_cast<float>(mainSamples);
+    }
+}
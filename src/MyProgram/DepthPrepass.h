@@ -0,0 +1,76 @@
+#pragma once
+
+#include <gl/gl3w.h>
+
+#include <array>
+
+enum class DepthPrepassMode
+{
+    Off,
+    On,
+    Auto,  // on while the measured overdraw is worth the extra geometry pass
+};
+
+// optional depth-only pass before the main pass.
+// the main pass then runs with GL_EQUAL and no depth writes, so every pixel is shaded once.
+// GL_SAMPLES_PASSED around both passes measures overdraw,
+// results are read a few frames late so the CPU never waits on them
+class DepthPrepass
+{
+public:
+    DepthPrepass();
+    ~DepthPrepass();
+
+    DepthPrepass(const DepthPrepass&) = delete;
+    DepthPrepass& operator=(const DepthPrepass&) = delete;
+
+public:
+    // decides if this frame uses the pre-pass, "measure" = false skips the sample queries
+    // (they can't be active together with other occlusion queries)
+    bool BeginFrame(bool measure = true);
+
+    // depth writes only, GL_LESS
+    void BeginPrepass();
+    void EndPrepass();
+
+    // GL_EQUAL without depth writes when the pre-pass ran this frame
+    void BeginMainPass();
+    void EndMainPass();
+
+public:
+    void SetMode(DepthPrepassMode mode) { mMode = mode; }
+    DepthPrepassMode GetMode() const { return mMode; }
+    bool IsEnabled() const { return mEnabled; }
+
+    // fragments passing the depth test without a pre-pass / visible fragments, 0 until measured
+    float GetOverdraw() const { return mOverdraw; }
+    // below this the pre-pass costs more than it saves
+    void SetAutoThreshold(float threshold) { mAutoThreshold = threshold; }
+    float GetAutoThreshold() const { return mAutoThreshold; }
+
+private:
+    void CollectResults();
+
+private:
+    static constexpr int FrameLatency = 3;
+    // in Auto mode the pre-pass runs every this many frames to re-measure overdraw
+    static constexpr int ProbeInterval = 60;
+
+    struct FrameQueries
+    {
+        GLuint prepass = 0;
+        GLuint main = 0;
+        bool issued = false;
+        bool withPrepass = false;
+    };
+
+    std::array<FrameQueries, FrameLatency> mFrames;
+    int mCurrent = 0;
+    bool mMeasuring = false;
+    int mFramesSinceProbe = 0;
+
+    DepthPrepassMode mMode = DepthPrepassMode::Auto;
+    bool mEnabled = false;
+    float mOverdraw = 0.0f;
+    float mAutoThreshold = 1.5f;
+};
@@ -0,0 +1,318 @@
+#include "EntityStore.h"
+
+#include <gl/gl3w.h>
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+#include "helper.h"
+#include "Frustum.h"
+#include "Model.h"
+#include "SceneGraph.h"
+
+// spot factor is smoothstep(outer, inner, cos), always 1 with these
+static const glm::vec2 PointLightSpotCos = glm::vec2(-1.5f, -2.0f);
+
+// swap-remove element "i" of a dense array
+template <typename T>
+static void SwapRemove(std::vector<T>& v, size_t i)
+{
+    v[i] = v.back();
+    v.pop_back();
+}
+
+EntityHandle EntityStore::Create(GLuint node)
+{
+    EntityHandle entity;
+    if (!mFreeSlots.empty())
+    {
+        entity.slot = mFreeSlots.back();
+        mFreeSlots.pop_back();
+    }
+    else
+    {
+        entity.slot = static_cast<uint32_t>(mSlotToDense.size());
+        mSlotToDense.emplace_back(0);
+        mSlotGeneration.emplace_back(0);
+    }
+    entity.generation = mSlotGeneration[entity.slot];
+
+    uint32_t dense = static_cast<uint32_t>(mNodes.size());
+    mSlotToDense[entity.slot] = dense;
+
+    mDenseToSlot.emplace_back(entity.slot);
+    mNodes.emplace_back(node);
+    mLocalMin.emplace_back(0.0f);
+    mLocalMax.emplace_back(0.0f);
+    mWorldMin.emplace_back(0.0f);
+    mWorldMax.emplace_back(0.0f);
+    mRenderableOf.emplace_back(NoComponent);
+    mLightOf.emplace_back(NoComponent);
+
+    return entity;
+}
+
+bool EntityStore::IsAlive(EntityHandle entity) const
+{
+    return entity.slot < mSlotGeneration.size() &&
+        mSlotGeneration[entity.slot] == entity.generation;
+}
+
+void EntityStore::Destroy(EntityHandle entity)
+{
+    if (!IsAlive(entity))
+        return;
+
+    uint32_t dense = DenseIndex(entity);
+    RemoveRenderable(dense);
+    RemoveLight(dense);
+
+    // move the last entity into the hole
+    uint32_t last = static_cast<uint32_t>(mNodes.size() - 1);
+    uint32_t movedSlot = mDenseToSlot[last];
+
+    SwapRemove(mDenseToSlot, dense);
+    SwapRemove(mNodes, dense);
+    SwapRemove(mLocalMin, dense);
+    SwapRemove(mLocalMax, dense);
+    SwapRemove(mWorldMin, dense);
+    SwapRemove(mWorldMax, dense);
+    SwapRemove(mRenderableOf, dense);
+    SwapRemove(mLightOf, dense);
+
+    if (dense != last)
+    {
+        mSlotToDense[movedSlot] = dense;
+        if (mRenderableOf[dense] != NoComponent)
+            mRenderOwner[mRenderableOf[dense]] = dense;
+        if (mLightOf[dense] != NoComponent)
+            mLightOwner[mLightOf[dense]] = dense;
+    }
+
+    mSlotGeneration[entity.slot]++;
+    mFreeSlots.emplace_back(entity.slot);
+}
+
+void EntityStore::RemoveRenderable(uint32_t dense)
+{
+    uint32_t r = mRenderableOf[dense];
+    if (r == NoComponent)
+        return;
+
+    SwapRemove(mRenderOwner, r);
+    SwapRemove(mRenderModel, r);
+    SwapRemove(mRenderBaseObject, r);
+    SwapRemove(mRenderInstanceCount, r);
+    SwapRemove(mRenderFlags, r);
+    SwapRemove(mRenderLod, r);
+
+    if (r < mRenderOwner.size())
+        mRenderableOf[mRenderOwner[r]] = r;
+    mRenderableOf[dense] = NoComponent;
+    mRenderVersion++;
+}
+
+void EntityStore::RemoveLight(uint32_t dense)
+{
+    uint32_t l = mLightOf[dense];
+    if (l == NoComponent)
+        return;
+
+    SwapRemove(mLightOwner, l);
+    SwapRemove(mLightPosition, l);
+    SwapRemove(mLightColor, l);
+    SwapRemove(mLightRadius, l);
+    SwapRemove(mLightDirection, l);
+    SwapRemove(mLightSpotCos, l);
+    SwapRemove(mLightCastsShadow, l);
+
+    if (l < mLightOwner.size())
+        mLightOf[mLightOwner[l]] = l;
+    mLightOf[dense] = NoComponent;
+}
+
+void EntityStore::SetNode(EntityHandle entity, GLuint node)
+{
+    mNodes[DenseIndex(entity)] = node;
+}
+
+void EntityStore::SetLocalBounds(EntityHandle entity, const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+{
+    uint32_t dense = DenseIndex(entity);
+    mLocalMin[dense] = boundsMin;
+    mLocalMax[dense] = boundsMax;
+}
+
+void EntityStore::SetRenderable(EntityHandle entity, Model* model, GLuint baseObject, GLsizei instanceCount, uint32_t flags)
+{
+    uint32_t dense = DenseIndex(entity);
+    uint32_t r = mRenderableOf[dense];
+    if (r == NoComponent)
+    {
+        r = static_cast<uint32_t>(mRenderOwner.size());
+        mRenderableOf[dense] = r;
+        mRenderOwner.emplace_back(dense);
+        mRenderModel.emplace_back(nullptr);
+        mRenderBaseObject.emplace_back(0);
+        mRenderInstanceCount.emplace_back(0);
+        mRenderFlags.emplace_back(0);
+        mRenderLod.emplace_back(0);
+    }
+
+    mRenderModel[r] = model;
+    mRenderBaseObject[r] = baseObject;
+    mRenderInstanceCount[r] = instanceCount;
+    mRenderFlags[r] = flags;
+    mRenderVersion++;
+}
+
+void EntityStore::SetInstanceCount(EntityHandle entity, GLsizei instanceCount)
+{
+    uint32_t r = mRenderableOf[DenseIndex(entity)];
+    ASSERT(r != NoComponent);
+    if (mRenderInstanceCount[r] != instanceCount)
+        mRenderVersion++;
+    mRenderInstanceCount[r] = instanceCount;
+}
+
+void EntityStore::SetLight(EntityHandle entity, const glm::vec3& color, float radius)
+{
+    uint32_t dense = DenseIndex(entity);
+    uint32_t l = mLightOf[dense];
+    if (l == NoComponent)
+    {
+        l = static_cast<uint32_t>(mLightOwner.size());
+        mLightOf[dense] = l;
+        mLightOwner.emplace_back(dense);
+        mLightPosition.emplace_back(0.0f);
+        mLightColor.emplace_back(0.0f);
+        mLightRadius.emplace_back(0.0f);
+        mLightDirection.emplace_back(0.0f, -1.0f, 0.0f);
+        mLightSpotCos.emplace_back(PointLightSpotCos);
+        mLightCastsShadow.emplace_back(0);
+    }
+
+    mLightColor[l] = color;
+    mLightRadius[l] = radius;
+}
+
+void EntityStore::SetSpotLight(EntityHandle entity, const glm::vec3& direction, float innerCos, float outerCos)
+{
+    uint32_t l = mLightOf[DenseIndex(entity)];
+    ASSERT(l != NoComponent);
+    mLightDirection[l] = glm::normalize(direction);
+    mLightSpotCos[l] = glm::vec2(innerCos, outerCos);
+}
+
+void EntityStore::SetLightPosition(EntityHandle entity, const glm::vec3& position)
+{
+    uint32_t l = mLightOf[DenseIndex(entity)];
+    ASSERT(l != NoComponent);
+    mLightPosition[l] = position;
+}
+
+void EntityStore::SetLightCastsShadow(EntityHandle entity, bool castsShadow)
+{
+    uint32_t l = mLightOf[DenseIndex(entity)];
+    ASSERT(l != NoComponent);
+    mLightCastsShadow[l] = castsShadow ? 1 : 0;
+}
+
+Model* EntityStore::GetModel(EntityHandle entity) const
+{
+    uint32_t r = mRenderableOf[DenseIndex(entity)];
+    return r != NoComponent ? mRenderModel[r] : nullptr;
+}
+
+void EntityStore::UpdateBounds(const SceneGraph& scene)
+{
+    for (size_t i = 0; i < mNodes.size(); i++)
+    {
+        GLuint node = mNodes[i];
+        if (node == SceneGraph::NoParent)
+        {
+            mWorldMin[i] = mLocalMin[i];
+            mWorldMax[i] = mLocalMax[i];
+            continue;
+        }
+
+        TransformAABB(scene.GetWorld(node), mLocalMin[i], mLocalMax[i], mWorldMin[i], mWorldMax[i]);
+    }
+
+    for (size_t l = 0; l < mLightOwner.size(); l++)
+    {
+        GLuint node = mNodes[mLightOwner[l]];
+        if (node != SceneGraph::NoParent)
+            mLightPosition[l] = glm::vec3(scene.GetWorld(node)[3]);
+    }
+}
+
+void EntityStore::SelectLods(const SceneGraph& scene, const glm::vec3& cameraPos, float pixelScale, float thresholdPixels)
+{
+    for (size_t r = 0; r < mRenderOwner.size(); r++)
+    {
+        const Model* model = mRenderModel[r];
+        int lodCount = model != nullptr ? model->GetLodCount() : 1;
+        if (lodCount <= 1)
+        {
+            mRenderLod[r] = 0;
+            continue;
+        }
+
+        // distance to the nearest point of the world bounds, instanced groups follow their closest copy
+        uint32_t i = mRenderOwner[r];
+        glm::vec3 closest = glm::clamp(cameraPos, mWorldMin[i], mWorldMax[i]);
+        float distance = glm::max(glm::length(closest - cameraPos), 0.001f);
+        float scale = mNodes[i] != SceneGraph::NoParent ? MaxScale(scene.GetWorld(mNodes[i])) : 1.0f;
+        float pixelsPerUnit = scale * pixelScale / distance;
+
+        int lod = glm::min(mRenderLod[r], lodCount - 1);
+        while (lod > 0 && model->GetLodError(lod) * pixelsPerUnit > thresholdPixels)
+            lod--;
+        while (lod + 1 < lodCount && model->GetLodError(lod + 1) * pixelsPerUnit < thresholdPixels * LodHysteresis)
+            lod++;
+        mRenderLod[r] = lod;
+    }
+}
+
+void EntityStore::BuildDrawList(const Frustum& frustum, uint32_t requiredFlags, uint32_t excludedFlags, std::vector<DrawItem>& out) const
+{
+    BuildDrawList(&frustum, requiredFlags, excludedFlags, out);
+}
+
+void EntityStore::BuildRenderableList(uint32_t requiredFlags, uint32_t excludedFlags, std::vector<DrawItem>& out) const
+{
+    BuildDrawList(nullptr, requiredFlags, excludedFlags, out);
+}
+
+void EntityStore::BuildDrawList(const Frustum* frustum, uint32_t requiredFlags, uint32_t excludedFlags, std::vector<DrawItem>& out) const
+{
+    out.clear();
+
+    // walk entities in dense order so bounds are read sequentially
+    for (size_t i = 0; i < mNodes.size(); i++)
+    {
+        uint32_t r = mRenderableOf[i];
+        if (r == NoComponent)
+            continue;
+
+        uint32_t flags = mRenderFlags[r];
+        if ((flags & requiredFlags) != requiredFlags || (flags & excludedFlags) != 0)
+            continue;
+        if (mRenderInstanceCount[r] <= 0 || mRenderModel[r] == nullptr)
+            continue;
+        if (frustum != nullptr && !frustum->IntersectsAABB(mWorldMin[i], mWorldMax[i]))
+            continue;
+
+        DrawItem item;
+        item.model = mRenderModel[r];
+        item.baseObject = mRenderBaseObject[r];
+        item.instanceCount = mRenderInstanceCount[r];
+        item.flags = flags;
+        item.lod = mRenderLod[r];
+        item.boundsMin = mWorldMin[i];
+        item.boundsMax = mWorldMax[i];
+        out.emplace_back(item);
+    }
+}
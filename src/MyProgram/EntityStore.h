@@ -0,0 +1,149 @@
+#pragma once
+
+#include <gl/gl3w.h>
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+#include "Frustum.h"
+#include "SceneGraph.h"
+
+class Model;
+
+// stable reference to an entity, stays valid while entities are created/destroyed around it
+struct EntityHandle
+{
+    uint32_t slot = 0xFFFFFFFF;
+    uint32_t generation = 0;
+};
+
+enum RenderFlag : uint32_t
+{
+    RenderFlag_None = 0,
+    RenderFlag_CastsShadow = 1 << 0,
+    RenderFlag_Emissive = 1 << 1,  // drawn with the light cube shader
+    RenderFlag_Occluder = 1 << 2,  // rasterized by the CPU occlusion culler
+};
+
+// one entry of a draw list built from visible renderables
+struct DrawItem
+{
+    Model* model;
+    GLuint baseObject;
+    GLsizei instanceCount;
+    uint32_t flags;
+    int lod;
+    glm::vec3 boundsMin;  // world space
+    glm::vec3 boundsMax;
+};
+
+// scene objects stored as structure-of-arrays components in dense arrays
+//   transform : scene graph node
+//   bounds    : local AABB (node space) and cached world AABB
+//   renderable: model + TransformBuffer range, selected level of detail
+//   light     : color/radius, optional spot cone and shadow, position comes from the transform
+// destroying an entity swap-removes it, so every pass iterates packed arrays
+class EntityStore
+{
+public:
+    static constexpr uint32_t NoComponent = 0xFFFFFFFF;
+    static constexpr float LodHysteresis = 0.7f;
+
+public:
+    EntityStore() = default;
+    ~EntityStore() = default;
+
+public:
+    EntityHandle Create(GLuint node = SceneGraph::NoParent);
+    void Destroy(EntityHandle entity);
+    bool IsAlive(EntityHandle entity) const;
+
+    // bounds are in node space, or world space when the entity has no node
+    void SetNode(EntityHandle entity, GLuint node);
+    void SetLocalBounds(EntityHandle entity, const glm::vec3& boundsMin, const glm::vec3& boundsMax);
+    void SetRenderable(EntityHandle entity, Model* model, GLuint baseObject, GLsizei instanceCount = 1, uint32_t flags = RenderFlag_CastsShadow);
+    void SetInstanceCount(EntityHandle entity, GLsizei instanceCount);
+    // point light until SetSpotLight is called
+    void SetLight(EntityHandle entity, const glm::vec3& color, float radius);
+    // world space direction, cosines of the full intensity and the cut-off angle
+    void SetSpotLight(EntityHandle entity, const glm::vec3& direction, float innerCos, float outerCos);
+    // only used by lights without a node
+    void SetLightPosition(EntityHandle entity, const glm::vec3& position);
+    // spot lights get a perspective shadow along their cone,
+    // point lights have no cube shadows and look at the scene origin with an orthographic one
+    void SetLightCastsShadow(EntityHandle entity, bool castsShadow);
+
+    // world bounds and light positions from current scene graph world matrices
+    void UpdateBounds(const SceneGraph& scene);
+
+    // level of detail from projected error: "pixelScale" is the screen size in pixels of one unit at distance 1
+    // (screenHeight * projection[1][1] / 2). a level is left for a finer one when its error exceeds "thresholdPixels",
+    // and for a coarser one only when that one's error is below LodHysteresis * threshold, so levels don't pop back and forth
+    void SelectLods(const SceneGraph& scene, const glm::vec3& cameraPos, float pixelScale, float thresholdPixels);
+
+    // visible renderables having all "requiredFlags" and none of "excludedFlags"
+    void BuildDrawList(const Frustum& frustum, uint32_t requiredFlags, uint32_t excludedFlags, std::vector<DrawItem>& out) const;
+    // same without the frustum test
+    void BuildRenderableList(uint32_t requiredFlags, uint32_t excludedFlags, std::vector<DrawItem>& out) const;
+
+public:
+    const GLuint GetNode(EntityHandle entity) const { return mNodes[DenseIndex(entity)]; }
+    Model* GetModel(EntityHandle entity) const;
+    const glm::vec3& GetWorldBoundsMin(EntityHandle entity) const { return mWorldMin[DenseIndex(entity)]; }
+    const glm::vec3& GetWorldBoundsMax(EntityHandle entity) const { return mWorldMax[DenseIndex(entity)]; }
+
+    const size_t GetCount() const { return mNodes.size(); }
+    const size_t GetRenderableCount() const { return mRenderOwner.size(); }
+    // changes whenever a renderable is added, removed or changed
+    const uint32_t GetRenderVersion() const { return mRenderVersion; }
+
+    // light component arrays, index i is the i-th light
+    const size_t GetLightCount() const { return mLightOwner.size(); }
+    const std::vector<glm::vec3>& GetLightPositions() const { return mLightPosition; }
+    const std::vector<glm::vec3>& GetLightColors() const { return mLightColor; }
+    const std::vector<float>& GetLightRadii() const { return mLightRadius; }
+    const std::vector<glm::vec3>& GetLightDirections() const { return mLightDirection; }
+    const std::vector<glm::vec2>& GetLightSpotCos() const { return mLightSpotCos; }
+    const std::vector<uint8_t>& GetLightCastsShadow() const { return mLightCastsShadow; }
+
+private:
+    uint32_t DenseIndex(EntityHandle entity) const { return mSlotToDense[entity.slot]; }
+    void RemoveRenderable(uint32_t dense);
+    void RemoveLight(uint32_t dense);
+    void BuildDrawList(const Frustum* frustum, uint32_t requiredFlags, uint32_t excludedFlags, std::vector<DrawItem>& out) const;
+
+private:
+    // handle slot -> dense index, generation detects stale handles
+    std::vector<uint32_t> mSlotToDense;
+    std::vector<uint32_t> mSlotGeneration;
+    std::vector<uint32_t> mFreeSlots;
+
+    // per entity (dense)
+    std::vector<uint32_t> mDenseToSlot;
+    std::vector<GLuint> mNodes;
+    std::vector<glm::vec3> mLocalMin;
+    std::vector<glm::vec3> mLocalMax;
+    std::vector<glm::vec3> mWorldMin;
+    std::vector<glm::vec3> mWorldMax;
+    std::vector<uint32_t> mRenderableOf;
+    std::vector<uint32_t> mLightOf;
+
+    // renderable component (dense)
+    std::vector<uint32_t> mRenderOwner;
+    std::vector<Model*> mRenderModel;
+    std::vector<GLuint> mRenderBaseObject;
+    std::vector<GLsizei> mRenderInstanceCount;
+    std::vector<uint32_t> mRenderFlags;
+    std::vector<int> mRenderLod;
+    uint32_t mRenderVersion = 0;
+
+    // light component (dense)
+    std::vector<uint32_t> mLightOwner;
+    std::vector<glm::vec3> mLightPosition;
+    std::vector<glm::vec3> mLightColor;
+    std::vector<float> mLightRadius;
+    std::vector<glm::vec3> mLightDirection;
+    std::vector<glm::vec2> mLightSpotCos;  // inner, outer; below -1 for point lights
+    std::vector<uint8_t> mLightCastsShadow;
+};
@@ -0,0 +1,68 @@
+#include "Frustum.h"
+
+#include <glm/glm.hpp>
+
+Frustum::Frustum(const glm::mat4& viewProjection)
+{
+    // Gribb/Hartmann: planes are sums/differences of the matrix rows
+    glm::mat4 m = glm::transpose(viewProjection);
+    planes[0] = m[3] + m[0];  // left
+    planes[1] = m[3] - m[0];  // right
+    planes[2] = m[3] + m[1];  // bottom
+    planes[3] = m[3] - m[1];  // top
+    planes[4] = m[3] + m[2];  // near
+    planes[5] = m[3] - m[2];  // far
+
+    for (glm::vec4& plane : planes)
+        plane /= glm::length(glm::vec3(plane));
+}
+
+bool Frustum::IntersectsAABB(const glm::vec3& boundsMin, const glm::vec3& boundsMax) const
+{
+    for (const glm::vec4& plane : planes)
+    {
+        // corner furthest along the plane normal
+        glm::vec3 p = glm::vec3(
+            plane.x >= 0.0f ? boundsMax.x : boundsMin.x,
+            plane.y >= 0.0f ? boundsMax.y : boundsMin.y,
+            plane.z >= 0.0f ? boundsMax.z : boundsMin.z);
+
+        if (glm::dot(glm::vec3(plane), p) + plane.w < 0.0f)
+            return false;
+    }
+    return true;
+}
+
+bool Frustum::IntersectsSphere(const glm::vec3& center, float radius) const
+{
+    for (const glm::vec4& plane : planes)
+    {
+        if (glm::dot(glm::vec3(plane), center) + plane.w < -radius)
+            return false;
+    }
+    return true;
+}
+
+void TransformAABB(const glm::mat4& m,
+    const glm::vec3& boundsMin, const glm::vec3& boundsMax,
+    glm::vec3& outMin, glm::vec3& outMax)
+{
+    // Arvo: transform the center, extents by |m|
+    glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+    glm::vec3 extent = (boundsMax - boundsMin) * 0.5f;
+
+    glm::vec3 worldCenter = glm::vec3(m * glm::vec4(center, 1.0f));
+    glm::vec3 worldExtent =
+        glm::abs(glm::vec3(m[0])) * extent.x +
+        glm::abs(glm::vec3(m[1])) * extent.y +
+        glm::abs(glm::vec3(m[2])) * extent.z;
+
+    outMin = worldCenter - worldExtent;
+    outMax = worldCenter + worldExtent;
+}
+
+float MaxScale(const glm::mat4& m)
+{
+    return glm::sqrt(glm::max(glm::dot(glm::vec3(m[0]), glm::vec3(m[0])),
+        glm::max(glm::dot(glm::vec3(m[1]), glm::vec3(m[1])), glm::dot(glm::vec3(m[2]), glm::vec3(m[2])))));
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+// 6 planes (xyz = normal pointing inside, w = distance) extracted from a view-projection matrix
+struct Frustum
+{
+    glm::vec4 planes[6];
+
+    Frustum() {}
+    Frustum(const glm::mat4& viewProjection);
+
+    // conservative: may report boxes near frustum corners as visible
+    bool IntersectsAABB(const glm::vec3& boundsMin, const glm::vec3& boundsMax) const;
+    bool IntersectsSphere(const glm::vec3& center, float radius) const;
+};
+
+// axis aligned bounds of "boundsMin/boundsMax" after transforming by "m"
+void TransformAABB(const glm::mat4& m,
+    const glm::vec3& boundsMin, const glm::vec3& boundsMax,
+    glm::vec3& outMin, glm::vec3& outMax);
+
+// largest axis scale of "m", turns object space distances into conservative world space ones
+float MaxScale(const glm::mat4& m);
@@ -0,0 +1,434 @@
+#include "GpuDrivenRenderer.h"
+
+#include <gl/gl3w.h>
+
+#include <glm/glm.hpp>
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include "Frustum.h"
+#include "MaterialArrays.h"
+#include "Model.h"
+#include "Shader.h"
+#include "helper.h"
+
+// away from the shadow atlas (0) and the material textures (1..)
+static constexpr GLuint HiZTextureUnit = 15;
+static constexpr GLuint MaterialArrayTextureUnit = 14;
+
+GpuDrivenRenderer::GpuDrivenRenderer(GLuint firstBinding)
+    : mFirstBinding(firstBinding)
+{
+    // core since 4.6, the 4.5 context may still have the ARB version
+    if (gl3wIsSupported(4, 6))
+        mMultiDrawIndirectCount = glMultiDrawElementsIndirectCount;
+    else if (helper::hasExtension("GL_ARB_indirect_parameters"))
+        mMultiDrawIndirectCount = reinterpret_cast<PFNGLMULTIDRAWELEMENTSINDIRECTCOUNTPROC>(gl3wGetProcAddress("glMultiDrawElementsIndirectCountARB"));
+    if (mMultiDrawIndirectCount == nullptr)
+        fmt::print("[GPU-DRIVEN] No indirect count draws, culled commands are zeroed instead\n");
+
+    glGenBuffers(1, &mObjectBuffer);
+    glGenBuffers(1, &mBatchBuffer);
+    glGenBuffers(1, &mCommandBuffer);
+    glGenBuffers(1, &mCountBuffer);
+    glGenBuffers(1, &mDrawObjectBuffer);
+    glGenBuffers(StatsLatency, mStatsBuffers);
+
+    mCullShader = std::make_unique<Shader>();
+    mCullShader->AddShader(GL_COMPUTE_SHADER, "resources/gpu_cull.comp");
+    mCullShader->Link();
+    mCullShader->SetInt("hiZ", HiZTextureUnit);
+
+    mHiZShader = std::make_unique<Shader>();
+    mHiZShader->AddShader(GL_COMPUTE_SHADER, "resources/hiz_downsample.comp");
+    mHiZShader->Link();
+    mHiZShader->SetInt("source", HiZTextureUnit);
+}
+
+GpuDrivenRenderer::~GpuDrivenRenderer()
+{
+    glDeleteVertexArrays(1, &mVAO);
+    glDeleteBuffers(1, &mVBO);
+    glDeleteBuffers(1, &mEBO);
+
+    glDeleteBuffers(1, &mObjectBuffer);
+    glDeleteBuffers(1, &mBatchBuffer);
+    glDeleteBuffers(1, &mCommandBuffer);
+    glDeleteBuffers(1, &mCountBuffer);
+    glDeleteBuffers(1, &mDrawObjectBuffer);
+    glDeleteBuffers(StatsLatency, mStatsBuffers);
+
+    glDeleteTextures(1, &mDepthCopy);
+    glDeleteTextures(1, &mHiZ);
+}
+
+void GpuDrivenRenderer::AddModel(const Model& model)
+{
+    if (mModelBatches.count(&model) != 0)
+        return;
+
+    mModelBatches.emplace(&model, static_cast<uint32_t>(mBatches.size()));
+    for (const Mesh& mesh : model.GetMeshes())
+    {
+        GpuBatch batch = {};
+        batch.boundsMin = glm::vec4(mesh.boundsMin, 0.0f);
+        batch.boundsMax = glm::vec4(mesh.boundsMax, 0.0f);
+        batch.indexCount = static_cast<GLuint>(mesh.indices.size());
+        batch.firstIndex = static_cast<GLuint>(mIndices.size());
+        batch.baseVertex = static_cast<GLint>(mVertices.size());
+        mGpuBatches.emplace_back(batch);
+        mBatches.push_back({ &mesh, 0, 0 });
+
+        mVertices.insert(mVertices.end(), mesh.vertices.begin(), mesh.vertices.end());
+        mIndices.insert(mIndices.end(), mesh.indices.begin(), mesh.indices.end());
+    }
+
+    mGeometryDirty = true;
+    // batch ranges moved, objects have to be rebuilt
+    mRenderVersion = 0xFFFFFFFF;
+}
+
+void GpuDrivenRenderer::UploadGeometry()
+{
+    if (mVAO == 0)
+    {
+        glGenVertexArrays(1, &mVAO);
+        glGenBuffers(1, &mVBO);
+        glGenBuffers(1, &mEBO);
+    }
+
+    glBindVertexArray(mVAO);
+
+    glBindBuffer(GL_ARRAY_BUFFER, mVBO);
+    glBufferData(GL_ARRAY_BUFFER, mVertices.size() * sizeof(Vertex), mVertices.data(), GL_STATIC_DRAW);
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mEBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, mIndices.size() * sizeof(GLuint), mIndices.data(), GL_STATIC_DRAW);
+
+    // same layout as Mesh
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, normal));
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, texCoords));
+
+    // transform index and material layer per draw, fetched at the command's baseInstance
+    glBindBuffer(GL_ARRAY_BUFFER, mDrawObjectBuffer);
+    glEnableVertexAttribArray(3);
+    glVertexAttribIPointer(3, 2, GL_UNSIGNED_INT, sizeof(glm::uvec2), (void*)0);
+    glVertexAttribDivisor(3, 1);
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    mGeometryDirty = false;
+}
+
+void GpuDrivenRenderer::Upload(GLuint buffer, GLsizeiptr& capacity, const void* data, GLsizeiptr size)
+{
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+    if (size > capacity)
+    {
+        // grow geometrically, an empty SSBO can't be bound
+        capacity = std::max<GLsizeiptr>(std::max(size, capacity * 2), 256);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, capacity, nullptr, GL_DYNAMIC_DRAW);
+    }
+    if (size > 0 && data != nullptr)
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, size, data);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void GpuDrivenRenderer::UpdateObjects(const EntityStore& entities, uint32_t requiredFlags, uint32_t excludedFlags)
+{
+    if (mGeometryDirty)
+        UploadGeometry();
+    if (entities.GetRenderVersion() == mRenderVersion)
+        return;
+    mRenderVersion = entities.GetRenderVersion();
+
+    entities.BuildRenderableList(requiredFlags, excludedFlags, mRenderables);
+
+    // one object per mesh of every copy, batches get one command slot per object
+    for (Batch& batch : mBatches)
+        batch.commandCapacity = 0;
+    mObjects.clear();
+    for (const DrawItem& item : mRenderables)
+    {
+        auto search = mModelBatches.find(item.model);
+        if (search == mModelBatches.end())
+            continue;
+
+        const Model& model = *item.model;
+        for (GLsizei instance = 0; instance < item.instanceCount; instance++)
+        {
+            GLuint root = item.baseObject + instance * model.GetNodeCount();
+            for (size_t m = 0; m < model.GetMeshes().size(); m++)
+            {
+                uint32_t batch = search->second + static_cast<uint32_t>(m);
+                mObjects.emplace_back(root + model.GetMeshNode(m), batch);
+                mBatches[batch].commandCapacity++;
+            }
+        }
+    }
+    mObjectCount = mObjects.size();
+
+    // meshes in the same array get neighbouring command ranges, Draw covers them with one call
+    for (size_t b = 0; b < mBatches.size(); b++)
+    {
+        MaterialArrays::Material material;
+        if (mMaterialArrays != nullptr)
+            material = mMaterialArrays->GetMaterial(*mBatches[b].mesh);
+        mBatches[b].materialArray = material.array;
+        mGpuBatches[b].materialLayer = material.layer;
+    }
+    mDrawOrder.resize(mBatches.size());
+    for (size_t b = 0; b < mBatches.size(); b++)
+        mDrawOrder[b] = static_cast<uint32_t>(b);
+    std::stable_sort(mDrawOrder.begin(), mDrawOrder.end(),
+        [this](uint32_t a, uint32_t b) { return mBatches[a].materialArray < mBatches[b].materialArray; });
+
+    GLuint commandOffset = 0;
+    for (uint32_t b : mDrawOrder)
+    {
+        mGpuBatches[b].commandOffset = commandOffset;
+        commandOffset += mBatches[b].commandCapacity;
+    }
+
+    Upload(mObjectBuffer, mObjectCapacity, mObjects.data(), mObjects.size() * sizeof(glm::uvec2));
+    Upload(mBatchBuffer, mBatchCapacity, mGpuBatches.data(), mGpuBatches.size() * sizeof(GpuBatch));
+    Upload(mCommandBuffer, mCommandCapacity, nullptr, mObjectCount * sizeof(DrawCommand));
+    Upload(mDrawObjectBuffer, mDrawObjectCapacity, nullptr, mObjectCount * sizeof(glm::uvec2));
+
+    GLsizeiptr countSize = mBatches.size() * sizeof(GLuint);
+    if (countSize > mCountCapacity)
+    {
+        Upload(mCountBuffer, mCountCapacity, nullptr, countSize);
+        for (GLuint buffer : mStatsBuffers)
+        {
+            glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+            glBufferData(GL_COPY_WRITE_BUFFER, mCountCapacity, nullptr, GL_STREAM_READ);
+        }
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        mStatsFrames = 0;
+    }
+}
+
+void GpuDrivenRenderer::Cull(const glm::mat4& viewProjection, bool hiZ)
+{
+    if (mObjectCount == 0)
+    {
+        mDrawnCount = 0;
+        return;
+    }
+
+    // counts restart at zero. without indirect count, or with draws spanning several meshes' ranges,
+    // every slot is drawn, so stale commands are zeroed too
+    GLuint zero = 0;
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, mCountBuffer);
+    glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+    if (mMultiDrawIndirectCount == nullptr || mMaterialArrays != nullptr)
+    {
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, mCommandBuffer);
+        glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, mFirstBinding + 0, mObjectBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, mFirstBinding + 1, mBatchBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, mFirstBinding + 2, mCommandBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, mFirstBinding + 3, mCountBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, mFirstBinding + 4, mDrawObjectBuffer);
+
+    Frustum frustum(viewProjection);
+    bool useHiZ = hiZ && mHiZValid;
+
+    mCullShader->Use();
+    GLuint shaderId = mCullShader->GetId();
+    glUniform1ui(glGetUniformLocation(shaderId, "objectCount"), static_cast<GLuint>(mObjectCount));
+    glUniform4fv(glGetUniformLocation(shaderId, "frustumPlanes"), 6, &frustum.planes[0][0]);
+    glUniform1i(glGetUniformLocation(shaderId, "hiZEnabled"), useHiZ ? 1 : 0);
+    if (useHiZ)
+    {
+        mCullShader->SetUniformMat4("hiZViewProjection", mHiZViewProjection);
+        glUniform2f(glGetUniformLocation(shaderId, "hiZSize"), static_cast<float>(mHiZWidth), static_cast<float>(mHiZHeight));
+        glUniform1i(glGetUniformLocation(shaderId, "hiZLevels"), mHiZLevels);
+        glActiveTexture(GL_TEXTURE0 + HiZTextureUnit);
+        glBindTexture(GL_TEXTURE_2D, mHiZ);
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    glDispatchCompute(static_cast<GLuint>((mObjectCount + 63) / 64), 1, 1);
+    glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+
+    // draw counts come back StatsLatency - 1 frames later, by then the copy is done
+    GLsizeiptr countSize = mBatches.size() * sizeof(GLuint);
+    glBindBuffer(GL_COPY_READ_BUFFER, mCountBuffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, mStatsBuffers[mStatsFrames % StatsLatency]);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, countSize);
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    if (mStatsFrames >= StatsLatency - 1)
+    {
+        std::vector<GLuint> counts(mBatches.size());
+        glBindBuffer(GL_COPY_READ_BUFFER, mStatsBuffers[(mStatsFrames + 1) % StatsLatency]);
+        glGetBufferSubData(GL_COPY_READ_BUFFER, 0, countSize, counts.data());
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+
+        mDrawnCount = 0;
+        for (GLuint count : counts)
+            mDrawnCount += count;
+    }
+    mStatsFrames++;
+}
+
+void GpuDrivenRenderer::Draw(GLuint shaderId)
+{
+    if (mObjectCount == 0)
+        return;
+
+    glUseProgram(shaderId);
+    GLint attributeLocation = glGetUniformLocation(shaderId, "drawObjectAttribute");
+    glUniform1i(attributeLocation, 1);
+    // shared VBO with the regular attribute layout, whatever the last mesh draw pulled
+    glUniform1i(glGetUniformLocation(shaderId, "vertexFetch"), 0);
+
+    glBindVertexArray(mVAO);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, mCommandBuffer);
+    if (mMultiDrawIndirectCount != nullptr)
+        glBindBuffer(GL_PARAMETER_BUFFER, mCountBuffer);
+
+    GLint arrayLocation = glGetUniformLocation(shaderId, "materialArray");
+    glUniform1i(glGetUniformLocation(shaderId, "materialLayers"), MaterialArrayTextureUnit);
+
+    // one call per mesh, only material binding differs between them, or one per material array
+    mDrawCallCount = 0;
+    size_t i = 0;
+    while (i < mDrawOrder.size())
+    {
+        uint32_t b = mDrawOrder[i];
+        const Batch& batch = mBatches[b];
+        const void* commands = (void*)(mGpuBatches[b].commandOffset * sizeof(DrawCommand));
+        if (batch.commandCapacity == 0)
+        {
+            i++;
+            continue;
+        }
+
+        if (batch.materialArray != 0)
+        {
+            // the layer comes with each command, the ranges of the whole array are drawn at once
+            GLsizei commandCount = 0;
+            for (; i < mDrawOrder.size() && mBatches[mDrawOrder[i]].materialArray == batch.materialArray; i++)
+                commandCount += mBatches[mDrawOrder[i]].commandCapacity;
+
+            // array layers aren't streamed, nothing to report
+            glUniform1i(arrayLocation, 1);
+            glUniform1i(glGetUniformLocation(shaderId, "texture_diffuse1_feedback"), -1);
+            glUniform1i(glGetUniformLocation(shaderId, "materialIndex"), -1);
+            glActiveTexture(GL_TEXTURE0 + MaterialArrayTextureUnit);
+            glBindTexture(GL_TEXTURE_2D_ARRAY, batch.materialArray);
+            glActiveTexture(GL_TEXTURE0);
+            glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, commands, commandCount, 0);
+        }
+        else
+        {
+            glUniform1i(arrayLocation, 0);
+            batch.mesh->BindTextures(shaderId);
+            if (mMultiDrawIndirectCount != nullptr)
+            {
+                mMultiDrawIndirectCount(GL_TRIANGLES, GL_UNSIGNED_INT, commands,
+                    static_cast<GLintptr>(b * sizeof(GLuint)), batch.commandCapacity, 0);
+            }
+            else
+            {
+                glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, commands, batch.commandCapacity, 0);
+            }
+            i++;
+        }
+        mDrawCallCount++;
+    }
+
+    if (mMultiDrawIndirectCount != nullptr)
+        glBindBuffer(GL_PARAMETER_BUFFER, 0);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    glBindVertexArray(0);
+    glUniform1i(attributeLocation, 0);
+    glUniform1i(arrayLocation, 0);
+}
+
+void GpuDrivenRenderer::SetMaterialArrays(const MaterialArrays* arrays)
+{
+    if (arrays == mMaterialArrays)
+        return;
+
+    mMaterialArrays = arrays;
+    // layers and command ranges are assigned with the objects
+    mRenderVersion = 0xFFFFFFFF;
+}
+
+void GpuDrivenRenderer::ResizeHiZ(int width, int height)
+{
+    glDeleteTextures(1, &mDepthCopy);
+    glDeleteTextures(1, &mHiZ);
+
+    mHiZWidth = width;
+    mHiZHeight = height;
+    mHiZLevels = 1 + static_cast<int>(std::floor(std::log2(static_cast<float>(std::max(width, height)))));
+
+    glGenTextures(1, &mDepthCopy);
+    glBindTexture(GL_TEXTURE_2D, mDepthCopy);
+    glTexStorage2D(GL_TEXTURE_2D, 1, GL_DEPTH_COMPONENT24, width, height);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+    glGenTextures(1, &mHiZ);
+    glBindTexture(GL_TEXTURE_2D, mHiZ);
+    glTexStorage2D(GL_TEXTURE_2D, mHiZLevels, GL_R32F, width, height);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    mHiZValid = false;
+}
+
+void GpuDrivenRenderer::UpdateHiZ(const glm::mat4& viewProjection, int screenWidth, int screenHeight)
+{
+    if (screenWidth <= 0 || screenHeight <= 0)
+        return;
+    if (screenWidth != mHiZWidth || screenHeight != mHiZHeight)
+        ResizeHiZ(screenWidth, screenHeight);
+
+    // depth of the read framebuffer into a texture the compute shader can fetch
+    glBindTexture(GL_TEXTURE_2D, mDepthCopy);
+    glCopyTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 0, 0, screenWidth, screenHeight);
+
+    // level 0 is the copy, every further level keeps the farthest depth of the texels below it
+    mHiZShader->Use();
+    GLuint shaderId = mHiZShader->GetId();
+    glActiveTexture(GL_TEXTURE0 + HiZTextureUnit);
+    for (int level = 0; level < mHiZLevels; level++)
+    {
+        glBindTexture(GL_TEXTURE_2D, level == 0 ? mDepthCopy : mHiZ);
+        glUniform1i(glGetUniformLocation(shaderId, "firstLevel"), level == 0 ? 1 : 0);
+        glUniform1i(glGetUniformLocation(shaderId, "sourceLevel"), std::max(level - 1, 0));
+        glBindImageTexture(0, mHiZ, level, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+
+        GLuint width = std::max(screenWidth >> level, 1);
+        GLuint height = std::max(screenHeight >> level, 1);
+        glDispatchCompute((width + 7) / 8, (height + 7) / 8, 1);
+        glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glActiveTexture(GL_TEXTURE0);
+
+    mHiZValid = true;
+    mHiZViewProjection = viewProjection;
+}
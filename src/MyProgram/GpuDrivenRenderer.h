@@ -0,0 +1,141 @@
+#pragma once
+
+#include <gl/gl3w.h>
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "EntityStore.h"
+#include "Mesh.h"
+
+class MaterialArrays;
+class Model;
+class Shader;
+
+// GPU-driven opaque pass
+// all registered meshes share one vertex and index buffer. every drawn copy of a mesh is an "object"
+// (TransformBuffer index + mesh), the object list is only rebuilt when the renderables change.
+// each frame gpu_cull.comp tests the objects against the frustum and optionally last frame's Hi-Z pyramid,
+// survivors are appended with atomics to their mesh's range of indirect commands and
+// one glMultiDrawElementsIndirectCount per mesh draws them, so CPU work doesn't grow with the object count.
+// with MaterialArrays, meshes whose diffuse texture shares an array get neighbouring command ranges and
+// one glMultiDrawElementsIndirect draws all of them, each command carrying its layer.
+//   firstBinding + 0 "Objects"    : uvec2(transform index, batch) per object
+//   firstBinding + 1 "Batches"    : per mesh bounds, index range and command range
+//   firstBinding + 2 "Commands"   : indirect draw commands
+//   firstBinding + 3 "DrawCounts" : commands written per batch, also the indirect count parameter buffer
+//   firstBinding + 4 "DrawObjects": uvec2(transform index, material layer) per command, read as instanced vertex attribute 3
+class GpuDrivenRenderer
+{
+public:
+    GpuDrivenRenderer(GLuint firstBinding);
+    ~GpuDrivenRenderer();
+
+    GpuDrivenRenderer(const GpuDrivenRenderer&) = delete;
+    GpuDrivenRenderer& operator=(const GpuDrivenRenderer&) = delete;
+
+public:
+    // copies the LOD 0 geometry of every mesh into the shared buffers
+    void AddModel(const Model& model);
+    // rebuilds the objects when the renderables changed since the last call
+    void UpdateObjects(const EntityStore& entities, uint32_t requiredFlags, uint32_t excludedFlags);
+
+    // hiZ: also test against the pyramid of the last UpdateHiZ, ignored when there is none
+    void Cull(const glm::mat4& viewProjection, bool hiZ);
+    // shader.vert, the object index comes from the instanced attribute
+    void Draw(GLuint shaderId);
+
+    // nullptr: every mesh binds its own textures. "arrays" has to outlive its use
+    void SetMaterialArrays(const MaterialArrays* arrays);
+
+    // copies the bound framebuffer's depth and builds the max-depth pyramid for the next frame's Cull
+    void UpdateHiZ(const glm::mat4& viewProjection, int screenWidth, int screenHeight);
+
+public:
+    size_t GetObjectCount() const { return mObjectCount; }
+    size_t GetBatchCount() const { return mBatches.size(); }
+    // of the last Draw
+    size_t GetDrawCallCount() const { return mDrawCallCount; }
+    // objects that passed culling, a few frames old so reading it never stalls
+    size_t GetDrawnCount() const { return mDrawnCount; }
+    bool IsUsingIndirectCount() const { return mMultiDrawIndirectCount != nullptr; }
+
+private:
+    // std430 layouts of gpu_cull.comp
+    struct GpuBatch
+    {
+        glm::vec4 boundsMin;  // mesh space
+        glm::vec4 boundsMax;
+        GLuint indexCount;
+        GLuint firstIndex;
+        GLint baseVertex;
+        GLuint commandOffset;
+        GLuint materialLayer;
+        GLuint padding[3];
+    };
+
+    struct DrawCommand
+    {
+        GLuint count;
+        GLuint instanceCount;
+        GLuint firstIndex;
+        GLint baseVertex;
+        GLuint baseInstance;
+    };
+
+    struct Batch
+    {
+        const Mesh* mesh;
+        GLuint commandCapacity;
+        GLuint materialArray;  // 0: textures bound per mesh
+    };
+
+    static constexpr int StatsLatency = 3;
+
+private:
+    void UploadGeometry();
+    void Upload(GLuint buffer, GLsizeiptr& capacity, const void* data, GLsizeiptr size);
+    void ResizeHiZ(int width, int height);
+
+private:
+    GLuint mFirstBinding;
+    PFNGLMULTIDRAWELEMENTSINDIRECTCOUNTPROC mMultiDrawIndirectCount = nullptr;
+
+    // shared geometry
+    std::vector<Vertex> mVertices;
+    std::vector<GLuint> mIndices;
+    bool mGeometryDirty = false;
+    GLuint mVAO = 0, mVBO = 0, mEBO = 0;
+
+    std::vector<Batch> mBatches;
+    std::vector<GpuBatch> mGpuBatches;
+    std::unordered_map<const Model*, uint32_t> mModelBatches;  // first batch of each model
+    std::vector<uint32_t> mDrawOrder;                          // batches by material array, in command order
+    const MaterialArrays* mMaterialArrays = nullptr;
+    size_t mDrawCallCount = 0;
+
+    std::vector<glm::uvec2> mObjects;
+    std::vector<DrawItem> mRenderables;
+    size_t mObjectCount = 0;
+    uint32_t mRenderVersion = 0xFFFFFFFF;
+
+    GLuint mObjectBuffer = 0, mBatchBuffer = 0, mCommandBuffer = 0, mCountBuffer = 0, mDrawObjectBuffer = 0;
+    GLsizeiptr mObjectCapacity = 0, mBatchCapacity = 0, mCommandCapacity = 0, mCountCapacity = 0, mDrawObjectCapacity = 0;
+
+    std::unique_ptr<Shader> mCullShader;
+    std::unique_ptr<Shader> mHiZShader;
+
+    // Hi-Z pyramid of last frame
+    GLuint mDepthCopy = 0, mHiZ = 0;
+    int mHiZWidth = 0, mHiZHeight = 0, mHiZLevels = 0;
+    bool mHiZValid = false;
+    glm::mat4 mHiZViewProjection = glm::mat4(1.0f);
+
+    // draw count readback ring
+    GLuint mStatsBuffers[StatsLatency] = {};
+    uint32_t mStatsFrames = 0;  // copies since the buffers were resized
+    size_t mDrawnCount = 0;
+};
@@ -0,0 +1,400 @@
+#include "ImpostorRenderer.h"
+
+#include <gl/gl3w.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Frustum.h"
+#include "Model.h"
+#include "SceneGraph.h"
+#include "Shader.h"
+#include "TransformBuffer.h"
+
+static constexpr uint32_t ImpostorCacheMagic = 0x504D494D;  // "MIMP"
+static constexpr uint32_t ImpostorCacheVersion = 1;
+static constexpr int AtlasSize = ImpostorRenderer::FrameGrid * ImpostorRenderer::FrameResolution;
+
+// after the material textures (1..), the shadow atlas sits at 0
+static constexpr GLuint AlbedoTextureUnit = 8;
+static constexpr GLuint NormalDepthTextureUnit = 9;
+
+// frame grid coordinate -> view direction, y up octahedral map of the whole sphere.
+// must match OctahedralEncode in impostor.vert
+static glm::vec3 OctahedralDecode(const glm::vec2& p)
+{
+    glm::vec3 d = glm::vec3(p.x, 1.0f - glm::abs(p.x) - glm::abs(p.y), p.y);
+    if (d.y < 0.0f)
+    {
+        float x = (1.0f - glm::abs(d.z)) * (d.x >= 0.0f ? 1.0f : -1.0f);
+        float z = (1.0f - glm::abs(d.x)) * (d.z >= 0.0f ? 1.0f : -1.0f);
+        d.x = x;
+        d.z = z;
+    }
+    return glm::normalize(d);
+}
+
+ImpostorRenderer::ImpostorRenderer(GLuint instanceBinding)
+    : mInstanceBinding(instanceBinding)
+{
+    mBakeShader = std::make_unique<Shader>();
+    mBakeShader->AddShader(GL_VERTEX_SHADER, "resources/impostor_bake.vert");
+    mBakeShader->AddShader(GL_FRAGMENT_SHADER, "resources/impostor_bake.frag");
+    mBakeShader->Link();
+
+    mShader = std::make_unique<Shader>();
+    mShader->AddShader(GL_VERTEX_SHADER, "resources/impostor.vert");
+    mShader->AddShader(GL_FRAGMENT_SHADER, "resources/impostor.frag");
+    mShader->Link();
+    mShader->SetInt("albedoAtlas", AlbedoTextureUnit);
+    mShader->SetInt("normalDepthAtlas", NormalDepthTextureUnit);
+    mShader->SetInt("frameGrid", FrameGrid);
+
+    // quads are expanded from gl_VertexID
+    glGenVertexArrays(1, &mQuadVAO);
+
+    // an empty SSBO can't be bound
+    mInstanceCapacity = 256;
+    glGenBuffers(1, &mInstanceBuffer);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, mInstanceBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, mInstanceCapacity, nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, mInstanceBinding, mInstanceBuffer);
+}
+
+ImpostorRenderer::~ImpostorRenderer()
+{
+    for (auto& [model, atlas] : mAtlases)
+    {
+        glDeleteTextures(1, &atlas.albedo);
+        glDeleteTextures(1, &atlas.normalDepth);
+    }
+    glDeleteVertexArrays(1, &mQuadVAO);
+    glDeleteBuffers(1, &mInstanceBuffer);
+}
+
+void ImpostorRenderer::AddModel(Model& model)
+{
+    if (HasImpostor(&model))
+        return;
+
+    Atlas& atlas = mAtlases[&model];
+    atlas.center = (model.GetBoundsMin() + model.GetBoundsMax()) * 0.5f;
+    atlas.radius = glm::max(glm::length(model.GetBoundsMax() - model.GetBoundsMin()) * 0.5f, 1e-4f);
+
+    auto createTexture = [](GLenum format)
+    {
+        GLuint texture;
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexStorage2D(GL_TEXTURE_2D, 1, format, AtlasSize, AtlasSize);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        return texture;
+    };
+    atlas.albedo = createTexture(GL_RGBA8);
+    atlas.normalDepth = createTexture(GL_RGBA16);
+
+    std::string cachePath = model.GetPath() + ".impostor";
+    uint64_t hash = model.HashGeometry();
+    if (LoadCache(cachePath, hash, atlas))
+    {
+        fmt::print("[IMPOSTOR] Loaded \"{}\"\n", cachePath);
+        return;
+    }
+
+    Bake(model, atlas);
+    SaveCache(cachePath, hash, atlas);
+    fmt::print("[IMPOSTOR] Baked {} views of \"{}\"\n", FrameGrid * FrameGrid, model.GetPath());
+}
+
+void ImpostorRenderer::Bake(Model& model, Atlas& atlas)
+{
+    // node matrices relative to the root, that is the space of the bounds and the atlas
+    TransformBuffer transforms(0);
+    const std::vector<ModelNode>& nodes = model.GetNodes();
+    std::vector<glm::mat4> rootSpace(std::max<size_t>(nodes.size(), 1), glm::mat4(1.0f));
+    for (size_t i = 1; i < nodes.size(); i++)
+        rootSpace[i] = rootSpace[nodes[i].parent] * nodes[i].transform;
+    for (const glm::mat4& world : rootSpace)
+        transforms.Add(world);
+    transforms.Update();
+    transforms.Bind();
+
+    GLuint framebuffer, depth;
+    glGenFramebuffers(1, &framebuffer);
+    glGenRenderbuffers(1, &depth);
+    glBindRenderbuffer(GL_RENDERBUFFER, depth);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, AtlasSize, AtlasSize);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, atlas.albedo, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, atlas.normalDepth, 0);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth);
+    const GLenum drawBuffers[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+    glDrawBuffers(2, drawBuffers);
+
+    // uncovered texels: no coverage, farthest depth
+    const float clearAlbedo[] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    const float clearNormalDepth[] = { 0.5f, 0.5f, 0.5f, 1.0f };
+    glClearBufferfv(GL_COLOR, 0, clearAlbedo);
+    glClearBufferfv(GL_COLOR, 1, clearNormalDepth);
+    glClear(GL_DEPTH_BUFFER_BIT);
+
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+
+    // orthographic views of the bounding sphere, eye on the sphere looking at its center.
+    // the up vector choice must match the quad basis in impostor.vert
+    float r = atlas.radius;
+    glm::mat4 projection = glm::ortho(-r, r, -r, r, 0.0f, 2.0f * r);
+    GLuint shaderId = mBakeShader->GetId();
+    for (int y = 0; y < FrameGrid; y++)
+    {
+        for (int x = 0; x < FrameGrid; x++)
+        {
+            glm::vec2 p = (glm::vec2(x, y) + 0.5f) / static_cast<float>(FrameGrid) * 2.0f - 1.0f;
+            glm::vec3 direction = OctahedralDecode(p);
+            glm::vec3 up = glm::abs(direction.y) > 0.999f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+            glm::mat4 view = glm::lookAt(atlas.center + direction * r, atlas.center, up);
+
+            glViewport(x * FrameResolution, y * FrameResolution, FrameResolution, FrameResolution);
+            mBakeShader->SetUniformMat4("viewProjection", projection * view);
+            model.Draw(shaderId, 0);
+        }
+    }
+
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDeleteFramebuffers(1, &framebuffer);
+    glDeleteRenderbuffers(1, &depth);
+}
+
+bool ImpostorRenderer::LoadCache(const std::string& path, uint64_t hash, Atlas& atlas) const
+{
+    std::ifstream is(path, std::ios::binary);
+    if (!is.is_open())
+        return false;
+
+    auto read = [&is](void* data, size_t size) { return static_cast<bool>(is.read(static_cast<char*>(data), size)); };
+
+    uint32_t magic = 0, version = 0, grid = 0, resolution = 0;
+    uint64_t cachedHash = 0;
+    if (!read(&magic, sizeof(magic)) || !read(&version, sizeof(version)) || !read(&cachedHash, sizeof(cachedHash)) ||
+        !read(&grid, sizeof(grid)) || !read(&resolution, sizeof(resolution)))
+        return false;
+    if (magic != ImpostorCacheMagic || version != ImpostorCacheVersion || cachedHash != hash ||
+        grid != FrameGrid || resolution != FrameResolution)
+        return false;
+
+    size_t texels = static_cast<size_t>(AtlasSize) * AtlasSize;
+    std::vector<uint8_t> albedo(texels * 4);
+    std::vector<uint16_t> normalDepth(texels * 4);
+    if (!read(albedo.data(), albedo.size()) || !read(normalDepth.data(), normalDepth.size() * sizeof(uint16_t)))
+        return false;
+
+    glBindTexture(GL_TEXTURE_2D, atlas.albedo);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, AtlasSize, AtlasSize, GL_RGBA, GL_UNSIGNED_BYTE, albedo.data());
+    glBindTexture(GL_TEXTURE_2D, atlas.normalDepth);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, AtlasSize, AtlasSize, GL_RGBA, GL_UNSIGNED_SHORT, normalDepth.data());
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return true;
+}
+
+void ImpostorRenderer::SaveCache(const std::string& path, uint64_t hash, const Atlas& atlas) const
+{
+    std::ofstream os(path, std::ios::binary);
+    if (!os.is_open())
+    {
+        fmt::print(stderr, "[IMPOSTOR-ERROR] Failed to write \"{}\"\n", path);
+        return;
+    }
+
+    size_t texels = static_cast<size_t>(AtlasSize) * AtlasSize;
+    std::vector<uint8_t> albedo(texels * 4);
+    std::vector<uint16_t> normalDepth(texels * 4);
+    glBindTexture(GL_TEXTURE_2D, atlas.albedo);
+    glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, albedo.data());
+    glBindTexture(GL_TEXTURE_2D, atlas.normalDepth);
+    glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_SHORT, normalDepth.data());
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    auto write = [&os](const void* data, size_t size) { os.write(static_cast<const char*>(data), size); };
+
+    uint32_t grid = FrameGrid, resolution = FrameResolution;
+    write(&ImpostorCacheMagic, sizeof(ImpostorCacheMagic));
+    write(&ImpostorCacheVersion, sizeof(ImpostorCacheVersion));
+    write(&hash, sizeof(hash));
+    write(&grid, sizeof(grid));
+    write(&resolution, sizeof(resolution));
+    write(albedo.data(), albedo.size());
+    write(normalDepth.data(), normalDepth.size() * sizeof(uint16_t));
+}
+
+void ImpostorRenderer::Clear(size_t drawItemCount)
+{
+    mSplitOf.assign(drawItemCount, -1);
+    mSplits.clear();
+    mMeshCopyCount = 0;
+    mImpostorCount = 0;
+}
+
+void ImpostorRenderer::Prepare(const std::vector<DrawItem>& drawList, const SceneGraph& scene, const Frustum& frustum,
+    const glm::vec3& cameraPos, float distance, float fadeWidth)
+{
+    Clear(drawList.size());
+    mInstanceList.clear();
+
+    for (size_t i = 0; i < drawList.size(); i++)
+    {
+        const DrawItem& item = drawList[i];
+        if (item.instanceCount <= 1)
+            continue;
+        auto it = mAtlases.find(item.model);
+        if (it == mAtlases.end())
+            continue;
+
+        const Atlas& atlas = it->second;
+        GLuint stride = item.model->GetNodeCount();
+
+        Split split{};
+        split.model = item.model;
+        split.baseObject = item.baseObject;
+        split.lod = item.lod;
+        split.meshBase = static_cast<GLint>(mInstanceList.size());
+        mFadingList.clear();
+        mImpostorList.clear();
+
+        // mesh fade 1 is fully mesh, 0 fully impostor
+        for (GLsizei copy = 0; copy < item.instanceCount; copy++)
+        {
+            const glm::mat4& world = scene.GetWorld(item.baseObject + copy * stride);
+            glm::vec3 center = glm::vec3(world * glm::vec4(atlas.center, 1.0f));
+            if (!frustum.IntersectsSphere(center, atlas.radius * MaxScale(world)))
+                continue;
+
+            float beyond = glm::length(center - cameraPos) - distance;
+            float fade = fadeWidth > 0.0f ? glm::clamp(1.0f - beyond / fadeWidth, 0.0f, 1.0f) : (beyond < 0.0f ? 1.0f : 0.0f);
+            glm::uvec2 entry = glm::uvec2(static_cast<GLuint>(copy), glm::floatBitsToUint(fade));
+            if (fade >= 1.0f)
+                mInstanceList.emplace_back(entry);
+            else if (fade > 0.0f)
+                mFadingList.emplace_back(entry);
+            if (fade < 1.0f)
+                mImpostorList.emplace_back(entry);
+        }
+
+        split.solidCount = static_cast<GLsizei>(mInstanceList.size()) - split.meshBase;
+        split.fadingCount = static_cast<GLsizei>(mFadingList.size());
+        split.impostorBase = split.meshBase + split.solidCount + split.fadingCount;
+        split.impostorCount = static_cast<GLsizei>(mImpostorList.size());
+
+        // every copy visible and fully mesh, the regular instanced draw is cheaper
+        if (split.solidCount == item.instanceCount)
+        {
+            mInstanceList.resize(split.meshBase);
+            continue;
+        }
+
+        mInstanceList.insert(mInstanceList.end(), mFadingList.begin(), mFadingList.end());
+        mInstanceList.insert(mInstanceList.end(), mImpostorList.begin(), mImpostorList.end());
+        mSplitOf[i] = static_cast<int>(mSplits.size());
+        mSplits.emplace_back(split);
+        mMeshCopyCount += split.solidCount + split.fadingCount;
+        mImpostorCount += split.impostorCount;
+    }
+
+    if (mInstanceList.empty())
+        return;
+
+    GLsizeiptr size = static_cast<GLsizeiptr>(mInstanceList.size() * sizeof(glm::uvec2));
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, mInstanceBuffer);
+    if (size > mInstanceCapacity)
+    {
+        mInstanceCapacity = std::max(size, mInstanceCapacity * 2);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, mInstanceCapacity, nullptr, GL_DYNAMIC_DRAW);
+    }
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, size, mInstanceList.data());
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, mInstanceBinding, mInstanceBuffer);
+}
+
+void ImpostorRenderer::DrawMeshes(GLuint shaderId, size_t item)
+{
+    const Split& split = mSplits[mSplitOf[item]];
+    DrawMeshes(shaderId, split, split.meshBase, split.solidCount, false);
+}
+
+void ImpostorRenderer::DrawMeshesDepth(GLuint shaderId, size_t item)
+{
+    const Split& split = mSplits[mSplitOf[item]];
+    DrawMeshes(shaderId, split, split.meshBase, split.solidCount, true);
+}
+
+void ImpostorRenderer::DrawFadingMeshes(GLuint shaderId)
+{
+    for (const Split& split : mSplits)
+        DrawMeshes(shaderId, split, split.meshBase + split.solidCount, split.fadingCount, false);
+}
+
+void ImpostorRenderer::DrawMeshes(GLuint shaderId, const Split& split, GLint listBase, GLsizei count, bool depthOnly)
+{
+    if (count == 0)
+        return;
+
+    // the list stays selected only for this draw, shadow passes share the depth shader
+    glUseProgram(shaderId);
+    GLint location = glGetUniformLocation(shaderId, "instanceListBase");
+    glUniform1i(location, listBase);
+    if (depthOnly)
+        split.model->DrawDepth(shaderId, split.baseObject, count, split.lod);
+    else
+        split.model->Draw(shaderId, split.baseObject, count, split.lod);
+    glUniform1i(location, -1);
+}
+
+void ImpostorRenderer::DrawImpostors(const glm::mat4& viewProjection, const glm::vec3& cameraPos)
+{
+    if (mImpostorCount == 0)
+        return;
+
+    mShader->SetUniformMat4("viewProjection", viewProjection);
+    mShader->SetUniformVec3("camPos", cameraPos);
+    GLuint shaderId = mShader->GetId();
+
+    glBindVertexArray(mQuadVAO);
+    for (const Split& split : mSplits)
+    {
+        if (split.impostorCount == 0)
+            continue;
+
+        const Atlas& atlas = mAtlases.at(split.model);
+        glActiveTexture(GL_TEXTURE0 + AlbedoTextureUnit);
+        glBindTexture(GL_TEXTURE_2D, atlas.albedo);
+        glActiveTexture(GL_TEXTURE0 + NormalDepthTextureUnit);
+        glBindTexture(GL_TEXTURE_2D, atlas.normalDepth);
+
+        // the root node carries the copy's placement
+        glUniform1i(glGetUniformLocation(shaderId, "objectIndex"), split.baseObject);
+        glUniform1i(glGetUniformLocation(shaderId, "instanceStride"), split.model->GetNodeCount());
+        glUniform1i(glGetUniformLocation(shaderId, "instanceListBase"), split.impostorBase);
+        glUniform3fv(glGetUniformLocation(shaderId, "boundsCenter"), 1, &atlas.center.x);
+        glUniform1f(glGetUniformLocation(shaderId, "boundsRadius"), atlas.radius);
+        glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, split.impostorCount);
+    }
+    glBindVertexArray(0);
+    glActiveTexture(GL_TEXTURE0);
+}
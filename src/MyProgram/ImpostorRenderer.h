@@ -0,0 +1,114 @@
+#pragma once
+
+#include <gl/gl3w.h>
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "EntityStore.h"
+
+class Model;
+class SceneGraph;
+class Shader;
+struct Frustum;
+
+// distant copies of instanced models drawn as camera-facing quads
+// each model is rendered at load from FrameGrid x FrameGrid directions, laid out by an octahedral map of the sphere,
+// into an albedo atlas and a normal + depth atlas (root node space). a quad samples the 4 views around its view
+// direction and writes the stored depth, so impostors intersect meshes correctly.
+// copies inside the crossfade band are drawn both ways with complementary dither patterns (shader.frag, impostor.frag),
+// after the main pass so the depth pre-pass and its GL_EQUAL test only see solid copies
+//   instanceBinding "InstanceList": uvec2(copy, mesh fade as float bits) per kept copy, read by shader.vert,
+//                                   depth.vert and impostor.vert at "instanceListBase"
+class ImpostorRenderer
+{
+public:
+    static constexpr int FrameGrid = 8;
+    static constexpr int FrameResolution = 128;
+
+public:
+    ImpostorRenderer(GLuint instanceBinding);
+    ~ImpostorRenderer();
+
+    ImpostorRenderer(const ImpostorRenderer&) = delete;
+    ImpostorRenderer& operator=(const ImpostorRenderer&) = delete;
+
+public:
+    // bakes the atlases offscreen, or loads them from "<model path>.impostor" while the geometry is unchanged.
+    // binds a temporary TransformBuffer at binding 0, so call it before the scene's buffer is bound
+    void AddModel(Model& model);
+    bool HasImpostor(const Model* model) const { return mAtlases.count(model) != 0; }
+
+    // splits the copies of instanced draw items with an impostor: closer than "distance" they stay meshes,
+    // beyond distance + fadeWidth they become impostors, in between both are drawn. copies outside "frustum" are dropped
+    void Prepare(const std::vector<DrawItem>& drawList, const SceneGraph& scene, const Frustum& frustum,
+        const glm::vec3& cameraPos, float distance, float fadeWidth);
+    // no item is split, every copy is drawn as mesh
+    void Clear(size_t drawItemCount);
+
+    bool IsSplit(size_t item) const { return mSplitOf[item] >= 0; }
+    // copies of a split draw item closer than the crossfade band
+    void DrawMeshes(GLuint shaderId, size_t item);
+    void DrawMeshesDepth(GLuint shaderId, size_t item);
+    // after the main pass: dithered mesh copies of the crossfade band, then all impostors
+    void DrawFadingMeshes(GLuint shaderId);
+    void DrawImpostors(const glm::mat4& viewProjection, const glm::vec3& cameraPos);
+
+public:
+    // lighting uniforms (ClusteredLighting, "lightColor") are set by the caller
+    Shader& GetShader() { return *mShader; }
+    size_t GetMeshCopyCount() const { return mMeshCopyCount; }
+    size_t GetImpostorCount() const { return mImpostorCount; }
+
+private:
+    struct Atlas
+    {
+        GLuint albedo = 0;       // rgb, coverage in alpha
+        GLuint normalDepth = 0;  // root space normal * 0.5 + 0.5, depth across the bounding sphere in alpha
+        glm::vec3 center;        // bounding sphere, root node space
+        float radius;
+    };
+
+    struct Split
+    {
+        Model* model;
+        GLuint baseObject;
+        int lod;
+        GLint meshBase;  // into the instance list, fading copies follow the solid ones
+        GLsizei solidCount;
+        GLsizei fadingCount;
+        GLint impostorBase;
+        GLsizei impostorCount;
+    };
+
+private:
+    void Bake(Model& model, Atlas& atlas);
+    bool LoadCache(const std::string& path, uint64_t hash, Atlas& atlas) const;
+    void SaveCache(const std::string& path, uint64_t hash, const Atlas& atlas) const;
+    void DrawMeshes(GLuint shaderId, const Split& split, GLint listBase, GLsizei count, bool depthOnly);
+
+private:
+    GLuint mInstanceBinding;
+    std::unordered_map<const Model*, Atlas> mAtlases;
+
+    std::unique_ptr<Shader> mBakeShader;
+    std::unique_ptr<Shader> mShader;
+    GLuint mQuadVAO = 0;
+
+    // per draw list entry, index into mSplits or -1
+    std::vector<int> mSplitOf;
+    std::vector<Split> mSplits;
+    std::vector<glm::uvec2> mInstanceList;
+    // gathered per item, appended after its solid copies
+    std::vector<glm::uvec2> mFadingList;
+    std::vector<glm::uvec2> mImpostorList;
+    GLuint mInstanceBuffer = 0;
+    GLsizeiptr mInstanceCapacity = 0;
+
+    size_t mMeshCopyCount = 0;
+    size_t mImpostorCount = 0;
+};
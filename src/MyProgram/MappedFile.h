@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// read-only view of a whole file, pages come in on first touch
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+
+public:
+    // false for missing or empty files
+    bool Open(const std::string& path);
+    void Close();
+
+    const bool IsOpen() const { return mData != nullptr; }
+    const uint8_t* GetData() const { return mData; }
+    const size_t GetSize() const { return mSize; }
+
+private:
+    const uint8_t* mData = nullptr;
+    size_t mSize = 0;
+};
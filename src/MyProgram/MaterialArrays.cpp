@@ -0,0 +1,147 @@
+#include "MaterialArrays.h"
+
+#include <gl/gl3w.h>
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "Mesh.h"
+#include "Model.h"
+#include "TextureResidency.h"
+#include "TextureSource.h"
+#include "TextureUploader.h"
+
+MaterialArrays::MaterialArrays(TextureUploader& uploader, TextureResidency& residency)
+    : mUploader(uploader)
+    , mResidency(residency)
+{
+}
+
+MaterialArrays::~MaterialArrays()
+{
+    glDeleteTextures(static_cast<GLsizei>(mArrays.size()), mArrays.data());
+    mResidency.Reserve(this, 0, 0);
+}
+
+void MaterialArrays::AddModel(const Model& model)
+{
+    for (const Mesh& mesh : model.GetMeshes())
+    {
+        auto diffuse = std::find_if(mesh.textures.begin(), mesh.textures.end(),
+            [](const Texture& texture) { return texture.type == "texture_diffuse"; });
+        if (diffuse == mesh.textures.end())
+            continue;
+
+        mMeshFiles[&mesh] = diffuse->path;
+        if (std::find(mFiles.begin(), mFiles.end(), diffuse->path) == mFiles.end())
+            mFiles.emplace_back(diffuse->path);
+    }
+}
+
+void MaterialArrays::Build()
+{
+    glDeleteTextures(static_cast<GLsizei>(mArrays.size()), mArrays.data());
+    mArrays.clear();
+    mLayers.clear();
+    mBytes = 0;
+    mResidency.Reserve(this, 0, 0);
+    mBuilt = true;
+    if (mFiles.empty())
+        return;
+
+    std::vector<TextureSource> sources(mFiles.size());
+    for (size_t i = 0; i < mFiles.size(); i++)
+        sources[i].file = mFiles[i];
+
+    // same formats and mip chains as the 2D textures, the uploader's size limit included
+    std::vector<UploadedTexture> uploaded;
+    mUploader.Load(sources, uploaded);
+
+    struct Group
+    {
+        GLenum format;
+        GLsizei width, height, levels;
+        std::vector<size_t> textures;
+    };
+    std::vector<Group> groups;
+    for (size_t i = 0; i < uploaded.size(); i++)
+    {
+        if (uploaded[i].texture == 0)
+            continue;
+
+        GLint format;
+        glGetTextureLevelParameteriv(uploaded[i].texture, 0, GL_TEXTURE_INTERNAL_FORMAT, &format);
+        GLsizei width = std::max(uploaded[i].width >> uploaded[i].skippedLevels, 1);
+        GLsizei height = std::max(uploaded[i].height >> uploaded[i].skippedLevels, 1);
+        GLsizei levels = uploaded[i].levelCount - uploaded[i].skippedLevels;
+
+        auto same = [&](const Group& group)
+        { return group.format == static_cast<GLenum>(format) && group.width == width && group.height == height && group.levels == levels; };
+        auto search = std::find_if(groups.begin(), groups.end(), same);
+        if (search == groups.end())
+            search = groups.insert(groups.end(), { static_cast<GLenum>(format), width, height, levels, {} });
+        search->textures.emplace_back(i);
+    }
+
+    for (const Group& group : groups)
+    {
+        // sampling state of the first texture, the format decides the swizzle so it holds for all of them
+        GLuint first = uploaded[group.textures[0]].texture;
+        GLuint array;
+        glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &array);
+        for (GLenum parameter : { GL_TEXTURE_WRAP_S, GL_TEXTURE_WRAP_T, GL_TEXTURE_MIN_FILTER, GL_TEXTURE_MAG_FILTER })
+        {
+            GLint value;
+            glGetTextureParameteriv(first, parameter, &value);
+            glTextureParameteri(array, parameter, value);
+        }
+        GLint swizzle[4];
+        glGetTextureParameteriv(first, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+        glTextureParameteriv(array, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+        glTextureStorage3D(array, group.levels, group.format, group.width, group.height, static_cast<GLsizei>(group.textures.size()));
+
+        // copied on the GPU, level by level
+        for (size_t layer = 0; layer < group.textures.size(); layer++)
+        {
+            size_t i = group.textures[layer];
+            for (GLint level = 0; level < group.levels; level++)
+            {
+                glCopyImageSubData(uploaded[i].texture, GL_TEXTURE_2D, level, 0, 0, 0, array, GL_TEXTURE_2D_ARRAY, level, 0, 0, static_cast<GLint>(layer),
+                    std::max(group.width >> level, 1), std::max(group.height >> level, 1), 1);
+            }
+            mLayers[mFiles[i]] = { array, static_cast<GLuint>(layer) };
+        }
+        mArrays.emplace_back(array);
+    }
+
+    for (const UploadedTexture& texture : uploaded)
+        glDeleteTextures(1, &texture.texture);
+
+    // only the layers count, textures no group took were just deleted
+    size_t bytes = 0;
+    size_t rgba8Bytes = 0;
+    for (const auto& [file, material] : mLayers)
+    {
+        size_t i = std::find(mFiles.begin(), mFiles.end(), file) - mFiles.begin();
+        bytes += uploaded[i].bytes;
+        for (int level = uploaded[i].skippedLevels; level < uploaded[i].levelCount; level++)
+            rgba8Bytes += static_cast<size_t>(std::max(uploaded[i].width >> level, 1)) * std::max(uploaded[i].height >> level, 1) * 4;
+    }
+    mBytes = bytes;
+    mResidency.Reserve(this, bytes, rgba8Bytes);
+
+    fmt::print("[MATERIAL] {} of {} diffuse textures in {} arrays, {:.1f} MB\n",
+        mLayers.size(), mFiles.size(), mArrays.size(), mBytes / (1024.0f * 1024.0f));
+}
+
+MaterialArrays::Material MaterialArrays::GetMaterial(const Mesh& mesh) const
+{
+    auto file = mMeshFiles.find(&mesh);
+    if (file == mMeshFiles.end())
+        return {};
+    auto search = mLayers.find(file->second);
+    return search != mLayers.end() ? search->second : Material{};
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <gl/gl3w.h>
+
+#include <cstddef>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class Mesh;
+class Model;
+class TextureResidency;
+class TextureUploader;
+
+// the diffuse textures of GPU-driven meshes packed into GL_TEXTURE_2D_ARRAY layers, one array per format, size and
+// level count. meshes in the same array only differ by the layer, which GpuDrivenRenderer passes per draw command,
+// so they are drawn by one call without binding textures in between. the layers are a separate full chain copy
+// loaded through the uploader, not streamed, their bytes are reserved in the residency budget. GL thread only
+class MaterialArrays
+{
+public:
+    MaterialArrays(TextureUploader& uploader, TextureResidency& residency);
+    ~MaterialArrays();
+
+    MaterialArrays(const MaterialArrays&) = delete;
+    MaterialArrays& operator=(const MaterialArrays&) = delete;
+
+public:
+    // queues the first diffuse texture of every mesh, Build uploads them
+    void AddModel(const Model& model);
+    // uploads what was queued and rebuilds every array
+    void Build();
+    // false until the first Build
+    const bool IsBuilt() const { return mBuilt; }
+
+    // array 0: the mesh has no layer, its textures are bound the regular way
+    struct Material
+    {
+        GLuint array = 0;
+        GLuint layer = 0;
+    };
+    Material GetMaterial(const Mesh& mesh) const;
+
+public:
+    const size_t GetArrayCount() const { return mArrays.size(); }
+    const size_t GetLayerCount() const { return mLayers.size(); }
+    const size_t GetBytes() const { return mBytes; }
+
+private:
+    TextureUploader& mUploader;
+    TextureResidency& mResidency;
+    std::vector<std::string> mFiles;                          // every queued diffuse file, once
+    std::unordered_map<const Mesh*, std::string> mMeshFiles;
+    std::unordered_map<std::string, Material> mLayers;        // by file, after Build
+    std::vector<GLuint> mArrays;
+    size_t mBytes = 0;
+    bool mBuilt = false;
+};
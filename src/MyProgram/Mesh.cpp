@@ -7,23 +7,70 @@
 #include <cstddef>
 #include <vector>
 #include <string>
+#include <utility>
+
+#include "BindlessMaterials.h"
+#include "TextureResidency.h"
 
 Mesh::Mesh(
     const std::vector<Vertex>& vertices,
     const std::vector<GLuint>& indices,
-    const std::vector<Texture>& textures)
+    const std::vector<Texture>& textures,
+    bool withPositionStream)
     : vertices(vertices),
     indices(indices),
     textures(textures)
 {
+    if (!vertices.empty())
+    {
+        boundsMin = boundsMax = vertices[0].position;
+        for (const Vertex& v : vertices)
+        {
+            boundsMin = glm::min(boundsMin, v.position);
+            boundsMax = glm::max(boundsMax, v.position);
+        }
+    }
+
+    lods.push_back({ 0, static_cast<GLsizei>(indices.size()), 0.0f });
+
     SetupMesh();
+
+    if (withPositionStream)
+        SetupPositionStream();
+}
+
+Mesh::Mesh(Mesh&& other) noexcept
+    : vertices(std::move(other.vertices)),
+    indices(std::move(other.indices)),
+    textures(std::move(other.textures)),
+    lods(std::move(other.lods)),
+    lodIndices(std::move(other.lodIndices)),
+    meshlets(std::move(other.meshlets)),
+    meshletIndices(std::move(other.meshletIndices)),
+    boundsMin(other.boundsMin),
+    boundsMax(other.boundsMax),
+    VAO(std::exchange(other.VAO, 0)),
+    VBO(std::exchange(other.VBO, 0)),
+    EBO(std::exchange(other.EBO, 0)),
+    meshletIndexBase(other.meshletIndexBase),
+    depthVAO(std::exchange(other.depthVAO, 0)),
+    positionVBO(std::exchange(other.positionVBO, 0)),
+    vertexPool(other.vertexPool),
+    pooledBaseVertex(other.pooledBaseVertex),
+    pooledDecode(other.pooledDecode),
+    bindlessMaterials(other.bindlessMaterials),
+    materialId(other.materialId)
+{
 }
 
 Mesh::~Mesh()
 {
     glDeleteBuffers(1, &VBO);
     glDeleteBuffers(1, &EBO);
-    glDeleteBuffers(1, &VAO);
+    glDeleteVertexArrays(1, &VAO);
+
+    glDeleteBuffers(1, &positionVBO);
+    glDeleteVertexArrays(1, &depthVAO);
 }
 
 void Mesh::SetupMesh()
@@ -55,11 +102,94 @@ void Mesh::SetupMesh()
     glBindVertexArray(0);
 }
 
-void Mesh::Draw(GLuint shaderId)
+void Mesh::SetupPositionStream()
 {
+    // 12 bytes per vertex instead of the 32 byte interleaved Vertex,
+    // so depth-only passes fetch only what depth.vert reads
+    std::vector<glm::vec3> positions;
+    positions.reserve(vertices.size());
+    for (const Vertex& v : vertices)
+        positions.emplace_back(v.position);
+
+    glGenVertexArrays(1, &depthVAO);
+    glGenBuffers(1, &positionVBO);
+
+    glBindVertexArray(depthVAO);
+
+    glBindBuffer(GL_ARRAY_BUFFER, positionVBO);
+    glBufferData(GL_ARRAY_BUFFER, positions.size() * sizeof(glm::vec3), positions.data(), GL_STATIC_DRAW);
+
+    // share index buffer with the full VAO
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+
+    // vertex positions
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
+
+    glBindVertexArray(0);
+}
+
+void Mesh::SetLods(const std::vector<std::vector<GLuint>>& levels, const std::vector<float>& errors)
+{
+    lods.resize(1);
+    lodIndices.clear();
+
+    GLsizei offset = static_cast<GLsizei>(indices.size());
+    for (size_t i = 0; i < levels.size(); i++)
+    {
+        lods.push_back({ offset, static_cast<GLsizei>(levels[i].size()), errors[i] });
+        lodIndices.insert(lodIndices.end(), levels[i].begin(), levels[i].end());
+        offset += static_cast<GLsizei>(levels[i].size());
+    }
+
+    UploadIndices();
+}
+
+void Mesh::SetMeshlets(std::vector<Meshlet>&& newMeshlets, std::vector<GLuint>&& newIndices)
+{
+    meshlets = std::move(newMeshlets);
+    meshletIndices = std::move(newIndices);
+    UploadIndices();
+}
+
+void Mesh::UploadIndices()
+{
+    // one buffer for LODs and meshlets, depthVAO shares it so both VAOs see the new data
+    std::vector<GLuint> all;
+    all.reserve(indices.size() + lodIndices.size() + meshletIndices.size());
+    all.insert(all.end(), indices.begin(), indices.end());
+    all.insert(all.end(), lodIndices.begin(), lodIndices.end());
+    meshletIndexBase = static_cast<GLsizei>(all.size());
+    all.insert(all.end(), meshletIndices.begin(), meshletIndices.end());
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, all.size() * sizeof(GLuint), all.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+void Mesh::BindTextures(GLuint shaderId) const
+{
+    // the shader reaches the textures through the material's handles, they only count as used
+    GLint materialLocation = glGetUniformLocation(shaderId, "materialIndex");
+    if (materialId >= 0 && materialLocation >= 0 && bindlessMaterials->IsEnabled())
+    {
+        glUniform1i(materialLocation, materialId);
+        for (const Texture& texture : textures)
+        {
+            if (texture.slot)
+                texture.slot->Use();
+        }
+        return;
+    }
+    glUniform1i(materialLocation, -1);
+
     GLuint diffuseNr = 1;
     GLuint specularNr = 1;
 
+    // streamed textures report the mip level they need, everything else nothing
+    glUniform1i(glGetUniformLocation(shaderId, "texture_diffuse1_feedback"), -1);
+
     for (GLuint i = 0; i < textures.size(); i++)
     {
         std::string number;
@@ -69,15 +199,104 @@ void Mesh::Draw(GLuint shaderId)
         else if (name == "texture_specular")
         number = std::to_string(specularNr++);
 
-        int loc = glGetUniformLocation(shaderId, fmt::format("{}{}", name, number).c_str());
+        std::string uniform = fmt::format("{}{}", name, number);
+        int loc = glGetUniformLocation(shaderId, uniform.c_str());
         glUniform1i(loc, i + 1);
         
+        const TextureSlot* slot = textures[i].slot;
+        if (slot && slot->feedbackId >= 0)
+        {
+            glUniform1i(glGetUniformLocation(shaderId, (uniform + "_feedback").c_str()), slot->feedbackId);
+            glUniform2f(glGetUniformLocation(shaderId, (uniform + "_size").c_str()), static_cast<float>(slot->width), static_cast<float>(slot->height));
+        }
+
         glActiveTexture(GL_TEXTURE1 + i);
-        glBindTexture(GL_TEXTURE_2D, textures[i].id);
+        glBindTexture(GL_TEXTURE_2D, textures[i].slot ? textures[i].slot->Use() : textures[i].id);
     }
     glActiveTexture(GL_TEXTURE1);
+}
 
-    glBindVertexArray(VAO);
-    glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(indices.size()), GL_UNSIGNED_INT, 0);
+void Mesh::SetMaterial(const BindlessMaterials* materials, int material)
+{
+    bindlessMaterials = materials;
+    materialId = material;
+}
+
+void Mesh::SetVertexPool(const VertexPool* pool, GLint baseVertex, const VertexDecode& decode)
+{
+    vertexPool = pool;
+    pooledBaseVertex = baseVertex;
+    pooledDecode = decode;
+}
+
+void Mesh::SetFetchUniforms(GLuint shaderId) const
+{
+    VertexFetch fetch = IsPulled() ? vertexPool->GetFetch() : VertexFetch::Attributes;
+    glUniform1i(glGetUniformLocation(shaderId, "vertexFetch"), static_cast<int>(fetch));
+    if (fetch == VertexFetch::Attributes)
+        return;
+
+    glUniform1i(glGetUniformLocation(shaderId, "vertexBase"), pooledBaseVertex);
+    if (fetch == VertexFetch::PulledQuantized)
+    {
+        glUniform3fv(glGetUniformLocation(shaderId, "positionMin"), 1, &pooledDecode.positionMin.x);
+        glUniform3fv(glGetUniformLocation(shaderId, "positionExtent"), 1, &pooledDecode.positionExtent.x);
+        glUniform4fv(glGetUniformLocation(shaderId, "texCoordRange"), 1, &pooledDecode.texCoordRange.x);
+    }
+}
+
+void Mesh::BindVertexArray(bool depthOnly) const
+{
+    if (IsPulled())
+    {
+        // the element buffer binding is VAO state, the only thing pulled draws change
+        glBindVertexArray(vertexPool->GetVAO());
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        return;
+    }
+
+    // fall back to full vertex layout when no position stream was built
+    glBindVertexArray(depthOnly && depthVAO != 0 ? depthVAO : VAO);
+}
+
+void Mesh::Draw(GLuint shaderId, GLsizei instanceCount, int lod)
+{
+    BindTextures(shaderId);
+
+    const MeshLod& level = lods[ClampLod(lod)];
+    BindVertexArray(false);
+    glDrawElementsInstanced(GL_TRIANGLES, level.indexCount, GL_UNSIGNED_INT,
+        (void*)(level.indexOffset * sizeof(GLuint)), instanceCount);
+    glBindVertexArray(0);
+}
+
+void Mesh::DrawDepth(GLsizei instanceCount, int lod)
+{
+    const MeshLod& level = lods[ClampLod(lod)];
+    BindVertexArray(true);
+    glDrawElementsInstanced(GL_TRIANGLES, level.indexCount, GL_UNSIGNED_INT,
+        (void*)(level.indexOffset * sizeof(GLuint)), instanceCount);
+    glBindVertexArray(0);
+}
+
+void Mesh::DrawMeshlets(GLuint shaderId, const MeshletDrawList& list)
+{
+    if (list.counts.empty())
+        return;
+
+    BindTextures(shaderId);
+
+    BindVertexArray(false);
+    glMultiDrawElements(GL_TRIANGLES, list.counts.data(), GL_UNSIGNED_INT, list.offsets.data(), static_cast<GLsizei>(list.counts.size()));
+    glBindVertexArray(0);
+}
+
+void Mesh::DrawMeshletsDepth(const MeshletDrawList& list)
+{
+    if (list.counts.empty())
+        return;
+
+    BindVertexArray(true);
+    glMultiDrawElements(GL_TRIANGLES, list.counts.data(), GL_UNSIGNED_INT, list.offsets.data(), static_cast<GLsizei>(list.counts.size()));
     glBindVertexArray(0);
 }
\ No newline at end of file
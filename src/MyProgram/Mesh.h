@@ -6,6 +6,12 @@
 #include <string>
 #include <vector>
 
+#include "Meshlet.h"
+#include "VertexPool.h"
+
+class BindlessMaterials;
+struct TextureSlot;
+
 struct Vertex
 {
     glm::vec3 position;
@@ -13,11 +19,20 @@ struct Vertex
     glm::vec2 texCoords;
 };
 
+// one level of detail, a range of the shared index buffer
+struct MeshLod
+{
+    GLsizei indexOffset;  // in indices
+    GLsizei indexCount;
+    float error;          // object space deviation from LOD 0
+};
+
 struct Texture
 {
     GLuint id;
     std::string type;
     std::string path;
+    TextureSlot* slot = nullptr;  // registry textures, bound through the slot since residency swaps "id"
 };
 
 class Mesh 
@@ -26,24 +41,87 @@ public:
     Mesh(
         const std::vector<Vertex>& vertices,
         const std::vector<GLuint>& indices,
-        const std::vector<Texture>& textures
+        const std::vector<Texture>& textures,
+        bool withPositionStream = true
     );
     ~Mesh();
 
+    // Mesh owns GL objects, so it can only be moved
+    Mesh(const Mesh&) = delete;
+    Mesh& operator=(const Mesh&) = delete;
+    Mesh(Mesh&& other) noexcept;
+
 public:
-    void Draw(GLuint shaderId);
+    // "lod" is clamped to the available levels
+    void Draw(GLuint shaderId, GLsizei instanceCount = 1, int lod = 0);
+    // draw positions only, for depth-only passes (shadow map, depth pre-pass)
+    void DrawDepth(GLsizei instanceCount = 1, int lod = 0);
+
+    // replaces LOD 1.. with "levels" (coarser each), they follow LOD 0 in the index buffer
+    void SetLods(const std::vector<std::vector<GLuint>>& levels, const std::vector<float>& errors);
+    const MeshLod& GetLod(int lod) const { return lods[ClampLod(lod)]; }
+    const int GetLodCount() const { return static_cast<int>(lods.size()); }
+
+    // LOD 0 split into meshlets, their index list follows the LODs in the index buffer
+    void SetMeshlets(std::vector<Meshlet>&& newMeshlets, std::vector<GLuint>&& newIndices);
+    const GLsizei GetMeshletIndexBase() const { return meshletIndexBase; }
+    // ranges from CullMeshlets with GetMeshletIndexBase()
+    void DrawMeshlets(GLuint shaderId, const MeshletDrawList& list);
+    void DrawMeshletsDepth(const MeshletDrawList& list);
+
+    // material textures and their sampler uniforms, for draws issued outside Mesh.
+    // with bindless materials enabled and a shader taking "materialIndex", only the material id is set
+    void BindTextures(GLuint shaderId) const;
+    // set by BindlessMaterials::AddModel
+    void SetMaterial(const BindlessMaterials* materials, int material);
+
+    // set by VertexPool::AddModel, "baseVertex" is the first vertex in the pool
+    void SetVertexPool(const VertexPool* pool, GLint baseVertex, const VertexDecode& decode);
+    // "vertexFetch" of the pool's mode, with "vertexBase" and the decode ranges when pulled. per draw, like objectIndex
+    void SetFetchUniforms(GLuint shaderId) const;
+    const bool IsPulled() const { return vertexPool != nullptr && vertexPool->IsPulling(); }
+
     const GLuint getVAO() const { return VAO; }
     const GLuint getVBO() const { return VBO; }
     const GLuint getEBO() const { return EBO; }
+    const GLuint getDepthVAO() const { return depthVAO; }
+    const bool hasPositionStream() const { return depthVAO != 0; }
 
 private:
     void SetupMesh();
+    void SetupPositionStream();
+    void UploadIndices();
+    // the pool's VAO with this mesh's indices when pulled
+    void BindVertexArray(bool depthOnly) const;
+    int ClampLod(int lod) const { return lod < 0 ? 0 : (lod >= GetLodCount() ? GetLodCount() - 1 : lod); }
 
 public:
     std::vector<Vertex> vertices;
     std::vector<GLuint> indices;
     std::vector<Texture> textures;
 
+    // LOD 0 is "indices", coarser levels index the same vertices
+    std::vector<MeshLod> lods;
+    std::vector<GLuint> lodIndices;
+
+    std::vector<Meshlet> meshlets;
+    std::vector<GLuint> meshletIndices;
+
+    // object space AABB of vertices
+    glm::vec3 boundsMin = glm::vec3(0.0f);
+    glm::vec3 boundsMax = glm::vec3(0.0f);
+
 private:
-    GLuint VAO, VBO, EBO;
+    GLuint VAO = 0, VBO = 0, EBO = 0;
+    GLsizei meshletIndexBase = 0;
+
+    // tightly packed vec3 positions sharing EBO, used by depth-only passes
+    GLuint depthVAO = 0, positionVBO = 0;
+
+    const VertexPool* vertexPool = nullptr;
+    GLint pooledBaseVertex = 0;
+    VertexDecode pooledDecode = {};
+
+    const BindlessMaterials* bindlessMaterials = nullptr;
+    int materialId = -1;
 };
\ No newline at end of file
@@ -0,0 +1,296 @@
+#include "MeshSimplifier.h"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <numeric>
+#include <unordered_map>
+#include <vector>
+
+static constexpr uint32_t NotCollapsed = 0xFFFFFFFF;
+
+void MeshSimplifier::Quadric::AddPlane(const glm::dvec3& n, double d, double weight)
+{
+    a[0] += weight * n.x * n.x;
+    a[1] += weight * n.x * n.y;
+    a[2] += weight * n.x * n.z;
+    a[3] += weight * n.x * d;
+    a[4] += weight * n.y * n.y;
+    a[5] += weight * n.y * n.z;
+    a[6] += weight * n.y * d;
+    a[7] += weight * n.z * n.z;
+    a[8] += weight * n.z * d;
+    a[9] += weight * d * d;
+}
+
+void MeshSimplifier::Quadric::Add(const Quadric& q)
+{
+    for (int i = 0; i < 10; i++)
+        a[i] += q.a[i];
+}
+
+double MeshSimplifier::Quadric::Evaluate(const glm::vec3& p) const
+{
+    // sum of squared distances to all planes: p^T * Q * p with p = (x, y, z, 1)
+    double x = p.x, y = p.y, z = p.z;
+    return x * x * a[0] + 2.0 * x * y * a[1] + 2.0 * x * z * a[2] + 2.0 * x * a[3] +
+        y * y * a[4] + 2.0 * y * z * a[5] + 2.0 * y * a[6] +
+        z * z * a[7] + 2.0 * z * a[8] +
+        a[9];
+}
+
+MeshSimplifier::MeshSimplifier(const glm::vec3* positions, size_t vertexCount, const uint32_t* indices, size_t indexCount)
+    : mPositions(positions)
+    , mVertexCount(vertexCount)
+{
+    // weld vertices sharing a position, seams (different normal/uv) stay connected that way
+    std::vector<uint32_t> order(vertexCount);
+    std::iota(order.begin(), order.end(), 0u);
+    auto less = [positions](uint32_t a, uint32_t b)
+    {
+        const glm::vec3& pa = positions[a];
+        const glm::vec3& pb = positions[b];
+        if (pa.x != pb.x) return pa.x < pb.x;
+        if (pa.y != pb.y) return pa.y < pb.y;
+        return pa.z < pb.z;
+    };
+    std::sort(order.begin(), order.end(), less);
+
+    mWeld.resize(vertexCount);
+    std::vector<uint32_t> weldSize;
+    for (size_t i = 0; i < vertexCount; i++)
+    {
+        if (i == 0 || less(order[i - 1], order[i]))
+        {
+            mRepresentative.emplace_back(order[i]);
+            weldSize.emplace_back(0);
+        }
+        mWeld[order[i]] = static_cast<uint32_t>(mRepresentative.size() - 1);
+        weldSize.back()++;
+    }
+
+    size_t weldCount = mRepresentative.size();
+    mLocked.assign(weldCount, 0);
+    for (size_t v = 0; v < weldCount; v++)
+        mLocked[v] = weldSize[v] > 1 ? 1 : 0;
+
+    // triangles in welded space, degenerate ones are dropped
+    for (size_t i = 0; i + 2 < indexCount; i += 3)
+    {
+        uint32_t a = mWeld[indices[i]], b = mWeld[indices[i + 1]], c = mWeld[indices[i + 2]];
+        if (a == b || b == c || c == a)
+            continue;
+
+        mTriangles.insert(mTriangles.end(), { a, b, c });
+        mCorners.insert(mCorners.end(), { indices[i], indices[i + 1], indices[i + 2] });
+    }
+    mTriangleCount = mTriangles.size() / 3;
+    mTriangleAlive.assign(mTriangleCount, 1);
+
+    // edges used by a single triangle are borders, their vertices stay in place
+    std::unordered_map<uint64_t, uint32_t> edgeUse;
+    for (size_t t = 0; t < mTriangleCount; t++)
+    {
+        for (int e = 0; e < 3; e++)
+        {
+            uint32_t a = mTriangles[t * 3 + e], b = mTriangles[t * 3 + (e + 1) % 3];
+            uint64_t key = (static_cast<uint64_t>(std::min(a, b)) << 32) | std::max(a, b);
+            edgeUse[key]++;
+        }
+    }
+    for (const auto& [key, count] : edgeUse)
+    {
+        if (count != 1)
+            continue;
+        mLocked[static_cast<uint32_t>(key >> 32)] = 1;
+        mLocked[static_cast<uint32_t>(key & 0xFFFFFFFF)] = 1;
+    }
+
+    // plane of every triangle goes into the quadrics of its corners
+    mQuadrics.resize(weldCount);
+    mVertexTriangles.resize(weldCount);
+    for (size_t t = 0; t < mTriangleCount; t++)
+    {
+        const uint32_t* tri = &mTriangles[t * 3];
+        glm::dvec3 p0 = glm::dvec3(positions[mRepresentative[tri[0]]]);
+        glm::dvec3 p1 = glm::dvec3(positions[mRepresentative[tri[1]]]);
+        glm::dvec3 p2 = glm::dvec3(positions[mRepresentative[tri[2]]]);
+
+        glm::dvec3 n = glm::cross(p1 - p0, p2 - p0);
+        double length = glm::length(n);
+        if (length > 0.0)
+        {
+            n /= length;
+            Quadric q;
+            q.AddPlane(n, -glm::dot(n, p0), 1.0);
+            for (int c = 0; c < 3; c++)
+                mQuadrics[tri[c]].Add(q);
+        }
+
+        for (int c = 0; c < 3; c++)
+            mVertexTriangles[tri[c]].emplace_back(static_cast<uint32_t>(t));
+    }
+
+    mCollapsedTo.assign(weldCount, NotCollapsed);
+    mVersion.assign(weldCount, 0);
+    for (uint32_t v = 0; v < weldCount; v++)
+        PushCollapses(v);
+}
+
+void MeshSimplifier::PushCollapses(uint32_t v)
+{
+    const glm::vec3& position = mPositions[mRepresentative[v]];
+
+    // both directions, v's quadric changed and its neighbours may be new
+    for (uint32_t t : mVertexTriangles[v])
+    {
+        if (!mTriangleAlive[t])
+            continue;
+
+        for (int c = 0; c < 3; c++)
+        {
+            uint32_t w = mTriangles[t * 3 + c];
+            if (w == v)
+                continue;
+
+            const glm::vec3& other = mPositions[mRepresentative[w]];
+            if (!mLocked[v])
+            {
+                mHeap.push_back({ mQuadrics[v].Evaluate(other), v, w, mVersion[v], mVersion[w] });
+                std::push_heap(mHeap.begin(), mHeap.end(), std::greater<Collapse>());
+            }
+            if (!mLocked[w])
+            {
+                mHeap.push_back({ mQuadrics[w].Evaluate(position), w, v, mVersion[w], mVersion[v] });
+                std::push_heap(mHeap.begin(), mHeap.end(), std::greater<Collapse>());
+            }
+        }
+    }
+}
+
+uint32_t MeshSimplifier::GetTargetCorner(uint32_t from, uint32_t to) const
+{
+    // "from" is unlocked, so it has one original vertex and its triangles lie in one uv/normal chart.
+    // the ones it shares with "to" show which of the welded originals of "to" belongs to that chart
+    uint32_t corner = NotCollapsed;
+    for (uint32_t t : mVertexTriangles[from])
+    {
+        if (!mTriangleAlive[t])
+            continue;
+
+        for (int c = 0; c < 3; c++)
+        {
+            if (mTriangles[t * 3 + c] != to)
+                continue;
+            if (corner != NotCollapsed && corner != mCorners[t * 3 + c])
+                return NotCollapsed;
+            corner = mCorners[t * 3 + c];
+        }
+    }
+    return corner;
+}
+
+bool MeshSimplifier::CanCollapse(uint32_t from, uint32_t to) const
+{
+    // a seam vertex reached from two charts can't take both sets of attributes
+    if (GetTargetCorner(from, to) == NotCollapsed)
+        return false;
+
+    const glm::vec3& target = mPositions[mRepresentative[to]];
+
+    // moving "from" onto "to" must not flip any remaining triangle
+    for (uint32_t t : mVertexTriangles[from])
+    {
+        if (!mTriangleAlive[t])
+            continue;
+
+        const uint32_t* tri = &mTriangles[t * 3];
+        if (tri[0] == to || tri[1] == to || tri[2] == to)
+            continue;
+
+        glm::vec3 before[3], after[3];
+        for (int c = 0; c < 3; c++)
+        {
+            before[c] = mPositions[mRepresentative[tri[c]]];
+            after[c] = tri[c] == from ? target : before[c];
+        }
+
+        glm::vec3 n0 = glm::cross(before[1] - before[0], before[2] - before[0]);
+        glm::vec3 n1 = glm::cross(after[1] - after[0], after[2] - after[0]);
+        if (glm::dot(n0, n1) <= 0.0f)
+            return false;
+    }
+    return true;
+}
+
+void MeshSimplifier::ApplyCollapse(uint32_t from, uint32_t to)
+{
+    uint32_t toVertex = GetTargetCorner(from, to);
+    for (uint32_t t : mVertexTriangles[from])
+    {
+        if (!mTriangleAlive[t])
+            continue;
+
+        uint32_t* tri = &mTriangles[t * 3];
+        if (tri[0] == to || tri[1] == to || tri[2] == to)
+        {
+            mTriangleAlive[t] = 0;
+            mTriangleCount--;
+            continue;
+        }
+
+        for (int c = 0; c < 3; c++)
+        {
+            if (tri[c] == from)
+            {
+                tri[c] = to;
+                mCorners[t * 3 + c] = toVertex;
+            }
+        }
+        mVertexTriangles[to].emplace_back(t);
+    }
+
+    mQuadrics[to].Add(mQuadrics[from]);
+    mCollapsedTo[from] = to;
+    mVersion[from]++;
+    mVersion[to]++;
+
+    PushCollapses(to);
+}
+
+void MeshSimplifier::Simplify(size_t targetIndexCount)
+{
+    while (mTriangleCount * 3 > targetIndexCount && !mHeap.empty())
+    {
+        std::pop_heap(mHeap.begin(), mHeap.end(), std::greater<Collapse>());
+        Collapse collapse = mHeap.back();
+        mHeap.pop_back();
+
+        // entries pushed before either vertex changed are outdated
+        if (collapse.fromVersion != mVersion[collapse.from] || collapse.toVersion != mVersion[collapse.to])
+            continue;
+        if (mCollapsedTo[collapse.from] != NotCollapsed || mCollapsedTo[collapse.to] != NotCollapsed)
+            continue;
+        if (!CanCollapse(collapse.from, collapse.to))
+            continue;
+
+        ApplyCollapse(collapse.from, collapse.to);
+
+        // quadric cost is a sum of squared plane distances, its root bounds the deviation
+        mError = std::max(mError, static_cast<float>(std::sqrt(std::max(collapse.cost, 0.0))));
+    }
+}
+
+void MeshSimplifier::GetIndices(std::vector<uint32_t>& out) const
+{
+    out.clear();
+    out.reserve(mTriangleCount * 3);
+    for (size_t t = 0; t < mTriangleAlive.size(); t++)
+    {
+        if (mTriangleAlive[t])
+            out.insert(out.end(), { mCorners[t * 3], mCorners[t * 3 + 1], mCorners[t * 3 + 2] });
+    }
+}
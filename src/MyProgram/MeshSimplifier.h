@@ -0,0 +1,75 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+// quadric error metric simplification (Garland-Heckbert) with half-edge collapses:
+// a vertex always collapses onto one of its neighbours, so the result indexes the original vertex buffer.
+// vertices on mesh borders or attribute seams (several vertices at one position) are never removed.
+// pure CPU code, no GL calls
+class MeshSimplifier
+{
+public:
+    MeshSimplifier(const glm::vec3* positions, size_t vertexCount, const uint32_t* indices, size_t indexCount);
+
+public:
+    // collapses edges until at most "targetIndexCount" indices are left or nothing can be collapsed.
+    // can be called again with smaller targets to continue from the previous result
+    void Simplify(size_t targetIndexCount);
+
+    // current triangles, indices into the original vertex buffer
+    void GetIndices(std::vector<uint32_t>& out) const;
+    size_t GetIndexCount() const { return mTriangleCount * 3; }
+    // largest geometric deviation (object space distance) introduced so far
+    float GetError() const { return mError; }
+
+private:
+    // symmetric 4x4 matrix, upper triangle
+    struct Quadric
+    {
+        double a[10] = {};
+
+        void AddPlane(const glm::dvec3& n, double d, double weight);
+        void Add(const Quadric& q);
+        double Evaluate(const glm::vec3& p) const;
+    };
+
+    struct Collapse
+    {
+        double cost;
+        uint32_t from, to;
+        uint32_t fromVersion, toVersion;
+        bool operator>(const Collapse& other) const { return cost > other.cost; }
+    };
+
+private:
+    void PushCollapses(uint32_t v);
+    bool CanCollapse(uint32_t from, uint32_t to) const;
+    // the original vertex of "to" the triangles on the from-to edge use, NotCollapsed if they disagree
+    uint32_t GetTargetCorner(uint32_t from, uint32_t to) const;
+    void ApplyCollapse(uint32_t from, uint32_t to);
+
+private:
+    const glm::vec3* mPositions;
+    size_t mVertexCount;
+
+    // position welded vertex of every vertex, and the representative of every welded vertex
+    std::vector<uint32_t> mWeld;
+    std::vector<uint32_t> mRepresentative;
+    std::vector<uint8_t> mLocked;  // border or seam
+
+    std::vector<uint32_t> mTriangles;  // welded vertex indices
+    std::vector<uint32_t> mCorners;    // original vertex indices, same layout
+    std::vector<uint8_t> mTriangleAlive;
+    size_t mTriangleCount = 0;
+
+    std::vector<std::vector<uint32_t>> mVertexTriangles;
+    std::vector<uint32_t> mCollapsedTo;
+    std::vector<uint32_t> mVersion;
+    std::vector<Quadric> mQuadrics;
+
+    std::vector<Collapse> mHeap;
+    float mError = 0.0f;
+};
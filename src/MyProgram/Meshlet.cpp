@@ -0,0 +1,207 @@
+#include "Meshlet.h"
+
+#include <gl/gl3w.h>
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "Frustum.h"
+
+void MeshletDrawList::Clear()
+{
+    counts.clear();
+    offsets.clear();
+    triangleCount = 0;
+    culledTriangleCount = 0;
+}
+
+static void ComputeMeshletBounds(const std::vector<glm::vec3>& positions, const GLuint* indices, Meshlet& meshlet)
+{
+    glm::vec3 boundsMin = positions[indices[0]];
+    glm::vec3 boundsMax = boundsMin;
+    for (GLuint i = 0; i < meshlet.indexCount; i++)
+    {
+        boundsMin = glm::min(boundsMin, positions[indices[i]]);
+        boundsMax = glm::max(boundsMax, positions[indices[i]]);
+    }
+
+    meshlet.center = (boundsMin + boundsMax) * 0.5f;
+    meshlet.radius = 0.0f;
+    for (GLuint i = 0; i < meshlet.indexCount; i++)
+        meshlet.radius = glm::max(meshlet.radius, glm::length(positions[indices[i]] - meshlet.center));
+
+    // normal cone around the average normal, degenerate triangles don't count
+    std::vector<glm::vec3> normals;
+    glm::vec3 axis = glm::vec3(0.0f);
+    for (GLuint i = 0; i < meshlet.indexCount; i += 3)
+    {
+        const glm::vec3& p0 = positions[indices[i]];
+        glm::vec3 n = glm::cross(positions[indices[i + 1]] - p0, positions[indices[i + 2]] - p0);
+        float length = glm::length(n);
+        if (length <= 0.0f)
+            continue;
+
+        normals.emplace_back(n / length);
+        axis += normals.back();
+    }
+
+    meshlet.coneAxis = glm::vec3(0.0f, 0.0f, 1.0f);
+    meshlet.coneCutoff = 1.0f;
+
+    float axisLength = glm::length(axis);
+    if (axisLength <= 0.0f)
+        return;
+    axis /= axisLength;
+
+    float minDot = 1.0f;
+    for (const glm::vec3& n : normals)
+        minDot = glm::min(minDot, glm::dot(n, axis));
+
+    // wider than ~85 degrees some triangle faces the camera from everywhere
+    if (minDot <= 0.1f)
+        return;
+
+    meshlet.coneAxis = axis;
+    meshlet.coneCutoff = glm::sqrt(1.0f - minDot * minDot);
+}
+
+void BuildMeshlets(const std::vector<glm::vec3>& positions, const std::vector<GLuint>& indices,
+    std::vector<Meshlet>& meshlets, std::vector<GLuint>& meshletIndices)
+{
+    meshlets.clear();
+    meshletIndices.clear();
+
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0)
+        return;
+
+    // triangles around each vertex, CSR layout
+    std::vector<uint32_t> adjacencyOffsets(positions.size() + 1, 0);
+    for (GLuint index : indices)
+        adjacencyOffsets[index + 1]++;
+    for (size_t v = 0; v < positions.size(); v++)
+        adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+
+    std::vector<uint32_t> adjacency(indices.size());
+    std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+    for (size_t i = 0; i < indices.size(); i++)
+        adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+
+    std::vector<uint8_t> emitted(triangleCount, 0);
+    std::vector<uint8_t> inMeshlet(positions.size(), 0);
+    std::vector<GLuint> meshletVertices;
+    std::vector<uint32_t> candidates;
+    meshletIndices.reserve(indices.size());
+
+    auto newVertexCount = [&](uint32_t t)
+    {
+        return 3 - inMeshlet[indices[t * 3]] - inMeshlet[indices[t * 3 + 1]] - inMeshlet[indices[t * 3 + 2]];
+    };
+
+    size_t seed = 0;
+    while (true)
+    {
+        while (seed < triangleCount && emitted[seed])
+            seed++;
+        if (seed == triangleCount)
+            break;
+
+        Meshlet meshlet = {};
+        meshlet.indexOffset = static_cast<GLuint>(meshletIndices.size());
+        candidates.assign(1, static_cast<uint32_t>(seed));
+
+        while (meshlet.indexCount / 3 < MeshletMaxTriangles)
+        {
+            candidates.erase(std::remove_if(candidates.begin(), candidates.end(),
+                                 [&emitted](uint32_t t) { return emitted[t] != 0; }),
+                candidates.end());
+
+            // neighbour adding the fewest vertices
+            size_t best = candidates.size();
+            int bestNew = 4;
+            for (size_t c = 0; c < candidates.size(); c++)
+            {
+                int added = newVertexCount(candidates[c]);
+                if (added < bestNew)
+                {
+                    best = c;
+                    bestNew = added;
+                }
+            }
+            if (best == candidates.size() || meshletVertices.size() + bestNew > MeshletMaxVertices)
+                break;
+
+            uint32_t t = candidates[best];
+            emitted[t] = 1;
+            for (int corner = 0; corner < 3; corner++)
+            {
+                GLuint v = indices[t * 3 + corner];
+                meshletIndices.emplace_back(v);
+                if (inMeshlet[v])
+                    continue;
+
+                inMeshlet[v] = 1;
+                meshletVertices.emplace_back(v);
+                for (uint32_t a = adjacencyOffsets[v]; a < adjacencyOffsets[v + 1]; a++)
+                {
+                    if (!emitted[adjacency[a]])
+                        candidates.emplace_back(adjacency[a]);
+                }
+            }
+            meshlet.indexCount += 3;
+        }
+
+        for (GLuint v : meshletVertices)
+            inMeshlet[v] = 0;
+        meshletVertices.clear();
+
+        ComputeMeshletBounds(positions, &meshletIndices[meshlet.indexOffset], meshlet);
+        meshlets.emplace_back(meshlet);
+    }
+}
+
+void CullMeshlets(const std::vector<Meshlet>& meshlets, GLsizei indexBase, const glm::mat4& world,
+    const Frustum& frustum, const glm::vec3& cameraPos, MeshletDrawList& out)
+{
+    glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(world)));
+    float scale = MaxScale(world);
+
+    for (const Meshlet& meshlet : meshlets)
+    {
+        size_t triangles = meshlet.indexCount / 3;
+        out.triangleCount += triangles;
+
+        glm::vec3 center = glm::vec3(world * glm::vec4(meshlet.center, 1.0f));
+        float radius = meshlet.radius * scale;
+        if (!frustum.IntersectsSphere(center, radius))
+        {
+            out.culledTriangleCount += triangles;
+            continue;
+        }
+
+        // every triangle faces away when the camera is behind the cone's back plane
+        if (meshlet.coneCutoff < 1.0f)
+        {
+            glm::vec3 axis = glm::normalize(normalMatrix * meshlet.coneAxis);
+            glm::vec3 toCenter = center - cameraPos;
+            if (glm::dot(toCenter, axis) >= meshlet.coneCutoff * glm::length(toCenter) + radius)
+            {
+                out.culledTriangleCount += triangles;
+                continue;
+            }
+        }
+
+        const void* offset = (void*)((indexBase + meshlet.indexOffset) * sizeof(GLuint));
+        if (!out.counts.empty() &&
+            static_cast<const char*>(out.offsets.back()) + out.counts.back() * sizeof(GLuint) == offset)
+        {
+            out.counts.back() += meshlet.indexCount;
+            continue;
+        }
+        out.counts.emplace_back(meshlet.indexCount);
+        out.offsets.emplace_back(offset);
+    }
+}
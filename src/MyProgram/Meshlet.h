@@ -0,0 +1,46 @@
+#pragma once
+
+#include <gl/gl3w.h>
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <vector>
+
+struct Frustum;
+
+static constexpr size_t MeshletMaxVertices = 64;
+static constexpr size_t MeshletMaxTriangles = 124;
+
+// small cluster of a mesh's triangles, culled as a whole
+struct Meshlet
+{
+    GLuint indexOffset;  // first index in the meshlet index list
+    GLuint indexCount;
+    glm::vec3 center;    // bounding sphere, object space
+    float radius;
+    glm::vec3 coneAxis;  // average triangle normal
+    float coneCutoff;    // sin of the largest angle between a normal and the axis, 1 when it can't be culled
+};
+
+// visible meshlets of one mesh as glMultiDrawElements arguments, neighbouring ranges are merged
+struct MeshletDrawList
+{
+    std::vector<GLsizei> counts;
+    std::vector<const void*> offsets;
+    size_t triangleCount = 0;  // of all tested meshlets
+    size_t culledTriangleCount = 0;
+
+    void Clear();
+};
+
+// greedy partition into meshlets of at most MeshletMaxVertices / MeshletMaxTriangles.
+// a meshlet grows by the neighbouring triangle adding the fewest new vertices, so clusters stay compact.
+// "meshletIndices" holds the triangles reordered meshlet by meshlet
+void BuildMeshlets(const std::vector<glm::vec3>& positions, const std::vector<GLuint>& indices,
+    std::vector<Meshlet>& meshlets, std::vector<GLuint>& meshletIndices);
+
+// appends meshlets touching "frustum" that face the camera, everything world space.
+// "indexBase" is where the meshlet index list starts in the index buffer.
+// cone test expects "world" without strong non-uniform scale
+void CullMeshlets(const std::vector<Meshlet>& meshlets, GLsizei indexBase, const glm::mat4& world,
+    const Frustum& frustum, const glm::vec3& cameraPos, MeshletDrawList& out);
@@ -0,0 +1,246 @@
+#include "MipChain.h"
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <numeric>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "ThreadPool.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MIP_CHAIN_SSE2
+#endif
+
+static constexpr uint32_t MipCacheMagic = 0x5350494D;  // "MIPS"
+static constexpr uint32_t MipCacheVersion = 2;
+// fine enough that the darkest sRGB steps survive the round trip
+static constexpr int LinearSteps = 1 << 14;
+
+// levels follow right after, 32 bytes keep them 16 byte aligned in the mapping
+struct MipCacheHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t hash;
+    uint32_t width;
+    uint32_t height;
+    uint32_t levelCount;
+    uint32_t channels;
+};
+static_assert(sizeof(MipCacheHeader) == 32, "mip cache header layout");
+
+static const std::array<float, 256>& SrgbToLinear()
+{
+    static const std::array<float, 256> table = []()
+    {
+        std::array<float, 256> t;
+        for (int i = 0; i < 256; i++)
+        {
+            float c = i / 255.0f;
+            t[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+        }
+        return t;
+    }();
+    return table;
+}
+
+static const std::array<uint8_t, LinearSteps>& LinearToSrgb()
+{
+    static const std::array<uint8_t, LinearSteps> table = []()
+    {
+        std::array<uint8_t, LinearSteps> t;
+        for (int i = 0; i < LinearSteps; i++)
+        {
+            float l = i / static_cast<float>(LinearSteps - 1);
+            float c = l <= 0.0031308f ? l * 12.92f : 1.055f * std::pow(l, 1.0f / 2.4f) - 0.055f;
+            t[i] = static_cast<uint8_t>(std::clamp(static_cast<int>(c * 255.0f + 0.5f), 0, 255));
+        }
+        return t;
+    }();
+    return table;
+}
+
+size_t MipChain::GetSize() const
+{
+    return std::accumulate(levelSizes.begin(), levelSizes.end(), size_t(0));
+}
+
+// one destination row: average of 2x2 texels, written as float rgba for the next level and as "channels" bytes
+static void DownsampleRow(const float* src, int srcWidth, int srcHeight, int y, int dstWidth, int channels, bool srgb,
+    float* dst, uint8_t* dstBytes)
+{
+    const std::array<uint8_t, LinearSteps>& toSrgb = LinearToSrgb();
+    const float colorScale = srgb ? LinearSteps - 1.0f : 255.0f;
+    // odd sizes repeat the last row / column
+    const float* row0 = src + static_cast<size_t>(std::min(y * 2, srcHeight - 1)) * srcWidth * 4;
+    const float* row1 = src + static_cast<size_t>(std::min(y * 2 + 1, srcHeight - 1)) * srcWidth * 4;
+
+    for (int x = 0; x < dstWidth; x++)
+    {
+        int x0 = std::min(x * 2, srcWidth - 1) * 4;
+        int x1 = std::min(x * 2 + 1, srcWidth - 1) * 4;
+        float* out = dst + static_cast<size_t>(x) * 4;
+        int steps[4];
+#ifdef MIP_CHAIN_SSE2
+        __m128 sum = _mm_add_ps(
+            _mm_add_ps(_mm_loadu_ps(row0 + x0), _mm_loadu_ps(row0 + x1)),
+            _mm_add_ps(_mm_loadu_ps(row1 + x0), _mm_loadu_ps(row1 + x1)));
+        __m128 average = _mm_mul_ps(sum, _mm_set1_ps(0.25f));
+        _mm_storeu_ps(out, average);
+
+        // color to the linear table's steps (or bytes), alpha straight to bytes
+        const __m128 scale = _mm_setr_ps(colorScale, colorScale, colorScale, 255.0f);
+        __m128i rounded = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(average, scale), _mm_set1_ps(0.5f)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(steps), rounded);
+#else
+        for (int ch = 0; ch < 4; ch++)
+        {
+            out[ch] = (row0[x0 + ch] + row0[x1 + ch] + row1[x0 + ch] + row1[x1 + ch]) * 0.25f;
+            steps[ch] = static_cast<int>(out[ch] * (ch < 3 ? colorScale : 255.0f) + 0.5f);
+        }
+#endif
+        uint8_t rgba[4];
+        for (int ch = 0; ch < 3; ch++)
+            rgba[ch] = srgb ? toSrgb[std::clamp(steps[ch], 0, LinearSteps - 1)] : static_cast<uint8_t>(std::clamp(steps[ch], 0, 255));
+        rgba[3] = static_cast<uint8_t>(std::clamp(steps[3], 0, 255));
+
+        // grey sources only keep r (and alpha)
+        uint8_t* bytes = dstBytes + static_cast<size_t>(x) * channels;
+        bytes[0] = rgba[0];
+        if (channels == 2)
+            bytes[1] = rgba[3];
+        for (int ch = 1; ch < channels && channels > 2; ch++)
+            bytes[ch] = rgba[ch];
+    }
+}
+
+void BuildMipLevels(const uint8_t* pixels, int width, int height, int channels, bool srgb, ThreadPool& pool,
+    std::vector<std::vector<uint8_t>>& levels)
+{
+    size_t pixelCount = static_cast<size_t>(width) * height;
+    levels.assign(1, std::vector<uint8_t>(pixels, pixels + pixelCount * channels));
+
+    // filtered as rgba floats from the previous level, so rounding doesn't pile up down the chain
+    const std::array<float, 256>& toLinear = SrgbToLinear();
+    auto color = [&toLinear, srgb](uint8_t value) { return srgb ? toLinear[value] : value / 255.0f; };
+    std::vector<float> linear(pixelCount * 4);
+    for (size_t i = 0; i < pixelCount; i++)
+    {
+        const uint8_t* src = pixels + i * channels;
+        float* dst = linear.data() + i * 4;
+        dst[0] = color(src[0]);
+        dst[1] = channels >= 3 ? color(src[1]) : dst[0];
+        dst[2] = channels >= 3 ? color(src[2]) : dst[0];
+        dst[3] = channels == 2 ? src[1] / 255.0f : channels == 4 ? src[3] / 255.0f : 1.0f;
+    }
+
+    std::vector<float> next;
+    while (width > 1 || height > 1)
+    {
+        int dstWidth = std::max(width / 2, 1);
+        int dstHeight = std::max(height / 2, 1);
+        next.resize(static_cast<size_t>(dstWidth) * dstHeight * 4);
+        levels.emplace_back(static_cast<size_t>(dstWidth) * dstHeight * channels);
+        uint8_t* bytes = levels.back().data();
+
+        pool.ParallelFor(dstHeight, [&](size_t y)
+            {
+                DownsampleRow(linear.data(), width, height, static_cast<int>(y), dstWidth, channels, srgb,
+                    next.data() + y * dstWidth * 4, bytes + y * dstWidth * channels);
+            });
+
+        std::swap(linear, next);
+        width = dstWidth;
+        height = dstHeight;
+    }
+}
+
+static bool MapCache(const std::string& path, uint64_t hash, MipChain& out)
+{
+    if (!out.file.Open(path) || out.file.GetSize() < sizeof(MipCacheHeader))
+        return false;
+
+    MipCacheHeader header;
+    std::memcpy(&header, out.file.GetData(), sizeof(header));
+    if (header.magic != MipCacheMagic || header.version != MipCacheVersion || header.hash != hash)
+        return false;
+
+    out.width = static_cast<int>(header.width);
+    out.height = static_cast<int>(header.height);
+    out.channels = static_cast<int>(header.channels);
+    out.fileOffset = sizeof(MipCacheHeader);
+    out.levelSizes.clear();
+    for (uint32_t level = 0; level < header.levelCount; level++)
+    {
+        size_t w = std::max(out.width >> level, 1), h = std::max(out.height >> level, 1);
+        out.levelSizes.emplace_back(w * h * out.channels);
+    }
+    return out.file.GetSize() >= out.fileOffset + out.GetSize();
+}
+
+static void SaveCache(const std::string& path, uint64_t hash, const MipChain& chain)
+{
+    std::ofstream os(path, std::ios::binary);
+    if (!os.is_open())
+    {
+        fmt::print(stderr, "[TEXTURE-ERROR] Failed to write \"{}\"\n", path);
+        return;
+    }
+
+    MipCacheHeader header = { MipCacheMagic, MipCacheVersion, hash,
+        static_cast<uint32_t>(chain.width), static_cast<uint32_t>(chain.height), static_cast<uint32_t>(chain.levelSizes.size()), static_cast<uint32_t>(chain.channels) };
+    os.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    os.write(reinterpret_cast<const char*>(chain.data.data()), chain.data.size());
+}
+
+bool LoadOrBuildMipChain(const TextureSource& source, ThreadPool& pool, MipChain& out, bool quiet)
+{
+    uint64_t hash;
+    if (!HashTextureSource(source, hash))
+        return false;
+
+    std::string cachePath = source.GetName() + ".mips";
+    if (MapCache(cachePath, hash, out))
+    {
+        if (!quiet)
+            fmt::print("[TEXTURE-INFO] Mapped cached \"{}\"\n", cachePath);
+        return true;
+    }
+    out.file.Close();
+
+    TextureImage image;
+    if (!DecodeTextureSource(source, image))
+        return false;
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::vector<uint8_t>> levels;
+    BuildMipLevels(image.pixels.data(), image.width, image.height, image.channels, source.semantic == TextureSemantic::Color, pool, levels);
+    auto end = std::chrono::steady_clock::now();
+
+    out.width = image.width;
+    out.height = image.height;
+    out.channels = image.channels;
+    out.fileOffset = 0;
+    out.levelSizes.clear();
+    out.data.clear();
+    for (const std::vector<uint8_t>& level : levels)
+    {
+        out.levelSizes.emplace_back(level.size());
+        out.data.insert(out.data.end(), level.begin(), level.end());
+    }
+
+    SaveCache(cachePath, hash, out);
+    fmt::print("[TEXTURE] Built {} mip levels of \"{}\" in {:.1f} ms\n",
+        levels.size(), source.GetName(), std::chrono::duration<float, std::milli>(end - start).count());
+    return true;
+}
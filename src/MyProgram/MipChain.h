@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "MappedFile.h"
+#include "TextureSource.h"
+
+class ThreadPool;
+
+// 8 bit texels with the full mip chain, largest level first, ready for glTextureSubImage2D
+struct MipChain
+{
+    int width = 0;
+    int height = 0;
+    int channels = 0;  // as in the source, 1: grey, 2: grey + alpha
+    std::vector<size_t> levelSizes;
+    std::vector<uint8_t> data;  // built this run
+    MappedFile file;            // warm load, the levels start "fileOffset" bytes in
+    size_t fileOffset = 0;
+
+    const uint8_t* GetData() const { return file.IsOpen() ? file.GetData() + fileOffset : data.data(); }
+    size_t GetSize() const;
+};
+
+// 2x2 box filter down to 1x1. with "srgb" the color channels are averaged in linear space, alpha always as is.
+// the rows of each level are filtered in parallel, levels[0] is a copy of "pixels"
+void BuildMipLevels(const uint8_t* pixels, int width, int height, int channels, bool srgb, ThreadPool& pool,
+    std::vector<std::vector<uint8_t>>& levels);
+
+// maps "<name>.mips" while it was built from the current file contents, otherwise decodes the source,
+// builds the chain and writes the cache. false if a file can't be read. color is filtered as sRGB.
+// "quiet": no line for a mapped cache, for reloads
+bool LoadOrBuildMipChain(const TextureSource& source, ThreadPool& pool, MipChain& out, bool quiet = false);
@@ -5,18 +5,83 @@
 #include <assimp/postprocess.h>
 
 #include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
 
 #include <fmt/core.h>
 
+#include <algorithm>
 #include <string>
 #include <vector>
 #include <cstring>
+#include <cstdint>
+#include <fstream>
 #include <utility>
 #include <unordered_map>
 
 #include "helper.h"
+#include "SceneGraph.h"
+#include "Frustum.h"
+#include "OcclusionCuller.h"
+#include "OcclusionQueries.h"
+#include "MeshSimplifier.h"
+#include "Meshlet.h"
+#include "ThreadPool.h"
+#include "TextureRegistry.h"
 
-Model::Model(const std::string& path)
+static constexpr uint32_t LodCacheMagic = 0x444F4C4D;  // "MLOD"
+static constexpr uint32_t LodCacheVersion = 1;
+static constexpr float LodRatios[] = { 0.5f, 0.25f, 0.125f };
+// occluder proxy deviation allowed, relative to the mesh's bounds diagonal. the proxy can bulge past the mesh by
+// this much, kept small so it hides next to nothing the real mesh doesn't
+static constexpr float OccluderMaxError = 0.01f;
+
+// FNV-1a over positions and indices, a changed source mesh invalidates its cached chain
+static uint64_t HashMesh(const Mesh& mesh)
+{
+    uint64_t hash = 14695981039346656037ull;
+    auto add = [&hash](const void* data, size_t size)
+    {
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        for (size_t i = 0; i < size; i++)
+            hash = (hash ^ bytes[i]) * 1099511628211ull;
+    };
+    for (const Vertex& v : mesh.vertices)
+        add(&v.position, sizeof(glm::vec3));
+    add(mesh.indices.data(), mesh.indices.size() * sizeof(GLuint));
+    return hash;
+}
+
+static void BuildLodChain(const Mesh& mesh, std::vector<std::vector<GLuint>>& levels, std::vector<float>& errors)
+{
+    // a cache rejected partway may have filled these already
+    levels.clear();
+    errors.clear();
+
+    std::vector<glm::vec3> positions;
+    positions.reserve(mesh.vertices.size());
+    for (const Vertex& v : mesh.vertices)
+        positions.emplace_back(v.position);
+
+    MeshSimplifier simplifier(positions.data(), positions.size(), mesh.indices.data(), mesh.indices.size());
+    size_t previous = mesh.indices.size();
+    for (float ratio : LodRatios)
+    {
+        simplifier.Simplify(static_cast<size_t>(mesh.indices.size() * ratio) / 3 * 3);
+
+        // stop once a level barely shrinks, the rest is locked on borders and seams
+        if (simplifier.GetIndexCount() == 0 || simplifier.GetIndexCount() * 10 > previous * 9)
+            break;
+
+        levels.emplace_back();
+        simplifier.GetIndices(levels.back());
+        errors.emplace_back(simplifier.GetError());
+        previous = simplifier.GetIndexCount();
+    }
+}
+
+Model::Model(const std::string& path, TextureRegistry& textures, bool withPositionStream)
+    : mPath(path)
+    , mWithPositionStream(withPositionStream)
 {
     Assimp::Importer importer;
     const aiScene* scene = importer.ReadFile(path,
@@ -33,34 +98,362 @@ Model::Model(const std::string& path)
     fmt::print("[ASSIMP] Successfully loaded \"{}\"\n", path);
     directory = path.substr(0, path.find_last_of('/'));
 
-    ProcessNodeRecursive(scene->mRootNode, scene);
+    LoadTextures(scene, textures);
+    ProcessNodeRecursive(scene->mRootNode, scene, SceneGraph::NoParent);
+    ComputeBounds();
+    BuildOccluderProxy();
 }
 
 Model::~Model()
 {
-    for (auto texture : mTexturesLoaded)
+    // the handles give the textures back, the registry deletes the ones no other model uses
+}
+
+void Model::Draw(GLuint shaderId, GLuint baseObject, GLsizei instanceCount, int lod)
+{
+    glUseProgram(shaderId);
+    for (size_t i = 0; i < mMeshes.size(); i++)
+    {
+        SetObjectUniforms(shaderId, baseObject, i);
+        mMeshes[i].Draw(shaderId, instanceCount, lod);
+    }
+}
+
+void Model::DrawDepth(GLuint shaderId, GLuint baseObject, GLsizei instanceCount, int lod)
+{
+    glUseProgram(shaderId);
+    for (size_t i = 0; i < mMeshes.size(); i++)
+    {
+        SetObjectUniforms(shaderId, baseObject, i);
+        mMeshes[i].DrawDepth(instanceCount, lod);
+    }
+}
+
+void Model::DrawVisible(GLuint shaderId, GLuint baseObject, const glm::mat4& world, OcclusionCuller& culler, int lod)
+{
+    glUseProgram(shaderId);
+    for (size_t i = 0; i < mMeshes.size(); i++)
     {
-        glDeleteTextures(1, &texture.id);
+        glm::vec3 worldMin, worldMax;
+        TransformAABB(world, mMeshBoundsMin[i], mMeshBoundsMax[i], worldMin, worldMax);
+        if (!culler.IsVisible(worldMin, worldMax))
+            continue;
+
+        SetObjectUniforms(shaderId, baseObject, i);
+        mMeshes[i].Draw(shaderId, 1, lod);
+    }
+}
+
+void Model::Draw(GLuint shaderId, GLuint baseObject, GLsizei instanceCount,
+    const glm::mat4& world, const glm::vec3& groupMin, const glm::vec3& groupMax,
+    OcclusionQueries& queries, int lod)
+{
+    glUseProgram(shaderId);
+    for (size_t i = 0; i < mMeshes.size(); i++)
+    {
+        glm::vec3 worldMin = groupMin, worldMax = groupMax;
+        if (instanceCount == 1)
+            TransformAABB(world, mMeshBoundsMin[i], mMeshBoundsMax[i], worldMin, worldMax);
+
+        // node indices are below 2^32, so object + mesh index is unique per drawn mesh
+        uint64_t key = (static_cast<uint64_t>(baseObject) << 32) | i;
+        OcclusionQueryState& state = queries.Acquire(key, worldMin, worldMax);
+        if (!state.visible)
+        {
+            size_t triangleCount = mMeshes[i].GetLod(lod).indexCount / 3 * instanceCount;
+            queries.Defer({ this, shaderId, baseObject, i, instanceCount, lod, triangleCount, worldMin, worldMax, &state });
+            continue;
+        }
+
+        SetObjectUniforms(shaderId, baseObject, i);
+        bool query = queries.ShouldQuery(state);
+        if (query)
+            queries.BeginQuery(state);
+        mMeshes[i].Draw(shaderId, instanceCount, lod);
+        if (query)
+            queries.EndQuery();
+    }
+}
+
+void Model::DrawMesh(GLuint shaderId, GLuint baseObject, size_t meshIndex, GLsizei instanceCount, int lod)
+{
+    glUseProgram(shaderId);
+    SetObjectUniforms(shaderId, baseObject, meshIndex);
+    mMeshes[meshIndex].Draw(shaderId, instanceCount, lod);
+}
+
+void Model::GenerateLods(ThreadPool& pool)
+{
+    if (mMeshes.empty())
+        return;
+
+    std::vector<std::vector<std::vector<GLuint>>> levels(mMeshes.size());
+    std::vector<std::vector<float>> errors(mMeshes.size());
+
+    std::string cachePath = mPath + ".lod";
+    if (LoadLodCache(cachePath, levels, errors))
+    {
+        fmt::print("[LOD] Loaded \"{}\"\n", cachePath);
+    }
+    else
+    {
+        pool.ParallelFor(mMeshes.size(), [&](size_t i) { BuildLodChain(mMeshes[i], levels[i], errors[i]); });
+        SaveLodCache(cachePath, levels, errors);
+        fmt::print("[LOD] Simplified {} meshes of \"{}\"\n", mMeshes.size(), mPath);
+    }
+
+    // GL uploads stay on this thread
+    mLodErrors.assign(1, 0.0f);
+    for (size_t i = 0; i < mMeshes.size(); i++)
+    {
+        mMeshes[i].SetLods(levels[i], errors[i]);
+        if (mLodErrors.size() < levels[i].size() + 1)
+            mLodErrors.resize(levels[i].size() + 1, 0.0f);
+    }
+
+    // shorter chains keep drawing their coarsest level, so its error counts for all levels beyond
+    for (size_t i = 0; i < mMeshes.size(); i++)
+    {
+        float scale = MaxScale(mMeshRootSpace[i]);
+        for (int lod = 1; lod < GetLodCount(); lod++)
+            mLodErrors[lod] = glm::max(mLodErrors[lod], mMeshes[i].GetLod(lod).error * scale);
+    }
+
+    size_t triangleCount = 0;
+    for (const Mesh& mesh : mMeshes)
+        triangleCount += mesh.indices.size() / 3;
+    BuildOccluderProxy();
+    fmt::print("[LOD] Occluder proxy of \"{}\": {} of {} triangles\n", mPath, mOccluderIndices.size() / 3, triangleCount);
+}
+
+void Model::BuildMeshlets(ThreadPool& pool)
+{
+    std::vector<std::vector<Meshlet>> meshlets(mMeshes.size());
+    std::vector<std::vector<GLuint>> meshletIndices(mMeshes.size());
+    pool.ParallelFor(mMeshes.size(), [&](size_t i)
+        {
+            std::vector<glm::vec3> positions;
+            positions.reserve(mMeshes[i].vertices.size());
+            for (const Vertex& v : mMeshes[i].vertices)
+                positions.emplace_back(v.position);
+            ::BuildMeshlets(positions, mMeshes[i].indices, meshlets[i], meshletIndices[i]);
+        });
+
+    size_t meshletCount = 0;
+    for (size_t i = 0; i < mMeshes.size(); i++)
+    {
+        meshletCount += meshlets[i].size();
+        mMeshes[i].SetMeshlets(std::move(meshlets[i]), std::move(meshletIndices[i]));
+    }
+    mHasMeshlets = !mMeshes.empty();
+    fmt::print("[MESHLET] {} meshlets in \"{}\"\n", meshletCount, mPath);
+}
+
+void Model::CullMeshlets(const glm::mat4& world, const Frustum& frustum, const glm::vec3& cameraPos,
+    std::vector<MeshletDrawList>& out) const
+{
+    out.resize(mMeshes.size());
+    for (size_t i = 0; i < mMeshes.size(); i++)
+    {
+        out[i].Clear();
+        ::CullMeshlets(mMeshes[i].meshlets, mMeshes[i].GetMeshletIndexBase(), world * mMeshRootSpace[i],
+            frustum, cameraPos, out[i]);
+    }
+}
+
+void Model::DrawMeshlets(GLuint shaderId, GLuint baseObject, const std::vector<MeshletDrawList>& lists)
+{
+    glUseProgram(shaderId);
+    for (size_t i = 0; i < mMeshes.size(); i++)
+    {
+        if (lists[i].counts.empty())
+            continue;
+
+        SetObjectUniforms(shaderId, baseObject, i);
+        mMeshes[i].DrawMeshlets(shaderId, lists[i]);
     }
 }
 
-void Model::Draw(GLuint shaderId)
+void Model::DrawMeshletsDepth(GLuint shaderId, GLuint baseObject, const std::vector<MeshletDrawList>& lists)
 {
     glUseProgram(shaderId);
     for (size_t i = 0; i < mMeshes.size(); i++)
-        mMeshes[i].Draw(shaderId);
+    {
+        if (lists[i].counts.empty())
+            continue;
+
+        SetObjectUniforms(shaderId, baseObject, i);
+        mMeshes[i].DrawMeshletsDepth(lists[i]);
+    }
+}
+
+bool Model::LoadLodCache(const std::string& path, std::vector<std::vector<std::vector<GLuint>>>& levels, std::vector<std::vector<float>>& errors) const
+{
+    std::ifstream is(path, std::ios::binary);
+    if (!is.is_open())
+        return false;
+
+    auto read = [&is](void* data, size_t size) { return static_cast<bool>(is.read(static_cast<char*>(data), size)); };
+
+    uint32_t magic = 0, version = 0, meshCount = 0;
+    if (!read(&magic, sizeof(magic)) || !read(&version, sizeof(version)) || !read(&meshCount, sizeof(meshCount)))
+        return false;
+    if (magic != LodCacheMagic || version != LodCacheVersion || meshCount != mMeshes.size())
+        return false;
+
+    for (size_t i = 0; i < mMeshes.size(); i++)
+    {
+        uint64_t hash = 0;
+        uint32_t levelCount = 0;
+        if (!read(&hash, sizeof(hash)) || !read(&levelCount, sizeof(levelCount)) || hash != HashMesh(mMeshes[i]))
+            return false;
+
+        levels[i].resize(levelCount);
+        errors[i].resize(levelCount);
+        for (uint32_t l = 0; l < levelCount; l++)
+        {
+            uint32_t indexCount = 0;
+            if (!read(&errors[i][l], sizeof(float)) || !read(&indexCount, sizeof(indexCount)))
+                return false;
+            if (indexCount > mMeshes[i].indices.size())
+                return false;
+
+            levels[i][l].resize(indexCount);
+            if (!read(levels[i][l].data(), indexCount * sizeof(GLuint)))
+                return false;
+            // a damaged file must not index past the vertices
+            size_t vertexCount = mMeshes[i].vertices.size();
+            if (std::any_of(levels[i][l].begin(), levels[i][l].end(), [vertexCount](GLuint index) { return index >= vertexCount; }))
+                return false;
+        }
+    }
+    return true;
+}
+
+void Model::SaveLodCache(const std::string& path, const std::vector<std::vector<std::vector<GLuint>>>& levels, const std::vector<std::vector<float>>& errors) const
+{
+    std::ofstream os(path, std::ios::binary);
+    if (!os.is_open())
+    {
+        fmt::print(stderr, "[LOD-ERROR] Failed to write \"{}\"\n", path);
+        return;
+    }
+
+    auto write = [&os](const void* data, size_t size) { os.write(static_cast<const char*>(data), size); };
+
+    uint32_t meshCount = static_cast<uint32_t>(mMeshes.size());
+    write(&LodCacheMagic, sizeof(LodCacheMagic));
+    write(&LodCacheVersion, sizeof(LodCacheVersion));
+    write(&meshCount, sizeof(meshCount));
+    for (size_t i = 0; i < mMeshes.size(); i++)
+    {
+        uint64_t hash = HashMesh(mMeshes[i]);
+        uint32_t levelCount = static_cast<uint32_t>(levels[i].size());
+        write(&hash, sizeof(hash));
+        write(&levelCount, sizeof(levelCount));
+        for (uint32_t l = 0; l < levelCount; l++)
+        {
+            uint32_t indexCount = static_cast<uint32_t>(levels[i][l].size());
+            write(&errors[i][l], sizeof(float));
+            write(&indexCount, sizeof(indexCount));
+            write(levels[i][l].data(), indexCount * sizeof(GLuint));
+        }
+    }
+}
+
+uint64_t Model::HashGeometry() const
+{
+    uint64_t hash = 14695981039346656037ull;
+    for (const Mesh& mesh : mMeshes)
+        hash = (hash ^ HashMesh(mesh)) * 1099511628211ull;
+    return hash;
+}
+
+void Model::SetObjectUniforms(GLuint shaderId, GLuint baseObject, size_t meshIndex)
+{
+    glUniform1i(glGetUniformLocation(shaderId, "objectIndex"), baseObject + mMeshNodes[meshIndex]);
+    glUniform1i(glGetUniformLocation(shaderId, "instanceStride"), GetNodeCount());
+    mMeshes[meshIndex].SetFetchUniforms(shaderId);
 }
 
-void Model::ProcessNodeRecursive(aiNode* node, const aiScene* scene)
+void Model::ComputeBounds()
 {
+    if (mMeshes.empty())
+        return;
+
+    // node matrices relative to the root, root's own transform is part of the placement
+    std::vector<glm::mat4> rootSpace(mNodes.size(), glm::mat4(1.0f));
+    for (size_t i = 1; i < mNodes.size(); i++)
+        rootSpace[i] = rootSpace[mNodes[i].parent] * mNodes[i].transform;
+
+    mMeshBoundsMin.resize(mMeshes.size());
+    mMeshBoundsMax.resize(mMeshes.size());
+    mMeshRootSpace.resize(mMeshes.size());
+    for (size_t i = 0; i < mMeshes.size(); i++)
+    {
+        glm::vec3& meshMin = mMeshBoundsMin[i];
+        glm::vec3& meshMax = mMeshBoundsMax[i];
+        mMeshRootSpace[i] = rootSpace[mMeshNodes[i]];
+        TransformAABB(mMeshRootSpace[i], mMeshes[i].boundsMin, mMeshes[i].boundsMax, meshMin, meshMax);
+
+        mBoundsMin = i == 0 ? meshMin : glm::min(mBoundsMin, meshMin);
+        mBoundsMax = i == 0 ? meshMax : glm::max(mBoundsMax, meshMax);
+    }
+}
+
+void Model::BuildOccluderProxy()
+{
+    mOccluderPositions.clear();
+    mOccluderIndices.clear();
+
+    // the culler transforms every proxy vertex each frame, unused ones are left out
+    std::vector<GLuint> remap;
+    for (size_t i = 0; i < mMeshes.size(); i++)
+    {
+        const Mesh& mesh = mMeshes[i];
+        float maxError = OccluderMaxError * glm::length(mesh.boundsMax - mesh.boundsMin);
+        int lod = 0;
+        while (lod + 1 < mesh.GetLodCount() && mesh.GetLod(lod + 1).error <= maxError)
+            lod++;
+
+        // coarser levels follow LOD 0 in the shared index buffer
+        const GLuint* indices = lod == 0 ? mesh.indices.data() : mesh.lodIndices.data() + (mesh.GetLod(lod).indexOffset - mesh.indices.size());
+        size_t indexCount = lod == 0 ? mesh.indices.size() : mesh.GetLod(lod).indexCount;
+
+        remap.assign(mesh.vertices.size(), UINT32_MAX);
+        for (size_t j = 0; j < indexCount; j++)
+        {
+            GLuint& vertex = remap[indices[j]];
+            if (vertex == UINT32_MAX)
+            {
+                vertex = static_cast<GLuint>(mOccluderPositions.size());
+                mOccluderPositions.emplace_back(glm::vec3(mMeshRootSpace[i] * glm::vec4(mesh.vertices[indices[j]].position, 1.0f)));
+            }
+            mOccluderIndices.emplace_back(vertex);
+        }
+    }
+}
+
+void Model::ProcessNodeRecursive(aiNode* node, const aiScene* scene, GLuint parent)
+{
+    // keep the hierarchy, nodes are appended in pre-order so parents come first
+    // aiMatrix4x4 is row-major, glm is column-major
+    ModelNode modelNode;
+    modelNode.parent = parent;
+    modelNode.transform = glm::transpose(glm::make_mat4(&node->mTransformation.a1));
+
+    GLuint nodeIndex = static_cast<GLuint>(mNodes.size());
+    mNodes.emplace_back(modelNode);
+
     for (size_t i = 0; i < node->mNumMeshes; i++)
     {
         aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
         mMeshes.emplace_back(ProcessMesh(mesh, scene));
+        mMeshNodes.emplace_back(nodeIndex);
     }
 
     for (size_t i = 0; i < node->mNumChildren; i++)
-        ProcessNodeRecursive(node->mChildren[i], scene);
+        ProcessNodeRecursive(node->mChildren[i], scene, nodeIndex);
 }
 
 Mesh Model::ProcessMesh(aiMesh* mesh, const aiScene* scene)
@@ -105,51 +498,125 @@ Mesh Model::ProcessMesh(aiMesh* mesh, const aiScene* scene)
 
     if (mesh->mMaterialIndex >= 0)
     {
-        aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
-
-        std::vector<Texture> diffuseMaps = LoadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
-        textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
+        // uploaded by LoadTextures, failed ones are left out
+        std::vector<std::pair<std::string, TextureSource>> materialTextures;
+        GatherMaterialTextures(scene->mMaterials[mesh->mMaterialIndex], materialTextures);
+        for (const auto& [type, source] : materialTextures)
+        {
+            auto search = mLoadedTextures.find(source.GetName());
+            if (search == mLoadedTextures.end() || search->second.id == 0)
+                continue;
 
-        std::vector<Texture> specularMaps = LoadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular");
-        textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
+            Texture texture = search->second;
+            texture.type = type;
+            textures.emplace_back(texture);
+        }
     }
 
-    return Mesh(vertices, indices, textures);
+    return Mesh(vertices, indices, textures, mWithPositionStream);
 }
 
-std::vector<Texture> Model::LoadMaterialTextures(aiMaterial* mat, aiTextureType type, std::string typeName)
+void Model::GatherMaterialTextures(aiMaterial* material, std::vector<std::pair<std::string, TextureSource>>& out)
 {
-    std::vector<Texture> textures;
+    auto file = [material](aiTextureType type)
+    {
+        aiString str;
+        if (material->GetTextureCount(type) == 0)
+            return std::string();
+        material->GetTexture(type, 0, &str);
+        return fmt::format("resources/{}", str.C_Str());
+    };
+    auto add = [&out](const char* type, TextureSemantic semantic, const std::string& file)
+    {
+        TextureSource source;
+        source.semantic = semantic;
+        source.file = file;
+        out.emplace_back(type, source);
+    };
 
-    for (size_t i = 0; i < mat->GetTextureCount(type); i++)
+    for (GLuint i = 0; i < material->GetTextureCount(aiTextureType_DIFFUSE); i++)
+    {
+        aiString str;
+        material->GetTexture(aiTextureType_DIFFUSE, i, &str);
+        add("texture_diffuse", TextureSemantic::Color, fmt::format("resources/{}", str.C_Str()));
+    }
+    for (GLuint i = 0; i < material->GetTextureCount(aiTextureType_SPECULAR); i++)
     {
         aiString str;
-        mat->GetTexture(type, static_cast<GLuint>(i), &str);
-        bool skip = false;
+        material->GetTexture(aiTextureType_SPECULAR, i, &str);
+        add("texture_specular", TextureSemantic::Data, fmt::format("resources/{}", str.C_Str()));
+    }
 
-        std::string path = str.C_Str();
-        auto search = mLoadedTextures.find(path);
-        if (search != mLoadedTextures.end())
-        {
-            textures.emplace_back(search->second);
-            skip = true;
-            break;
-        }
+    // .obj has no roughness slot, map_Ns comes in as shininess. with no ao map the lightmap is the closest
+    std::string roughness = file(aiTextureType_DIFFUSE_ROUGHNESS);
+    if (roughness.empty())
+        roughness = file(aiTextureType_SHININESS);
+    std::string metalness = file(aiTextureType_METALNESS);
+    std::string occlusion = file(aiTextureType_AMBIENT_OCCLUSION);
+    if (occlusion.empty())
+        occlusion = file(aiTextureType_LIGHTMAP);
 
-        if (!skip)
-        {
-            Texture texture;
-            GLuint texId;
-            helper::loadTexture(fmt::format("resources/{}", str.C_Str()).c_str(), texId);
-            texture.id = texId;
-            texture.type = typeName;
-            texture.path = str.C_Str();
+    // two or more grey maps share one texture, r: ao, g: roughness, b: metalness
+    int count = !roughness.empty() + !metalness.empty() + !occlusion.empty();
+    if (count >= 2)
+    {
+        TextureSource source;
+        source.semantic = TextureSemantic::Data;
+        source.packedFiles = { occlusion, roughness, metalness };
+        out.emplace_back("texture_orm", source);
+    }
+    else if (!roughness.empty())
+        add("texture_roughness", TextureSemantic::Data, roughness);
+    else if (!metalness.empty())
+        add("texture_metalness", TextureSemantic::Data, metalness);
+    else if (!occlusion.empty())
+        add("texture_occlusion", TextureSemantic::Data, occlusion);
+}
 
-            textures.emplace_back(texture);
-            // mTexturesLoaded.emplace_back(texture);
-            mLoadedTextures.emplace(std::make_pair(path, texture));
+void Model::GetTextureSlots(std::vector<TextureSlot*>& out) const
+{
+    for (const TextureHandle& handle : mTextureHandles)
+    {
+        if (handle)
+            out.emplace_back(handle.Get());
+    }
+}
+
+void Model::LoadTextures(const aiScene* scene, TextureRegistry& textures)
+{
+    // every texture the meshes reference, once. only shader.frag's diffuse sampler reports the mips it needs
+    std::vector<TextureSource> sources;
+    std::vector<char> streamed;
+    for (size_t i = 0; i < scene->mNumMeshes; i++)
+    {
+        std::vector<std::pair<std::string, TextureSource>> materialTextures;
+        GatherMaterialTextures(scene->mMaterials[scene->mMeshes[i]->mMaterialIndex], materialTextures);
+        for (const auto& [type, source] : materialTextures)
+        {
+            auto same = [&source](const TextureSource& other) { return other.GetName() == source.GetName(); };
+            auto search = std::find_if(sources.begin(), sources.end(), same);
+            if (search == sources.end())
+            {
+                sources.emplace_back(source);
+                streamed.emplace_back(0);
+                search = sources.end() - 1;
+            }
+            if (type == "texture_diffuse")
+                streamed[search - sources.begin()] = 1;
         }
     }
+    if (sources.empty())
+        return;
+
+    textures.Acquire(sources, mTextureHandles, streamed);
 
-    return textures;
-}
\ No newline at end of file
+    // failed sources keep id 0 and are left out of the meshes
+    for (size_t i = 0; i < sources.size(); i++)
+    {
+        Texture texture;
+        texture.slot = mTextureHandles[i].Get();
+        texture.id = texture.slot ? texture.slot->texture : 0;
+        texture.path = sources[i].GetName();
+        mLoadedTextures.emplace(texture.path, texture);
+    }
+}
@@ -6,29 +6,124 @@
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
 
+#include <cstdint>
 #include <vector>
 #include <string>
 #include <unordered_map>
+#include <utility>
 
 #include "Mesh.h"
+#include "TextureRegistry.h"
+#include "TextureSource.h"
+
+class OcclusionCuller;
+class OcclusionQueries;
+class ThreadPool;
+class TextureRegistry;
+struct Frustum;
+
+// one aiNode of the imported hierarchy, stored in topological order
+struct ModelNode
+{
+    GLuint parent;        // index into Model's node list, SceneGraph::NoParent for the root
+    glm::mat4 transform;  // aiNode::mTransformation
+};
 
 class Model
 {
 public:
-    Model(const std::string& path);
+    // referenced textures come from "textures", the ones it doesn't hold yet are streamed in and decoded in parallel
+    Model(const std::string& path, TextureRegistry& textures, bool withPositionStream = true);
     ~Model();
 
 public:
-    void Draw(GLuint shaderId);
+    // each mesh reads TransformBuffer entry "baseObject + its node index".
+    // instanceCount > 1 draws copies whose node ranges follow each other,
+    // GetNodeCount() entries apart. meshes with fewer levels than "lod" use their coarsest
+    void Draw(GLuint shaderId, GLuint baseObject, GLsizei instanceCount = 1, int lod = 0);
+    void DrawDepth(GLuint shaderId, GLuint baseObject, GLsizei instanceCount = 1, int lod = 0);
+    // single copy at "world", meshes whose AABB is hidden in "culler" are skipped
+    void DrawVisible(GLuint shaderId, GLuint baseObject, const glm::mat4& world, OcclusionCuller& culler, int lod = 0);
+    // meshes hidden last frame are handed to "queries" instead of being drawn.
+    // single copies are tested with their own mesh AABB at "world", instanced ones with the group AABB
+    void Draw(GLuint shaderId, GLuint baseObject, GLsizei instanceCount,
+        const glm::mat4& world, const glm::vec3& groupMin, const glm::vec3& groupMax,
+        OcclusionQueries& queries, int lod = 0);
+    void DrawMesh(GLuint shaderId, GLuint baseObject, size_t meshIndex, GLsizei instanceCount = 1, int lod = 0);
+
+    // simplified index buffers (50%, 25%, 12.5%) for every mesh, meshes are simplified in parallel.
+    // results are cached next to the model file and reused while the mesh data is unchanged
+    void GenerateLods(ThreadPool& pool);
+
+    // splits LOD 0 of every mesh into meshlets, in parallel
+    void BuildMeshlets(ThreadPool& pool);
+    // one list per mesh, only reads the model so copies can be culled from several threads
+    void CullMeshlets(const glm::mat4& world, const Frustum& frustum, const glm::vec3& cameraPos,
+        std::vector<MeshletDrawList>& out) const;
+    void DrawMeshlets(GLuint shaderId, GLuint baseObject, const std::vector<MeshletDrawList>& lists);
+    void DrawMeshletsDepth(GLuint shaderId, GLuint baseObject, const std::vector<MeshletDrawList>& lists);
+
+public:
+    const std::vector<ModelNode>& GetNodes() const { return mNodes; }
+    const std::vector<Mesh>& GetMeshes() const { return mMeshes; }
+    std::vector<Mesh>& GetMeshes() { return mMeshes; }
+    const GLuint GetMeshNode(size_t meshIndex) const { return mMeshNodes[meshIndex]; }
+    const GLuint GetNodeCount() const { return static_cast<GLuint>(mNodes.size()); }
+
+    // AABB of all meshes in the root node's space
+    const glm::vec3& GetBoundsMin() const { return mBoundsMin; }
+    const glm::vec3& GetBoundsMax() const { return mBoundsMax; }
+
+    // position-only copy of every mesh in root node space, rasterized by the CPU occlusion culler.
+    // simplified once the LODs exist, only the vertices it uses
+    const std::vector<glm::vec3>& GetOccluderPositions() const { return mOccluderPositions; }
+    const std::vector<GLuint>& GetOccluderIndices() const { return mOccluderIndices; }
+
+    // levels of the mesh with the longest chain, error is the worst mesh's in root node space
+    const int GetLodCount() const { return static_cast<int>(mLodErrors.size()); }
+    const float GetLodError(int lod) const { return mLodErrors[lod]; }
+    const bool HasMeshlets() const { return mHasMeshlets; }
+
+    // the registry textures the model holds, failed ones left out
+    void GetTextureSlots(std::vector<TextureSlot*>& out) const;
+
+    const std::string& GetPath() const { return mPath; }
+    // changes with any mesh's positions or indices, for caches derived from the model
+    uint64_t HashGeometry() const;
 
 private:
-    void ProcessNodeRecursive(aiNode* node, const aiScene* scene);
+    void ProcessNodeRecursive(aiNode* node, const aiScene* scene, GLuint parent);
+    void SetObjectUniforms(GLuint shaderId, GLuint baseObject, size_t meshIndex);
+    void ComputeBounds();
+    // from each mesh's coarsest LOD within OccluderMaxError
+    void BuildOccluderProxy();
     Mesh ProcessMesh(aiMesh* mesh, const aiScene* scene);
-    std::vector<Texture> LoadMaterialTextures(aiMaterial* mat, aiTextureType type, std::string typeName);
+    bool LoadLodCache(const std::string& path, std::vector<std::vector<std::vector<GLuint>>>& levels, std::vector<std::vector<float>>& errors) const;
+    void SaveLodCache(const std::string& path, const std::vector<std::vector<std::vector<GLuint>>>& levels, const std::vector<std::vector<float>>& errors) const;
+    void LoadTextures(const aiScene* scene, TextureRegistry& textures);
+    // sampler type and source of every texture "material" uses, grey PBR maps packed into one texture
+    static void GatherMaterialTextures(aiMaterial* material, std::vector<std::pair<std::string, TextureSource>>& out);
 
 private:
     std::vector<Mesh> mMeshes;
+    std::vector<GLuint> mMeshNodes;  // node index of each mesh
+    std::vector<ModelNode> mNodes;
+    glm::vec3 mBoundsMin = glm::vec3(0.0f);
+    glm::vec3 mBoundsMax = glm::vec3(0.0f);
+
+    // root node space AABB and matrix of each mesh
+    std::vector<glm::vec3> mMeshBoundsMin;
+    std::vector<glm::vec3> mMeshBoundsMax;
+    std::vector<glm::mat4> mMeshRootSpace;
+
+    std::vector<glm::vec3> mOccluderPositions;
+    std::vector<GLuint> mOccluderIndices;
+    std::vector<float> mLodErrors = { 0.0f };
+    bool mHasMeshlets = false;
+    std::string mPath;
     std::string directory;
-    std::vector<Texture> mTexturesLoaded;
+    bool mWithPositionStream;
+    // keeps the registry's textures alive as long as the model, by source name
+    std::vector<TextureHandle> mTextureHandles;
     std::unordered_map<std::string, Texture> mLoadedTextures;
 };
\ No newline at end of file
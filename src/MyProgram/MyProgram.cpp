@@ -1,9 +1,56 @@
 #include "App.h"
 
-int main()
+#include <fmt/core.h>
+
+#include <cstdint>
+#include <string>
+
+#include "TextureCompressor.h"
+#include "ThreadPool.h"
+
+int main(int argc, char** argv)
 {
+    // MyProgram --bake-textures [--data] <files>: writes the .dds caches next to the files, no window or GL needed.
+    // files after --data are baked as data (roughness, masks), the ones before as color
+    if (argc > 1 && std::string(argv[1]) == "--bake-textures")
+    {
+        ThreadPool pool;
+        CompressedTexture texture;
+        TextureSemantic semantic = TextureSemantic::Color;
+        for (int i = 2; i < argc; i++)
+        {
+            if (std::string(argv[i]) == "--data")
+            {
+                semantic = TextureSemantic::Data;
+                continue;
+            }
+            TextureSource source;
+            source.semantic = semantic;
+            source.file = argv[i];
+            LoadOrCompressTexture(source, TextureCompression::High, pool, texture);
+        }
+        return 0;
+    }
+
     App app(900, 900);
+    bool validate = false;
+    for (int i = 1; i < argc; i++)
+    {
+        // MyProgram --low-memory: 128 MB of textures, none loaded above 512x512
+        if (std::string(argv[i]) == "--low-memory")
+            app.SetTextureMemory(128 * 1024 * 1024, 512);
+        // MyProgram --validate-gpu-driven: draws one frame through both paths, exits with 1 when pixels differ
+        if (std::string(argv[i]) == "--validate-gpu-driven")
+            validate = true;
+    }
+    app.SetValidateGpuDriven(validate);
     app.Run();
-    
+
+    if (validate)
+    {
+        int64_t differing = app.GetGpuDrivenValidation();
+        fmt::print("[GPU-DRIVEN] Validation {}\n", differing == 0 ? "passed" : "failed");
+        return differing == 0 ? 0 : 1;
+    }
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,261 @@
+#include "OcclusionCuller.h"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "ThreadPool.h"
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+
+static bool CpuSupportsAVX2()
+{
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    int info[4];
+    __cpuid(info, 1);
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+    bool fma = (info[2] & (1 << 12)) != 0;
+    if (!osxsave || !avx || !fma)
+        return false;
+
+    // OS must save YMM registers
+    if ((_xgetbv(0) & 0x6) != 0x6)
+        return false;
+
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#elif defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#else
+    return false;
+#endif
+}
+
+void RasterizeOccluderScalar(const OccluderTriangle& tri, float* depth, int width, int bandMinY, int bandMaxY)
+{
+    int minY = std::max(tri.minY, bandMinY);
+    int maxY = std::min(tri.maxY, bandMaxY);
+
+    for (int y = minY; y <= maxY; y++)
+    {
+        float py = static_cast<float>(y) + 0.5f;
+        float* row = depth + static_cast<size_t>(y) * width;
+
+        for (int x = tri.minX; x <= tri.maxX; x++)
+        {
+            float px = static_cast<float>(x) + 0.5f;
+
+            bool inside = true;
+            for (int e = 0; e < 3; e++)
+                inside &= tri.edgeA[e] * px + tri.edgeB[e] * py + tri.edgeC[e] >= 0.0f;
+            if (!inside)
+                continue;
+
+            float z = tri.depthA * px + tri.depthB * py + tri.depthC;
+            row[x] = std::min(row[x], z);
+        }
+    }
+}
+
+OcclusionCuller::OcclusionCuller(int width, int height)
+{
+    mWidth = (std::max(width, TileSize) + TileSize - 1) / TileSize * TileSize;
+    mHeight = (std::max(height, TileSize) + TileSize - 1) / TileSize * TileSize;
+    mTilesX = mWidth / TileSize;
+    mTilesY = mHeight / TileSize;
+
+    mDepth.assign(static_cast<size_t>(mWidth) * mHeight, 1.0f);
+    mTileMaxDepth.assign(static_cast<size_t>(mTilesX) * mTilesY, 1.0f);
+
+    mUseAVX2 = CpuSupportsAVX2();
+}
+
+void OcclusionCuller::BeginFrame(const glm::mat4& viewProjection)
+{
+    mViewProjection = viewProjection;
+    mTriangles.clear();
+    mTestedCount = 0;
+    mCulledCount = 0;
+}
+
+void OcclusionCuller::AddOccluder(const glm::vec3* positions, size_t vertexCount,
+    const uint32_t* indices, size_t indexCount,
+    const glm::mat4& model)
+{
+    glm::mat4 mvp = mViewProjection * model;
+
+    mClipScratch.resize(vertexCount);
+    for (size_t i = 0; i < vertexCount; i++)
+        mClipScratch[i] = mvp * glm::vec4(positions[i], 1.0f);
+
+    float w = static_cast<float>(mWidth);
+    float h = static_cast<float>(mHeight);
+
+    for (size_t i = 0; i + 2 < indexCount; i += 3)
+    {
+        float x[3], y[3], z[3];
+        bool clipped = false;
+        for (int k = 0; k < 3; k++)
+        {
+            const glm::vec4& clip = mClipScratch[indices[i + k]];
+            // triangles crossing the near plane are dropped, an occluder may only under-cover
+            if (clip.w < 1e-4f || clip.z < -clip.w)
+            {
+                clipped = true;
+                break;
+            }
+
+            float invW = 1.0f / clip.w;
+            x[k] = (clip.x * invW * 0.5f + 0.5f) * w;
+            y[k] = (clip.y * invW * 0.5f + 0.5f) * h;
+            z[k] = clip.z * invW * 0.5f + 0.5f;
+        }
+        if (clipped)
+            continue;
+
+        // back facing or degenerate
+        float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+        if (area <= 0.0f)
+            continue;
+
+        OccluderTriangle tri;
+        tri.minX = std::max(0, static_cast<int>(std::floor(std::min({ x[0], x[1], x[2] }))));
+        tri.maxX = std::min(mWidth - 1, static_cast<int>(std::ceil(std::max({ x[0], x[1], x[2] }))));
+        tri.minY = std::max(0, static_cast<int>(std::floor(std::min({ y[0], y[1], y[2] }))));
+        tri.maxY = std::min(mHeight - 1, static_cast<int>(std::ceil(std::max({ y[0], y[1], y[2] }))));
+        if (tri.minX > tri.maxX || tri.minY > tri.maxY)
+            continue;
+
+        // edge k goes from vertex k to vertex k + 1
+        for (int k = 0; k < 3; k++)
+        {
+            int n = (k + 1) % 3;
+            tri.edgeA[k] = -(y[n] - y[k]);
+            tri.edgeB[k] = x[n] - x[k];
+            tri.edgeC[k] = -(tri.edgeA[k] * x[k] + tri.edgeB[k] * y[k]);
+        }
+
+        // barycentric weight of vertex k is the edge opposite to it
+        float invArea = 1.0f / area;
+        tri.depthA = (tri.edgeA[1] * z[0] + tri.edgeA[2] * z[1] + tri.edgeA[0] * z[2]) * invArea;
+        tri.depthB = (tri.edgeB[1] * z[0] + tri.edgeB[2] * z[1] + tri.edgeB[0] * z[2]) * invArea;
+        tri.depthC = (tri.edgeC[1] * z[0] + tri.edgeC[2] * z[1] + tri.edgeC[0] * z[2]) * invArea;
+
+        mTriangles.emplace_back(tri);
+    }
+}
+
+void OcclusionCuller::Rasterize(ThreadPool& pool)
+{
+    // one band of whole tile rows per thread, bands never share pixels
+    int bandCount = std::min(mTilesY, static_cast<int>(pool.GetThreadCount()) + 1);
+    int tilesPerBand = (mTilesY + bandCount - 1) / bandCount;
+
+    pool.ParallelFor(bandCount,
+        [this, tilesPerBand](size_t band)
+        {
+            int minY = static_cast<int>(band) * tilesPerBand * TileSize;
+            int maxY = std::min(mHeight, minY + tilesPerBand * TileSize) - 1;
+            if (minY > maxY)
+                return;
+
+            std::fill(
+                mDepth.begin() + static_cast<size_t>(minY) * mWidth,
+                mDepth.begin() + static_cast<size_t>(maxY + 1) * mWidth,
+                1.0f);
+
+            RasterizeBand(minY, maxY);
+            BuildTiles(minY, maxY);
+        });
+}
+
+void OcclusionCuller::RasterizeBand(int bandMinY, int bandMaxY)
+{
+    float* depth = mDepth.data();
+    for (const OccluderTriangle& tri : mTriangles)
+    {
+        if (tri.maxY < bandMinY || tri.minY > bandMaxY)
+            continue;
+
+        if (mUseAVX2)
+            RasterizeOccluderAVX2(tri, depth, mWidth, bandMinY, bandMaxY);
+        else
+            RasterizeOccluderScalar(tri, depth, mWidth, bandMinY, bandMaxY);
+    }
+}
+
+void OcclusionCuller::BuildTiles(int bandMinY, int bandMaxY)
+{
+    for (int ty = bandMinY / TileSize; ty <= bandMaxY / TileSize; ty++)
+    {
+        for (int tx = 0; tx < mTilesX; tx++)
+        {
+            float farthest = 0.0f;
+            for (int y = ty * TileSize; y < (ty + 1) * TileSize; y++)
+            {
+                const float* row = mDepth.data() + static_cast<size_t>(y) * mWidth + tx * TileSize;
+                for (int x = 0; x < TileSize; x++)
+                    farthest = std::max(farthest, row[x]);
+            }
+            mTileMaxDepth[static_cast<size_t>(ty) * mTilesX + tx] = farthest;
+        }
+    }
+}
+
+bool OcclusionCuller::IsVisible(const glm::vec3& worldMin, const glm::vec3& worldMax)
+{
+    mTestedCount++;
+
+    float minX = static_cast<float>(mWidth), maxX = 0.0f;
+    float minY = static_cast<float>(mHeight), maxY = 0.0f;
+    float minZ = 1.0f;
+
+    for (int i = 0; i < 8; i++)
+    {
+        glm::vec3 corner = glm::vec3(
+            (i & 1) ? worldMax.x : worldMin.x,
+            (i & 2) ? worldMax.y : worldMin.y,
+            (i & 4) ? worldMax.z : worldMin.z);
+        glm::vec4 clip = mViewProjection * glm::vec4(corner, 1.0f);
+
+        // box reaches behind the near plane, too close to judge
+        if (clip.w < 1e-4f || clip.z < -clip.w)
+            return true;
+
+        float invW = 1.0f / clip.w;
+        float x = (clip.x * invW * 0.5f + 0.5f) * mWidth;
+        float y = (clip.y * invW * 0.5f + 0.5f) * mHeight;
+        float z = clip.z * invW * 0.5f + 0.5f;
+
+        minX = std::min(minX, x);
+        maxX = std::max(maxX, x);
+        minY = std::min(minY, y);
+        maxY = std::max(maxY, y);
+        minZ = std::min(minZ, z);
+    }
+
+    int x0 = std::max(0, static_cast<int>(std::floor(minX)));
+    int x1 = std::min(mWidth - 1, static_cast<int>(std::ceil(maxX)));
+    int y0 = std::max(0, static_cast<int>(std::floor(minY)));
+    int y1 = std::min(mHeight - 1, static_cast<int>(std::ceil(maxY)));
+    if (x0 > x1 || y0 > y1)
+        return true;  // off screen, left to frustum culling
+
+    for (int ty = y0 / TileSize; ty <= y1 / TileSize; ty++)
+    {
+        for (int tx = x0 / TileSize; tx <= x1 / TileSize; tx++)
+        {
+            if (mTileMaxDepth[static_cast<size_t>(ty) * mTilesX + tx] >= minZ)
+                return true;
+        }
+    }
+
+    mCulledCount++;
+    return false;
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+class ThreadPool;
+
+// screen space occluder triangle with precomputed edge and depth plane equations
+// E(x, y) = a * x + b * y + c, inside when all three edges are >= 0
+struct OccluderTriangle
+{
+    float edgeA[3];
+    float edgeB[3];
+    float edgeC[3];
+    float depthA, depthB, depthC;  // z(x, y) = depthA * x + depthB * y + depthC
+    int minX, maxX, minY, maxY;    // pixel bounds, inclusive
+};
+
+// software occlusion culling
+// occluder triangles are rasterized on worker threads into a small depth buffer,
+// then every 8x8 tile keeps its farthest depth (hierarchical depth buffer).
+// a box is occluded when all tiles under its screen rect are nearer than the box's nearest point.
+// pure CPU code, no GL calls
+class OcclusionCuller
+{
+public:
+    static constexpr int TileSize = 8;
+
+public:
+    // width and height are rounded up to multiples of TileSize
+    OcclusionCuller(int width = 256, int height = 128);
+    ~OcclusionCuller() = default;
+
+public:
+    void BeginFrame(const glm::mat4& viewProjection);
+
+    // positions are in model space, triangles must be counter-clockwise
+    void AddOccluder(const glm::vec3* positions, size_t vertexCount,
+        const uint32_t* indices, size_t indexCount,
+        const glm::mat4& model);
+
+    // rasterizes all occluders and builds the tile depth buffer
+    void Rasterize(ThreadPool& pool);
+
+    bool IsVisible(const glm::vec3& worldMin, const glm::vec3& worldMax);
+
+public:
+    int GetWidth() const { return mWidth; }
+    int GetHeight() const { return mHeight; }
+    const std::vector<float>& GetDepthBuffer() const { return mDepth; }
+    bool IsUsingAVX2() const { return mUseAVX2; }
+
+    size_t GetOccluderTriangleCount() const { return mTriangles.size(); }
+    size_t GetTestedCount() const { return mTestedCount; }
+    size_t GetCulledCount() const { return mCulledCount; }
+
+private:
+    void RasterizeBand(int bandMinY, int bandMaxY);
+    void BuildTiles(int bandMinY, int bandMaxY);
+
+private:
+    int mWidth;
+    int mHeight;
+    int mTilesX;
+    int mTilesY;
+    bool mUseAVX2;
+
+    glm::mat4 mViewProjection = glm::mat4(1.0f);
+
+    // depth in [0, 1], 1 is far
+    std::vector<float> mDepth;
+    std::vector<float> mTileMaxDepth;
+
+    std::vector<OccluderTriangle> mTriangles;
+    std::vector<glm::vec4> mClipScratch;
+
+    size_t mTestedCount = 0;
+    size_t mCulledCount = 0;
+};
+
+// rasterizes "tri" into rows [bandMinY, bandMaxY] of a row-major depth buffer, keeping the nearest depth
+void RasterizeOccluderScalar(const OccluderTriangle& tri, float* depth, int width, int bandMinY, int bandMaxY);
+// same with 8 pixels per step, only call when the CPU supports AVX2 + FMA
+void RasterizeOccluderAVX2(const OccluderTriangle& tri, float* depth, int width, int bandMinY, int bandMaxY);
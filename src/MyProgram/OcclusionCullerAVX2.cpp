@@ -0,0 +1,69 @@
+// built with AVX2/FMA code generation enabled, see CMakeLists.txt
+// only called after a runtime CPU check in OcclusionCuller.cpp
+#include "OcclusionCuller.h"
+
+#include <algorithm>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+
+void RasterizeOccluderAVX2(const OccluderTriangle& tri, float* depth, int width, int bandMinY, int bandMaxY)
+{
+    int minY = std::max(tri.minY, bandMinY);
+    int maxY = std::min(tri.maxY, bandMaxY);
+    if (minY > maxY)
+        return;
+
+    // 8 pixel aligned spans, depth rows are a multiple of 8 wide
+    int minX = tri.minX & ~7;
+    int maxX = tri.maxX;
+
+    const __m256 laneOffsets = _mm256_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f);
+    const __m256 zero = _mm256_setzero_ps();
+
+    __m256 edgeA[3];
+    for (int e = 0; e < 3; e++)
+        edgeA[e] = _mm256_set1_ps(tri.edgeA[e]);
+    __m256 depthA = _mm256_set1_ps(tri.depthA);
+
+    for (int y = minY; y <= maxY; y++)
+    {
+        float py = static_cast<float>(y) + 0.5f;
+        float* row = depth + static_cast<size_t>(y) * width;
+
+        __m256 edgeRow[3];
+        for (int e = 0; e < 3; e++)
+            edgeRow[e] = _mm256_set1_ps(tri.edgeB[e] * py + tri.edgeC[e]);
+        __m256 depthRow = _mm256_set1_ps(tri.depthB * py + tri.depthC);
+
+        for (int x = minX; x <= maxX; x += 8)
+        {
+            __m256 px = _mm256_add_ps(_mm256_set1_ps(static_cast<float>(x)), laneOffsets);
+
+            __m256 e0 = _mm256_fmadd_ps(edgeA[0], px, edgeRow[0]);
+            __m256 e1 = _mm256_fmadd_ps(edgeA[1], px, edgeRow[1]);
+            __m256 e2 = _mm256_fmadd_ps(edgeA[2], px, edgeRow[2]);
+
+            __m256 inside = _mm256_and_ps(
+                _mm256_and_ps(_mm256_cmp_ps(e0, zero, _CMP_GE_OQ), _mm256_cmp_ps(e1, zero, _CMP_GE_OQ)),
+                _mm256_cmp_ps(e2, zero, _CMP_GE_OQ));
+            if (_mm256_movemask_ps(inside) == 0)
+                continue;
+
+            __m256 z = _mm256_fmadd_ps(depthA, px, depthRow);
+            __m256 old = _mm256_loadu_ps(row + x);
+            __m256 nearest = _mm256_min_ps(old, z);
+            _mm256_storeu_ps(row + x, _mm256_blendv_ps(old, nearest, inside));
+        }
+    }
+}
+
+#else
+
+// compiler or target without AVX2 code generation, never selected at runtime
+void RasterizeOccluderAVX2(const OccluderTriangle& tri, float* depth, int width, int bandMinY, int bandMaxY)
+{
+    RasterizeOccluderScalar(tri, depth, width, bandMinY, bandMaxY);
+}
+
+#endif
@@ -0,0 +1,202 @@
+#include "OcclusionQueries.h"
+
+#include <gl/gl3w.h>
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "Model.h"
+#include "Shader.h"
+
+// entries not drawn for this many frames give their query object back
+static constexpr uint32_t StateLifetime = 120;
+
+OcclusionQueries::OcclusionQueries()
+{
+    mBoxShader = std::make_unique<Shader>();
+    mBoxShader->AddShader(GL_VERTEX_SHADER, "resources/bbox.vert");
+    mBoxShader->AddShader(GL_FRAGMENT_SHADER, "resources/bbox.frag");
+    mBoxShader->Link();
+
+    // unit cube, stretched to the box in the vertex shader
+    const float vertices[] = {
+        0.0f, 0.0f, 0.0f,
+        1.0f, 0.0f, 0.0f,
+        1.0f, 1.0f, 0.0f,
+        0.0f, 1.0f, 0.0f,
+        0.0f, 0.0f, 1.0f,
+        1.0f, 0.0f, 1.0f,
+        1.0f, 1.0f, 1.0f,
+        0.0f, 1.0f, 1.0f,
+    };
+    const GLuint indices[] = {
+        0, 2, 1, 0, 3, 2,  // -z
+        4, 5, 6, 4, 6, 7,  // +z
+        0, 4, 7, 0, 7, 3,  // -x
+        1, 2, 6, 1, 6, 5,  // +x
+        0, 1, 5, 0, 5, 4,  // -y
+        3, 7, 6, 3, 6, 2,  // +y
+    };
+
+    glGenVertexArrays(1, &mBoxVAO);
+    glGenBuffers(1, &mBoxVBO);
+    glGenBuffers(1, &mBoxEBO);
+
+    glBindVertexArray(mBoxVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, mBoxVBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mBoxEBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+    glBindVertexArray(0);
+}
+
+OcclusionQueries::~OcclusionQueries()
+{
+    for (auto& [key, state] : mStates)
+        glDeleteQueries(1, &state.query);
+
+    glDeleteVertexArrays(1, &mBoxVAO);
+    glDeleteBuffers(1, &mBoxVBO);
+    glDeleteBuffers(1, &mBoxEBO);
+}
+
+void OcclusionQueries::BeginFrame(const glm::mat4& viewProjection, const glm::vec3& cameraPos)
+{
+    mViewProjection = viewProjection;
+    mCameraPos = cameraPos;
+    mFrame++;
+
+    mIssuedCount = 0;
+    mResolvedCount = 0;
+    mOccludedCount = 0;
+    mCulledTriangleCount = 0;
+    mDeferred.clear();
+
+    // drop meshes that are no longer drawn (removed entities, shrunk instance grids)
+    for (auto it = mStates.begin(); it != mStates.end();)
+    {
+        OcclusionQueryState& state = it->second;
+        if (!state.pending && mFrame - state.lastUsedFrame > StateLifetime)
+        {
+            glDeleteQueries(1, &state.query);
+            it = mStates.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
+
+OcclusionQueryState& OcclusionQueries::Acquire(uint64_t key, const glm::vec3& worldMin, const glm::vec3& worldMax)
+{
+    OcclusionQueryState& state = mStates[key];
+    if (state.query == 0)
+        glGenQueries(1, &state.query);
+    state.lastUsedFrame = mFrame;
+
+    CollectResult(state);
+
+    // the box would be clipped by the near plane, its query can't be trusted
+    const float margin = 0.1f;
+    if (glm::all(glm::greaterThanEqual(mCameraPos, worldMin - margin)) &&
+        glm::all(glm::lessThanEqual(mCameraPos, worldMax + margin)))
+        state.visible = true;
+
+    return state;
+}
+
+void OcclusionQueries::CollectResult(OcclusionQueryState& state)
+{
+    if (!state.pending)
+        return;
+
+    GLuint available = 0;
+    glGetQueryObjectuiv(state.query, GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available)
+        return;
+
+    GLuint anySamples = 0;
+    glGetQueryObjectuiv(state.query, GL_QUERY_RESULT, &anySamples);
+    state.pending = false;
+    state.visible = anySamples != 0;
+
+    mResolvedCount++;
+    if (!state.visible)
+    {
+        mOccludedCount++;
+        mCulledTriangleCount += state.conditionalTriangles;
+    }
+    state.conditionalTriangles = 0;
+}
+
+bool OcclusionQueries::ShouldQuery(const OcclusionQueryState& state) const
+{
+    return !state.pending && mFrame - state.lastQueryFrame >= static_cast<uint32_t>(mRequeryInterval);
+}
+
+void OcclusionQueries::BeginQuery(OcclusionQueryState& state)
+{
+    glBeginQuery(GL_ANY_SAMPLES_PASSED_CONSERVATIVE, state.query);
+    state.pending = true;
+    state.lastQueryFrame = mFrame;
+    mIssuedCount++;
+}
+
+void OcclusionQueries::EndQuery()
+{
+    glEndQuery(GL_ANY_SAMPLES_PASSED_CONSERVATIVE);
+}
+
+void OcclusionQueries::Defer(const DeferredMesh& mesh)
+{
+    mDeferred.emplace_back(mesh);
+}
+
+void OcclusionQueries::EndFrame()
+{
+    if (mDeferred.empty())
+        return;
+
+    // bounding boxes against the depth of everything visible, no color/depth writes
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    glDepthMask(GL_FALSE);
+
+    mBoxShader->Use();
+    mBoxShader->SetUniformMat4("viewProjection", mViewProjection);
+    GLint boxMinLocation = glGetUniformLocation(mBoxShader->GetId(), "boxMin");
+    GLint boxMaxLocation = glGetUniformLocation(mBoxShader->GetId(), "boxMax");
+
+    glBindVertexArray(mBoxVAO);
+    for (const DeferredMesh& mesh : mDeferred)
+    {
+        // still waiting for an older box query, its result is reused below
+        if (mesh.state->pending)
+            continue;
+
+        glUniform3fv(boxMinLocation, 1, &mesh.boundsMin[0]);
+        glUniform3fv(boxMaxLocation, 1, &mesh.boundsMax[0]);
+
+        BeginQuery(*mesh.state);
+        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+        EndQuery();
+    }
+    glBindVertexArray(0);
+
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    glDepthMask(GL_TRUE);
+
+    // the GPU waits for its own query result, the CPU doesn't
+    for (const DeferredMesh& mesh : mDeferred)
+    {
+        mesh.state->conditionalTriangles += mesh.triangleCount;
+        glBeginConditionalRender(mesh.state->query, GL_QUERY_WAIT);
+        mesh.model->DrawMesh(mesh.shaderId, mesh.baseObject, mesh.meshIndex, mesh.instanceCount, mesh.lod);
+        glEndConditionalRender();
+    }
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <gl/gl3w.h>
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <unordered_map>
+
+class Model;
+class Shader;
+
+// visibility of one drawn mesh, carried over between frames
+struct OcclusionQueryState
+{
+    GLuint query = 0;
+    bool visible = true;        // result of the latest finished query
+    bool pending = false;       // query issued, result not read yet
+    uint32_t lastQueryFrame = 0;
+    uint32_t lastUsedFrame = 0;
+    size_t conditionalTriangles = 0;  // drawn conditionally on the pending query, skipped if it finds nothing
+};
+
+// mesh hidden in the previous frame, drawn after its bounding box is queried
+struct DeferredMesh
+{
+    Model* model;
+    GLuint shaderId;
+    GLuint baseObject;
+    size_t meshIndex;
+    GLsizei instanceCount;
+    int lod;
+    size_t triangleCount;
+    glm::vec3 boundsMin;  // world space
+    glm::vec3 boundsMax;
+    OcclusionQueryState* state;
+};
+
+// hardware occlusion queries with temporal coherence (CHC++ like)
+// visible meshes are drawn right away and re-checked every few frames by a query around their own draw.
+// meshes hidden in the previous frame are deferred until the visible ones filled the depth buffer,
+// then their bounding box is queried and the mesh is conditionally rendered on that result,
+// so the GPU skips it without the CPU ever waiting for a query result
+class OcclusionQueries
+{
+public:
+    OcclusionQueries();
+    ~OcclusionQueries();
+
+    OcclusionQueries(const OcclusionQueries&) = delete;
+    OcclusionQueries& operator=(const OcclusionQueries&) = delete;
+
+public:
+    void BeginFrame(const glm::mat4& viewProjection, const glm::vec3& cameraPos);
+    // issues bounding box queries and conditional draws of the deferred meshes
+    void EndFrame();
+
+    // state of the mesh with this key, finished queries are read back here without waiting
+    OcclusionQueryState& Acquire(uint64_t key, const glm::vec3& worldMin, const glm::vec3& worldMax);
+    // visible meshes are re-queried every "requery interval" frames
+    bool ShouldQuery(const OcclusionQueryState& state) const;
+    void BeginQuery(OcclusionQueryState& state);
+    void EndQuery();
+    void Defer(const DeferredMesh& mesh);
+
+public:
+    void SetRequeryInterval(int frames) { mRequeryInterval = frames < 1 ? 1 : frames; }
+    int GetRequeryInterval() const { return mRequeryInterval; }
+
+    // last frame statistics
+    int GetIssuedCount() const { return mIssuedCount; }
+    int GetResolvedCount() const { return mResolvedCount; }
+    int GetOccludedCount() const { return mOccludedCount; }
+    // triangles the GPU skipped, known once their query is read back, so a frame or more late
+    size_t GetCulledTriangleCount() const { return mCulledTriangleCount; }
+
+private:
+    void CollectResult(OcclusionQueryState& state);
+
+private:
+    std::unique_ptr<Shader> mBoxShader;
+    GLuint mBoxVAO = 0;
+    GLuint mBoxVBO = 0;
+    GLuint mBoxEBO = 0;
+
+    std::unordered_map<uint64_t, OcclusionQueryState> mStates;
+    std::vector<DeferredMesh> mDeferred;
+
+    glm::mat4 mViewProjection = glm::mat4(1.0f);
+    glm::vec3 mCameraPos = glm::vec3(0.0f);
+    uint32_t mFrame = 0;
+    int mRequeryInterval = 4;
+
+    int mIssuedCount = 0;
+    int mResolvedCount = 0;
+    int mOccludedCount = 0;
+    size_t mCulledTriangleCount = 0;
+};
@@ -0,0 +1,99 @@
+#include "SceneGraph.h"
+
+#include <gl/gl3w.h>
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <vector>
+
+#include "helper.h"
+
+GLuint SceneGraph::AddNode(GLuint parent, const glm::mat4& local)
+{
+    GLuint node = static_cast<GLuint>(mParents.size());
+    ASSERT(parent == NoParent || parent < node);
+
+    mParents.emplace_back(parent);
+    mLocals.emplace_back(local);
+    mWorlds.emplace_back(1.0f);
+    mLastDescendant.emplace_back(node);
+    mDirty.emplace_back(1);
+    mChanged.emplace_back(0);
+
+    // new node is the last descendant of all its ancestors
+    for (GLuint p = parent; p != NoParent; p = mParents[p])
+        mLastDescendant[p] = node;
+
+    if (mDirtyBegin == mDirtyEnd)
+        mDirtyBegin = node;
+    mDirtyEnd = node + 1;
+
+    return node;
+}
+
+void SceneGraph::SetLocal(GLuint node, const glm::mat4& local)
+{
+    mLocals[node] = local;
+    mDirty[node] = 1;
+
+    size_t end = static_cast<size_t>(mLastDescendant[node]) + 1;
+    if (mDirtyBegin == mDirtyEnd)
+    {
+        mDirtyBegin = node;
+        mDirtyEnd = end;
+        return;
+    }
+
+    mDirtyBegin = std::min(mDirtyBegin, static_cast<size_t>(node));
+    mDirtyEnd = std::max(mDirtyEnd, end);
+}
+
+void SceneGraph::Truncate(size_t count)
+{
+    if (count >= mParents.size())
+        return;
+
+    mParents.resize(count);
+    mLocals.resize(count);
+    mWorlds.resize(count);
+    mLastDescendant.resize(count);
+    mDirty.resize(count);
+    mChanged.resize(count);
+
+    for (GLuint& last : mLastDescendant)
+        last = std::min(last, static_cast<GLuint>(count - 1));
+
+    mDirtyEnd = std::min(mDirtyEnd, count);
+    mDirtyBegin = std::min(mDirtyBegin, mDirtyEnd);
+    mChangedEnd = std::min(mChangedEnd, count);
+    mChangedBegin = std::min(mChangedBegin, mChangedEnd);
+}
+
+void SceneGraph::Update()
+{
+    // forget what changed last time
+    std::fill(mChanged.begin() + mChangedBegin, mChanged.begin() + mChangedEnd, 0);
+    mChangedBegin = mChangedEnd = 0;
+
+    if (mDirtyBegin >= mDirtyEnd)
+        return;
+
+    // parents always come first, so one forward pass is enough.
+    // nodes before mDirtyBegin are clean, so their mChanged is 0
+    for (size_t i = mDirtyBegin; i < mDirtyEnd; i++)
+    {
+        GLuint parent = mParents[i];
+        bool parentChanged = parent != NoParent && mChanged[parent];
+        if (!mDirty[i] && !parentChanged)
+            continue;
+
+        mWorlds[i] = parent != NoParent ? mWorlds[parent] * mLocals[i] : mLocals[i];
+        mDirty[i] = 0;
+        mChanged[i] = 1;
+    }
+
+    mChangedBegin = mDirtyBegin;
+    mChangedEnd = mDirtyEnd;
+    mDirtyBegin = mDirtyEnd = 0;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <gl/gl3w.h>
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+// node hierarchy with cached world matrices
+// nodes are stored flat in topological order (parent index < child index),
+// so world matrices are rebuilt by one linear pass over the dirty range instead of recursion
+class SceneGraph
+{
+public:
+    static constexpr GLuint NoParent = 0xFFFFFFFF;
+
+public:
+    SceneGraph() = default;
+    ~SceneGraph() = default;
+
+public:
+    // appends a node, parent must already exist (or be NoParent)
+    GLuint AddNode(GLuint parent, const glm::mat4& local = glm::mat4(1.0f));
+    void SetLocal(GLuint node, const glm::mat4& local);
+
+    // removes every node with index >= count
+    void Truncate(size_t count);
+
+    // recomputes world matrices of dirty nodes and their descendants
+    void Update();
+
+public:
+    const size_t GetCount() const { return mParents.size(); }
+    const GLuint GetParent(GLuint node) const { return mParents[node]; }
+    const glm::mat4& GetLocal(GLuint node) const { return mLocals[node]; }
+    const glm::mat4& GetWorld(GLuint node) const { return mWorlds[node]; }
+
+    // nodes whose world matrix changed in the last Update() lie in [GetChangedBegin(), GetChangedEnd())
+    const size_t GetChangedBegin() const { return mChangedBegin; }
+    const size_t GetChangedEnd() const { return mChangedEnd; }
+    const bool IsChanged(GLuint node) const { return mChanged[node] != 0; }
+
+private:
+    std::vector<GLuint> mParents;
+    std::vector<glm::mat4> mLocals;
+    std::vector<glm::mat4> mWorlds;
+
+    // highest index among a node's descendants (or itself),
+    // bounds the range a dirty node can affect
+    std::vector<GLuint> mLastDescendant;
+
+    std::vector<uint8_t> mDirty;
+    std::vector<uint8_t> mChanged;
+
+    size_t mDirtyBegin = 0;
+    size_t mDirtyEnd = 0;
+    size_t mChangedBegin = 0;
+    size_t mChangedEnd = 0;
+};
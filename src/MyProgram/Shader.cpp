@@ -27,7 +27,7 @@ Shader::~Shader()
     glDeleteProgram(mShaderId);
 }
 
-void Shader::AddShader(GLenum type, const std::string& path)
+void Shader::AddShader(GLenum type, const std::string& path, const std::string& defines)
 {
     GLuint shader = glCreateShader(type);
 
@@ -56,7 +56,12 @@ void Shader::AddShader(GLenum type, const std::string& path)
         str = ss.str();
     }
 
-    shaderData.emplace(std::make_pair(path, type));
+    shaderData.emplace(path, std::make_pair(type, defines));
+    if (!defines.empty())
+    {
+        size_t lineEnd = str.find('\n');
+        str.insert(lineEnd == std::string::npos ? str.size() : lineEnd + 1, defines);
+    }
 
     size_t len = str.size();
     GLchar* str_c = new GLchar[len + 1];
@@ -121,7 +126,7 @@ void Shader::Recompile()
     mShaderId = glCreateProgram();
     for (auto& data : shaderData)
     {
-        AddShader(data.second, data.first);
+        AddShader(data.second.first, data.first, data.second.second);
     }
     Link();
 }
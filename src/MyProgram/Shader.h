@@ -8,6 +8,7 @@
 #include <string>
 #include <vector>
 #include <unordered_map>
+#include <utility>
 
 class Shader
 {
@@ -16,7 +17,8 @@ public:
     ~Shader();
 
 public:
-    void AddShader(GLenum type, const std::string& path);
+    // "defines" go right after the #version line, e.g. "#define NAME\n"
+    void AddShader(GLenum type, const std::string& path, const std::string& defines = "");
     void Link();
     void Use() { glUseProgram(mShaderId); }
     void Recompile();
@@ -33,5 +35,5 @@ public:
 private:
     GLuint mShaderId;
     std::vector<GLuint> shaders;
-    std::unordered_map<std::string, GLenum> shaderData;
+    std::unordered_map<std::string, std::pair<GLenum, std::string>> shaderData;  // path: type, defines
 };
@@ -0,0 +1,331 @@
+#include "ShadowAtlas.h"
+
+#include <gl/gl3w.h>
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+#include <vector>
+
+ShadowAtlas::ShadowAtlas(GLuint binding, uint32_t size, uint32_t minTileSize, uint32_t maxTileSize)
+    : mBinding(binding)
+    , mSize(size)
+    , mMinTileSize(minTileSize)
+    , mMaxTileSize(std::min(maxTileSize, size))
+    , mBudget(static_cast<uint64_t>(2048) * 2048)
+{
+    glGenTextures(1, &mTexture);
+    glBindTexture(GL_TEXTURE_2D, mTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT, mSize, mSize, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    // PCF taps are clamped to their tile in shader.frag
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glGenFramebuffers(1, &mFramebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, mFramebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, mTexture, 0);
+    glDrawBuffer(GL_NONE);
+    glReadBuffer(GL_NONE);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    glGenBuffers(1, &mBuffer);
+
+    // everything starts as one free level 0 tile
+    mFreeTiles.resize(LevelOf(mMinTileSize) + 1);
+    mFreeTiles[0].emplace_back(0, 0);
+}
+
+ShadowAtlas::~ShadowAtlas()
+{
+    glDeleteTextures(1, &mTexture);
+    glDeleteFramebuffers(1, &mFramebuffer);
+    glDeleteBuffers(1, &mBuffer);
+}
+
+uint32_t ShadowAtlas::LevelOf(uint32_t size) const
+{
+    uint32_t level = 0;
+    for (uint32_t s = mSize; s > size; s >>= 1)
+        level++;
+    return level;
+}
+
+uint32_t ShadowAtlas::DesiredSize(float priority) const
+{
+    // largest power of two not above priority * max size
+    uint32_t size = mMaxTileSize;
+    while (size > mMinTileSize && static_cast<float>(size) > priority * mMaxTileSize)
+        size >>= 1;
+    return size;
+}
+
+bool ShadowAtlas::Allocate(uint32_t size, ShadowTile& out)
+{
+    uint32_t level = LevelOf(size);
+
+    // nearest level above with a free tile, split it down
+    int from = static_cast<int>(level);
+    while (from >= 0 && mFreeTiles[from].empty())
+        from--;
+    if (from < 0)
+        return false;
+
+    for (uint32_t l = static_cast<uint32_t>(from); l < level; l++)
+    {
+        glm::uvec2 corner = mFreeTiles[l].back();
+        mFreeTiles[l].pop_back();
+
+        uint32_t half = (mSize >> l) >> 1;
+        mFreeTiles[l + 1].emplace_back(corner.x + half, corner.y + half);
+        mFreeTiles[l + 1].emplace_back(corner.x, corner.y + half);
+        mFreeTiles[l + 1].emplace_back(corner.x + half, corner.y);
+        mFreeTiles[l + 1].emplace_back(corner.x, corner.y);
+    }
+
+    glm::uvec2 corner = mFreeTiles[level].back();
+    mFreeTiles[level].pop_back();
+
+    out.x = corner.x;
+    out.y = corner.y;
+    out.size = size;
+    mAllocatedTexels += static_cast<uint64_t>(size) * size;
+    return true;
+}
+
+void ShadowAtlas::Free(const ShadowTile& tile)
+{
+    mAllocatedTexels -= static_cast<uint64_t>(tile.size) * tile.size;
+
+    uint32_t level = LevelOf(tile.size);
+    glm::uvec2 corner = glm::uvec2(tile.x, tile.y);
+
+    // merge with the three siblings while they are all free
+    while (level > 0)
+    {
+        uint32_t size = mSize >> level;
+        glm::uvec2 parent = glm::uvec2(corner.x & ~(2 * size - 1), corner.y & ~(2 * size - 1));
+
+        std::vector<glm::uvec2>& free = mFreeTiles[level];
+        std::vector<size_t> siblings;
+        for (size_t i = 0; i < free.size() && siblings.size() < 3; i++)
+        {
+            if ((free[i].x & ~(2 * size - 1)) == parent.x && (free[i].y & ~(2 * size - 1)) == parent.y)
+                siblings.emplace_back(i);
+        }
+        if (siblings.size() < 3)
+            break;
+
+        // erase back to front so indices stay valid
+        for (auto it = siblings.rbegin(); it != siblings.rend(); ++it)
+        {
+            free[*it] = free.back();
+            free.pop_back();
+        }
+
+        corner = parent;
+        level--;
+    }
+
+    mFreeTiles[level].emplace_back(corner);
+}
+
+void ShadowAtlas::Update(const std::vector<ShadowRequest>& requests, std::vector<ShadowUpdate>& out)
+{
+    out.clear();
+    mFrame++;
+
+    // most important lights get their space first
+    std::vector<size_t> order(requests.size());
+    std::iota(order.begin(), order.end(), size_t(0));
+    std::sort(order.begin(), order.end(),
+        [&requests](size_t a, size_t b) { return requests[a].priority > requests[b].priority; });
+
+    uint32_t lightCount = 0;
+    for (const ShadowRequest& request : requests)
+        lightCount = std::max(lightCount, request.light + 1);
+
+    // lights that stopped asking give their tile back first
+    std::vector<uint8_t> requested(lightCount, 0);
+    for (const ShadowRequest& request : requests)
+        requested[request.light] = 1;
+
+    std::vector<int> lightToSlot(lightCount, -1);
+    for (size_t s = 0; s < mSlots.size(); s++)
+    {
+        Slot& slot = mSlots[s];
+        if (!slot.used)
+            continue;
+
+        if (slot.light < lightCount && requested[slot.light])
+        {
+            lightToSlot[slot.light] = static_cast<int>(s);
+        }
+        else
+        {
+            Free(slot.tile);
+            slot.used = false;
+        }
+    }
+
+    // sizes from priority, then halved from the least important light up until all fit
+    std::vector<uint32_t> desired(requests.size());
+    uint64_t total = 0;
+    for (size_t r = 0; r < requests.size(); r++)
+    {
+        desired[r] = DesiredSize(requests[r].priority);
+        total += static_cast<uint64_t>(desired[r]) * desired[r];
+    }
+    uint64_t capacity = static_cast<uint64_t>(mSize) * mSize;
+    bool shrunk = true;
+    while (total > capacity && shrunk)
+    {
+        shrunk = false;
+        for (auto it = order.rbegin(); it != order.rend() && total > capacity; ++it)
+        {
+            uint32_t& size = desired[*it];
+            if (size <= mMinTileSize)
+                continue;
+
+            total -= static_cast<uint64_t>(size) * size * 3 / 4;
+            size >>= 1;
+            shrunk = true;
+        }
+    }
+
+    std::vector<size_t> requestSlots;
+    for (size_t r : order)
+    {
+        const ShadowRequest& request = requests[r];
+
+        int s = lightToSlot[request.light];
+        if (s < 0)
+        {
+            auto unused = std::find_if(mSlots.begin(), mSlots.end(), [](const Slot& slot) { return !slot.used; });
+            s = static_cast<int>(unused - mSlots.begin());
+            if (unused == mSlots.end())
+                mSlots.emplace_back();
+            mSlots[s] = Slot();
+            mSlots[s].light = request.light;
+            lightToSlot[request.light] = s;
+        }
+        Slot& slot = mSlots[s];
+
+        // grow right away, shrink only when 4x too big so tiles don't flicker between sizes
+        bool hasTile = slot.used;
+        if (hasTile && (desired[r] > slot.tile.size || desired[r] * 2 < slot.tile.size))
+        {
+            Free(slot.tile);
+            hasTile = false;
+        }
+        if (!hasTile)
+        {
+            // fall back to smaller tiles when the atlas is full
+            slot.used = false;
+            for (uint32_t size = desired[r]; size >= mMinTileSize && !slot.used; size >>= 1)
+                slot.used = Allocate(size, slot.tile);
+            slot.rendered = false;
+            if (!slot.used)
+                continue;
+        }
+
+        slot.requested = request.viewProjection;
+        slot.lastRequestFrame = mFrame;
+        requestSlots.emplace_back(static_cast<size_t>(s));
+    }
+
+    // schedule: missing or outdated tiles first (priority order), then round-robin refreshes
+    std::vector<uint8_t> scheduled(mSlots.size(), 0);
+    uint64_t remaining = mBudget;
+    auto schedule = [&](size_t s)
+    {
+        Slot& slot = mSlots[s];
+        uint64_t cost = static_cast<uint64_t>(slot.tile.size) * slot.tile.size;
+        // at least one tile per frame, even above the budget
+        if (cost > remaining && !out.empty())
+            return false;
+
+        remaining -= std::min(cost, remaining);
+        scheduled[s] = 1;
+        slot.rendered = true;
+        slot.renderedWith = slot.requested;
+        out.push_back({ static_cast<uint32_t>(s), slot.tile, slot.requested });
+        return true;
+    };
+
+    for (size_t s : requestSlots)
+    {
+        const Slot& slot = mSlots[s];
+        if (!slot.rendered || std::memcmp(&slot.requested, &slot.renderedWith, sizeof(glm::mat4)) != 0)
+            schedule(s);
+    }
+
+    for (size_t i = 0; i < mSlots.size(); i++)
+    {
+        size_t s = (mCursor + i) % mSlots.size();
+        if (!mSlots[s].used || scheduled[s])
+            continue;
+        if (!schedule(s))
+        {
+            mCursor = s;
+            break;
+        }
+        mCursor = (s + 1) % mSlots.size();
+    }
+    mUpdateCount = out.size();
+
+    // shader side view: only tiles holding a finished render
+    mLightSlots.assign(lightCount, -1);
+    mGpuShadows.resize(mSlots.size());
+    for (size_t s = 0; s < mSlots.size(); s++)
+    {
+        const Slot& slot = mSlots[s];
+        if (!slot.used || !slot.rendered)
+            continue;
+
+        mLightSlots[slot.light] = static_cast<int>(s);
+        mGpuShadows[s].viewProjection = slot.renderedWith;
+        mGpuShadows[s].rect = glm::vec4(
+            static_cast<float>(slot.tile.x) / mSize,
+            static_cast<float>(slot.tile.y) / mSize,
+            static_cast<float>(slot.tile.size) / mSize,
+            static_cast<float>(slot.tile.size) / mSize);
+    }
+}
+
+void ShadowAtlas::BeginTile(const ShadowUpdate& update)
+{
+    glBindFramebuffer(GL_FRAMEBUFFER, mFramebuffer);
+    glViewport(update.tile.x, update.tile.y, update.tile.size, update.tile.size);
+    glEnable(GL_SCISSOR_TEST);
+    glScissor(update.tile.x, update.tile.y, update.tile.size, update.tile.size);
+    glClear(GL_DEPTH_BUFFER_BIT);
+}
+
+void ShadowAtlas::EndTiles(int screenWidth, int screenHeight)
+{
+    glDisable(GL_SCISSOR_TEST);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(0, 0, screenWidth, screenHeight);
+}
+
+void ShadowAtlas::Bind()
+{
+    // never empty, an empty SSBO can't be bound
+    if (mGpuShadows.empty())
+        mGpuShadows.emplace_back();
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, mBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, mGpuShadows.size() * sizeof(GpuShadow), mGpuShadows.data(), GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, mBinding, mBuffer);
+}
+
+size_t ShadowAtlas::GetTileCount() const
+{
+    return std::count_if(mSlots.begin(), mSlots.end(), [](const Slot& slot) { return slot.used; });
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <gl/gl3w.h>
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+// square region of the atlas, in texels
+struct ShadowTile
+{
+    uint32_t x = 0;
+    uint32_t y = 0;
+    uint32_t size = 0;
+};
+
+// one entry of the "Shadows" SSBO (std430 layout)
+struct GpuShadow
+{
+    glm::mat4 viewProjection;  // matrix the tile was rendered with
+    glm::vec4 rect;            // xy: uv offset, zw: uv scale of the tile
+};
+
+// a light that wants a shadow map this frame
+struct ShadowRequest
+{
+    uint32_t light;            // EntityStore light index
+    glm::mat4 viewProjection;
+    float priority;            // screen coverage * importance, 0..1
+};
+
+// a tile to re-render this frame
+struct ShadowUpdate
+{
+    uint32_t slot;
+    ShadowTile tile;
+    glm::mat4 viewProjection;
+};
+
+// every shadowed light gets a tile of one big depth texture.
+// tiles come from a quadtree (buddy) allocator, their size follows the light's priority.
+// re-rendering is scheduled round-robin under a texel budget per frame,
+// so many shadowed lights cost bounded memory and GPU time
+class ShadowAtlas
+{
+public:
+    ShadowAtlas(GLuint binding, uint32_t size = 4096, uint32_t minTileSize = 128, uint32_t maxTileSize = 2048);
+    ~ShadowAtlas();
+
+    ShadowAtlas(const ShadowAtlas&) = delete;
+    ShadowAtlas& operator=(const ShadowAtlas&) = delete;
+
+public:
+    // (re)allocates tiles for this frame's requests and picks the tiles to render
+    void Update(const std::vector<ShadowRequest>& requests, std::vector<ShadowUpdate>& out);
+
+    // binds the atlas framebuffer, viewport/scissor cover the tile, tile depth is cleared
+    void BeginTile(const ShadowUpdate& update);
+    void EndTiles(int screenWidth, int screenHeight);
+
+    // uploads the "Shadows" SSBO and binds it
+    void Bind();
+
+public:
+    // "Shadows" index of the light, -1 when it has no rendered tile
+    const std::vector<int>& GetShadowSlots() const { return mLightSlots; }
+
+    GLuint GetTexture() const { return mTexture; }
+    uint32_t GetSize() const { return mSize; }
+    void SetBudget(uint64_t texelsPerFrame) { mBudget = texelsPerFrame; }
+    uint64_t GetBudget() const { return mBudget; }
+
+    size_t GetTileCount() const;
+    uint64_t GetAllocatedTexels() const { return mAllocatedTexels; }
+    size_t GetUpdateCount() const { return mUpdateCount; }
+
+private:
+    struct Slot
+    {
+        bool used = false;
+        uint32_t light = 0;
+        ShadowTile tile;
+        bool rendered = false;
+        glm::mat4 requested = glm::mat4(1.0f);
+        glm::mat4 renderedWith = glm::mat4(1.0f);
+        uint32_t lastRequestFrame = 0;
+    };
+
+    uint32_t DesiredSize(float priority) const;
+    bool Allocate(uint32_t size, ShadowTile& out);
+    void Free(const ShadowTile& tile);
+    uint32_t LevelOf(uint32_t size) const;
+
+private:
+    GLuint mBinding;
+    GLuint mTexture = 0;
+    GLuint mFramebuffer = 0;
+    GLuint mBuffer = 0;
+
+    uint32_t mSize;
+    uint32_t mMinTileSize;
+    uint32_t mMaxTileSize;
+    uint64_t mBudget;
+
+    // free tile corners per quadtree level, level 0 is the whole atlas
+    std::vector<std::vector<glm::uvec2>> mFreeTiles;
+
+    std::vector<Slot> mSlots;
+    std::vector<int> mLightSlots;
+    std::vector<GpuShadow> mGpuShadows;
+    size_t mCursor = 0;  // round-robin position in mSlots
+    uint32_t mFrame = 0;
+
+    uint64_t mAllocatedTexels = 0;
+    size_t mUpdateCount = 0;
+};
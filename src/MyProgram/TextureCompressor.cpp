@@ -0,0 +1,716 @@
+#include "TextureCompressor.h"
+
+#include <gl/gl3w.h>
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <numeric>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "ThreadPool.h"
+#include "MipChain.h"
+#include "helper.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define TEXTURE_COMPRESSOR_SSE2
+#endif
+
+// EXT_texture_sRGB, not in glcorearb.h
+#ifndef GL_COMPRESSED_SRGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_SRGB_S3TC_DXT1_EXT 0x8C4C
+#endif
+#ifndef GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT 0x8C4F
+#endif
+
+static constexpr uint32_t DdsMagic = 0x20534444;  // "DDS "
+static constexpr uint32_t DdsCacheVersion = 3;
+
+struct DdsHeader
+{
+    uint32_t size = 124;
+    uint32_t flags = 0;
+    uint32_t height = 0;
+    uint32_t width = 0;
+    uint32_t linearSize = 0;
+    uint32_t depth = 0;
+    uint32_t mipMapCount = 0;
+    uint32_t reserved1[11] = {};  // 0-1: source hash, 2: cache version, 3: grey
+    uint32_t pixelFormatSize = 32;
+    uint32_t pixelFormatFlags = 0;
+    uint32_t fourCC = 0;
+    uint32_t pixelFormatUnused[5] = {};
+    uint32_t caps = 0;
+    uint32_t caps2 = 0;
+    uint32_t caps3 = 0;
+    uint32_t caps4 = 0;
+    uint32_t reserved2 = 0;
+};
+static_assert(sizeof(DdsHeader) == 124, "DDS_HEADER layout");
+
+struct DdsHeaderDx10
+{
+    uint32_t dxgiFormat = 0;
+    uint32_t resourceDimension = 3;  // texture 2D
+    uint32_t miscFlag = 0;
+    uint32_t arraySize = 1;
+    uint32_t miscFlags2 = 0;
+};
+
+// one 4x4 block, struct of arrays so four pixels go through SSE at once
+struct alignas(16) Block
+{
+    float r[16];
+    float g[16];
+    float b[16];
+    float a[16];
+};
+
+static const float ColorWeights[4] = { 1.0f, 1.0f, 1.0f, 0.0f };
+static const float RgbaWeights[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+static const int BC7Weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+static size_t BlockBytes(BlockFormat format)
+{
+    return format == BlockFormat::BC1 || format == BlockFormat::BC4 ? 8 : 16;
+}
+
+static uint32_t DxgiFormat(BlockFormat format)
+{
+    switch (format)
+    {
+        case BlockFormat::BC1: return 71;
+        case BlockFormat::BC3: return 77;
+        case BlockFormat::BC4: return 80;
+        case BlockFormat::BC5: return 83;
+        default: return 98;
+    }
+}
+
+static const char* FormatName(BlockFormat format)
+{
+    static const char* names[] = { "BC1", "BC3", "BC4", "BC5", "BC7" };
+    return names[static_cast<int>(format)];
+}
+
+GLenum GetCompressedFormat(BlockFormat format, bool srgb)
+{
+    // BC4 / BC5 have no sRGB variant, grey color is decoded as is
+    switch (format)
+    {
+        case BlockFormat::BC1: return srgb ? GL_COMPRESSED_SRGB_S3TC_DXT1_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+        case BlockFormat::BC3: return srgb ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+        case BlockFormat::BC4: return GL_COMPRESSED_RED_RGTC1;
+        case BlockFormat::BC5: return GL_COMPRESSED_RG_RGTC2;
+        default: return srgb ? GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM : GL_COMPRESSED_RGBA_BPTC_UNORM;
+    }
+}
+
+bool IsCompressionSupported(TextureCompression compression)
+{
+    if (compression != TextureCompression::Fast)
+        return true;
+    return helper::hasExtension("GL_EXT_texture_compression_s3tc");
+}
+
+// closest palette entry per pixel by weighted squared distance, returns the summed error
+static float FitIndices(const Block& block, const float (*palette)[4], int count, const float* weights, uint8_t* indices)
+{
+    float error = 0.0f;
+#ifdef TEXTURE_COMPRESSOR_SSE2
+    const __m128 wr = _mm_set1_ps(weights[0]);
+    const __m128 wg = _mm_set1_ps(weights[1]);
+    const __m128 wb = _mm_set1_ps(weights[2]);
+    const __m128 wa = _mm_set1_ps(weights[3]);
+    for (int p = 0; p < 16; p += 4)
+    {
+        __m128 r = _mm_load_ps(block.r + p);
+        __m128 g = _mm_load_ps(block.g + p);
+        __m128 b = _mm_load_ps(block.b + p);
+        __m128 a = _mm_load_ps(block.a + p);
+
+        __m128 best = _mm_set1_ps(FLT_MAX);
+        __m128i bestIndex = _mm_setzero_si128();
+        for (int i = 0; i < count; i++)
+        {
+            __m128 dr = _mm_sub_ps(r, _mm_set1_ps(palette[i][0]));
+            __m128 dg = _mm_sub_ps(g, _mm_set1_ps(palette[i][1]));
+            __m128 db = _mm_sub_ps(b, _mm_set1_ps(palette[i][2]));
+            __m128 da = _mm_sub_ps(a, _mm_set1_ps(palette[i][3]));
+            __m128 d = _mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(_mm_mul_ps(dr, dr), wr), _mm_mul_ps(_mm_mul_ps(dg, dg), wg)),
+                _mm_add_ps(_mm_mul_ps(_mm_mul_ps(db, db), wb), _mm_mul_ps(_mm_mul_ps(da, da), wa)));
+
+            __m128i closer = _mm_castps_si128(_mm_cmplt_ps(d, best));
+            best = _mm_min_ps(d, best);
+            bestIndex = _mm_or_si128(_mm_and_si128(closer, _mm_set1_epi32(i)), _mm_andnot_si128(closer, bestIndex));
+        }
+
+        alignas(16) int32_t laneIndex[4];
+        alignas(16) float laneError[4];
+        _mm_store_si128(reinterpret_cast<__m128i*>(laneIndex), bestIndex);
+        _mm_store_ps(laneError, best);
+        for (int k = 0; k < 4; k++)
+        {
+            indices[p + k] = static_cast<uint8_t>(laneIndex[k]);
+            error += laneError[k];
+        }
+    }
+#else
+    for (int p = 0; p < 16; p++)
+    {
+        float best = FLT_MAX;
+        for (int i = 0; i < count; i++)
+        {
+            float dr = block.r[p] - palette[i][0];
+            float dg = block.g[p] - palette[i][1];
+            float db = block.b[p] - palette[i][2];
+            float da = block.a[p] - palette[i][3];
+            float d = dr * dr * weights[0] + dg * dg * weights[1] + db * db * weights[2] + da * da * weights[3];
+            if (d < best)
+            {
+                best = d;
+                indices[p] = static_cast<uint8_t>(i);
+            }
+        }
+        error += best;
+    }
+#endif
+    return error;
+}
+
+// endpoints at the extremes of the block's principal axis
+static void PrincipalEndpoints(const Block& block, int channels, float lo[4], float hi[4])
+{
+    const float* c[4] = { block.r, block.g, block.b, block.a };
+
+    float mean[4] = {};
+    for (int ch = 0; ch < channels; ch++)
+    {
+        for (int i = 0; i < 16; i++)
+            mean[ch] += c[ch][i];
+        mean[ch] /= 16.0f;
+    }
+
+    float cov[4][4] = {};
+    for (int i = 0; i < 16; i++)
+        for (int x = 0; x < channels; x++)
+            for (int y = 0; y < channels; y++)
+                cov[x][y] += (c[x][i] - mean[x]) * (c[y][i] - mean[y]);
+
+    for (int ch = 0; ch < 4; ch++)
+        lo[ch] = hi[ch] = ch < channels ? mean[ch] : 255.0f;
+
+    // power iteration, starting from the row of the widest channel
+    int widest = 0;
+    for (int ch = 1; ch < channels; ch++)
+        if (cov[ch][ch] > cov[widest][widest])
+            widest = ch;
+    if (cov[widest][widest] <= 0.0f)
+        return;
+
+    float axis[4] = {};
+    for (int ch = 0; ch < channels; ch++)
+        axis[ch] = cov[widest][ch];
+    for (int iteration = 0; iteration < 8; iteration++)
+    {
+        float next[4] = {};
+        float largest = 0.0f;
+        for (int x = 0; x < channels; x++)
+        {
+            for (int y = 0; y < channels; y++)
+                next[x] += cov[x][y] * axis[y];
+            largest = std::max(largest, std::abs(next[x]));
+        }
+        if (largest <= 0.0f)
+            break;
+        for (int ch = 0; ch < channels; ch++)
+            axis[ch] = next[ch] / largest;
+    }
+
+    float length = 0.0f;
+    for (int ch = 0; ch < channels; ch++)
+        length += axis[ch] * axis[ch];
+    length = std::sqrt(length);
+    if (length <= 0.0f)
+        return;
+
+    float tMin = FLT_MAX, tMax = -FLT_MAX;
+    for (int i = 0; i < 16; i++)
+    {
+        float t = 0.0f;
+        for (int ch = 0; ch < channels; ch++)
+            t += (c[ch][i] - mean[ch]) * axis[ch] / length;
+        tMin = std::min(tMin, t);
+        tMax = std::max(tMax, t);
+    }
+
+    for (int ch = 0; ch < channels; ch++)
+    {
+        lo[ch] = std::clamp(mean[ch] + axis[ch] / length * tMin, 0.0f, 255.0f);
+        hi[ch] = std::clamp(mean[ch] + axis[ch] / length * tMax, 0.0f, 255.0f);
+    }
+}
+
+// least squares endpoints for fixed indices, pixel = (1 - t) * e0 + t * e1 with t = weightOf[index]
+static bool SolveEndpoints(const Block& block, const uint8_t* indices, const float* weightOf, int channels, float e0[4], float e1[4])
+{
+    const float* c[4] = { block.r, block.g, block.b, block.a };
+
+    float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+    float x0[4] = {}, x1[4] = {};
+    for (int i = 0; i < 16; i++)
+    {
+        float t = weightOf[indices[i]];
+        float s = 1.0f - t;
+        aa += s * s;
+        ab += s * t;
+        bb += t * t;
+        for (int ch = 0; ch < channels; ch++)
+        {
+            x0[ch] += s * c[ch][i];
+            x1[ch] += t * c[ch][i];
+        }
+    }
+
+    float det = aa * bb - ab * ab;
+    if (std::abs(det) < 1e-6f)
+        return false;
+
+    for (int ch = 0; ch < 4; ch++)
+    {
+        e0[ch] = ch < channels ? std::clamp((bb * x0[ch] - ab * x1[ch]) / det, 0.0f, 255.0f) : 255.0f;
+        e1[ch] = ch < channels ? std::clamp((aa * x1[ch] - ab * x0[ch]) / det, 0.0f, 255.0f) : 255.0f;
+    }
+    return true;
+}
+
+static uint16_t Pack565(const float c[4])
+{
+    int r = static_cast<int>(std::round(c[0] * 31.0f / 255.0f));
+    int g = static_cast<int>(std::round(c[1] * 63.0f / 255.0f));
+    int b = static_cast<int>(std::round(c[2] * 31.0f / 255.0f));
+    return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+}
+
+static void Unpack565(uint16_t v, float c[4])
+{
+    int r = v >> 11, g = (v >> 5) & 63, b = v & 31;
+    c[0] = static_cast<float>((r << 3) | (r >> 2));
+    c[1] = static_cast<float>((g << 2) | (g >> 4));
+    c[2] = static_cast<float>((b << 3) | (b >> 2));
+    c[3] = 255.0f;
+}
+
+static float FitBC1(const Block& block, uint16_t c0, uint16_t c1, uint8_t* indices)
+{
+    float palette[4][4];
+    Unpack565(c0, palette[0]);
+    Unpack565(c1, palette[1]);
+    for (int ch = 0; ch < 4; ch++)
+    {
+        palette[2][ch] = (2.0f * palette[0][ch] + palette[1][ch]) / 3.0f;
+        palette[3][ch] = (palette[0][ch] + 2.0f * palette[1][ch]) / 3.0f;
+    }
+    return FitIndices(block, palette, 4, ColorWeights, indices);
+}
+
+static void EncodeBC1(const Block& block, uint8_t* out)
+{
+    float lo[4], hi[4];
+    PrincipalEndpoints(block, 3, lo, hi);
+    uint16_t c0 = Pack565(hi), c1 = Pack565(lo);
+    uint8_t indices[16];
+    float error = FitBC1(block, c0, c1, indices);
+
+    // refit the endpoints to the chosen indices, kept when the quantized result is closer
+    static const float weightOf[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+    float e0[4], e1[4];
+    if (SolveEndpoints(block, indices, weightOf, 3, e0, e1))
+    {
+        uint16_t r0 = Pack565(e0), r1 = Pack565(e1);
+        uint8_t refined[16];
+        if (FitBC1(block, r0, r1, refined) < error)
+        {
+            c0 = r0;
+            c1 = r1;
+            std::memcpy(indices, refined, sizeof(indices));
+        }
+    }
+
+    // c0 > c1 selects the four color mode, swapping exchanges 0 <-> 1 and 2 <-> 3
+    if (c0 < c1)
+    {
+        std::swap(c0, c1);
+        for (uint8_t& index : indices)
+            index ^= 1;
+    }
+    if (c0 == c1)
+        std::memset(indices, 0, sizeof(indices));
+
+    uint32_t bits = 0;
+    for (int i = 0; i < 16; i++)
+        bits |= static_cast<uint32_t>(indices[i]) << (2 * i);
+    out[0] = c0 & 0xFF;
+    out[1] = c0 >> 8;
+    out[2] = c1 & 0xFF;
+    out[3] = c1 >> 8;
+    for (int i = 0; i < 4; i++)
+        out[4 + i] = (bits >> (8 * i)) & 0xFF;
+}
+
+// eight value mode: a0 = max, a1 = min
+static void EncodeBC4(const float* values, uint8_t* out)
+{
+    float lo = 255.0f, hi = 0.0f;
+    for (int i = 0; i < 16; i++)
+    {
+        lo = std::min(lo, values[i]);
+        hi = std::max(hi, values[i]);
+    }
+
+    int a0 = static_cast<int>(std::round(hi));
+    int a1 = static_cast<int>(std::round(lo));
+    out[0] = static_cast<uint8_t>(a0);
+    out[1] = static_cast<uint8_t>(a1);
+
+    uint64_t bits = 0;
+    if (a0 > a1)
+    {
+        float palette[8] = { static_cast<float>(a0), static_cast<float>(a1) };
+        for (int i = 2; i < 8; i++)
+            palette[i] = ((8 - i) * a0 + (i - 1) * a1) / 7.0f;
+
+        for (int p = 0; p < 16; p++)
+        {
+            int bestIndex = 0;
+            float best = FLT_MAX;
+            for (int i = 0; i < 8; i++)
+            {
+                float d = std::abs(values[p] - palette[i]);
+                if (d < best)
+                {
+                    best = d;
+                    bestIndex = i;
+                }
+            }
+            bits |= static_cast<uint64_t>(bestIndex) << (3 * p);
+        }
+    }
+
+    for (int i = 0; i < 6; i++)
+        out[2 + i] = (bits >> (8 * i)) & 0xFF;
+}
+
+static void QuantizeBC7(const float e[4], int pbit, int q[4])
+{
+    for (int ch = 0; ch < 4; ch++)
+        q[ch] = std::clamp(static_cast<int>(std::round((e[ch] - pbit) / 2.0f)), 0, 127);
+}
+
+struct BC7Endpoints
+{
+    int q0[4], q1[4];
+    int p0, p1;
+    uint8_t indices[16];
+    float error = FLT_MAX;
+};
+
+// tries the four p-bit pairs for e0 / e1
+static void ChooseBC7Endpoints(const Block& block, const float e0[4], const float e1[4], BC7Endpoints& best)
+{
+    for (int p0 = 0; p0 < 2; p0++)
+    {
+        for (int p1 = 0; p1 < 2; p1++)
+        {
+            BC7Endpoints candidate;
+            candidate.p0 = p0;
+            candidate.p1 = p1;
+            QuantizeBC7(e0, p0, candidate.q0);
+            QuantizeBC7(e1, p1, candidate.q1);
+
+            float palette[16][4];
+            for (int ch = 0; ch < 4; ch++)
+            {
+                int v0 = (candidate.q0[ch] << 1) | p0;
+                int v1 = (candidate.q1[ch] << 1) | p1;
+                for (int i = 0; i < 16; i++)
+                    palette[i][ch] = static_cast<float>(((64 - BC7Weights[i]) * v0 + BC7Weights[i] * v1 + 32) >> 6);
+            }
+
+            candidate.error = FitIndices(block, palette, 16, RgbaWeights, candidate.indices);
+            if (candidate.error < best.error)
+                best = candidate;
+        }
+    }
+}
+
+// mode 6: one subset, rgba 7.7.7.7 endpoints + p-bits, 4 bit indices
+static void EncodeBC7(const Block& block, uint8_t* out)
+{
+    float lo[4], hi[4];
+    PrincipalEndpoints(block, 4, lo, hi);
+    BC7Endpoints best;
+    ChooseBC7Endpoints(block, hi, lo, best);
+
+    float weightOf[16];
+    for (int i = 0; i < 16; i++)
+        weightOf[i] = BC7Weights[i] / 64.0f;
+    float e0[4], e1[4];
+    if (SolveEndpoints(block, best.indices, weightOf, 4, e0, e1))
+        ChooseBC7Endpoints(block, e0, e1, best);
+
+    // the anchor pixel's index is stored without its top bit. weights are symmetric, so swapping the
+    // endpoints maps index i to 15 - i
+    if (best.indices[0] & 8)
+    {
+        std::swap(best.q0, best.q1);
+        std::swap(best.p0, best.p1);
+        for (uint8_t& index : best.indices)
+            index = 15 - index;
+    }
+
+    std::memset(out, 0, 16);
+    int position = 0;
+    auto write = [out, &position](uint32_t value, int bits)
+    {
+        for (int i = 0; i < bits; i++, position++)
+            out[position >> 3] |= ((value >> i) & 1) << (position & 7);
+    };
+
+    write(1 << 6, 7);
+    for (int ch = 0; ch < 4; ch++)
+    {
+        write(best.q0[ch], 7);
+        write(best.q1[ch], 7);
+    }
+    write(best.p0, 1);
+    write(best.p1, 1);
+    write(best.indices[0], 3);
+    for (int i = 1; i < 16; i++)
+        write(best.indices[i], 4);
+}
+
+// edge pixels repeat past the image border
+static void LoadBlock(const uint8_t* rgba, int width, int height, int blockX, int blockY, Block& block)
+{
+    for (int y = 0; y < 4; y++)
+    {
+        int sy = std::min(blockY * 4 + y, height - 1);
+        for (int x = 0; x < 4; x++)
+        {
+            int sx = std::min(blockX * 4 + x, width - 1);
+            const uint8_t* pixel = rgba + (static_cast<size_t>(sy) * width + sx) * 4;
+            block.r[y * 4 + x] = pixel[0];
+            block.g[y * 4 + x] = pixel[1];
+            block.b[y * 4 + x] = pixel[2];
+            block.a[y * 4 + x] = pixel[3];
+        }
+    }
+}
+
+static void CompressLevel(const uint8_t* rgba, int width, int height, BlockFormat format, ThreadPool& pool, uint8_t* out)
+{
+    int blocksX = (width + 3) / 4;
+    int blocksY = (height + 3) / 4;
+    size_t blockBytes = BlockBytes(format);
+
+    pool.ParallelFor(blocksY, [&](size_t blockY)
+        {
+            Block block;
+            for (int blockX = 0; blockX < blocksX; blockX++)
+            {
+                LoadBlock(rgba, width, height, blockX, static_cast<int>(blockY), block);
+                uint8_t* dst = out + (blockY * blocksX + blockX) * blockBytes;
+                switch (format)
+                {
+                    case BlockFormat::BC1:
+                        EncodeBC1(block, dst);
+                        break;
+                    case BlockFormat::BC3:
+                        EncodeBC4(block.a, dst);
+                        EncodeBC1(block, dst + 8);
+                        break;
+                    case BlockFormat::BC4:
+                        EncodeBC4(block.r, dst);
+                        break;
+                    case BlockFormat::BC5:
+                        // grey + alpha sources, alpha goes to green
+                        EncodeBC4(block.r, dst);
+                        EncodeBC4(block.a, dst + 8);
+                        break;
+                    case BlockFormat::BC7:
+                        EncodeBC7(block, dst);
+                        break;
+                }
+            }
+        });
+}
+
+size_t CompressedTexture::GetSize() const
+{
+    return std::accumulate(levelSizes.begin(), levelSizes.end(), size_t(0));
+}
+
+void CompressTexture(const TextureImage& image, TextureSemantic semantic, TextureCompression compression,
+    ThreadPool& pool, CompressedTexture& out)
+{
+    // everything as rgba, grey sources keep their grey in rgb and alpha in a
+    int width = image.width, height = image.height, channels = image.channels;
+    const uint8_t* pixels = image.pixels.data();
+    size_t pixelCount = static_cast<size_t>(width) * height;
+    std::vector<uint8_t> rgba(pixelCount * 4);
+    bool opaque = true, grey = true;
+    for (size_t i = 0; i < pixelCount; i++)
+    {
+        const uint8_t* src = pixels + i * channels;
+        uint8_t* dst = rgba.data() + i * 4;
+        dst[0] = src[0];
+        dst[1] = channels >= 3 ? src[1] : src[0];
+        dst[2] = channels >= 3 ? src[2] : src[0];
+        dst[3] = channels == 2 ? src[1] : channels == 4 ? src[3] : 255;
+        opaque &= dst[3] == 255;
+        grey &= dst[0] == dst[1] && dst[1] == dst[2];
+    }
+
+    out.width = width;
+    out.height = height;
+    out.grey = grey;
+    if (grey)
+        out.format = opaque ? BlockFormat::BC4 : BlockFormat::BC5;
+    else if (compression == TextureCompression::High)
+        out.format = BlockFormat::BC7;
+    else
+        out.format = opaque ? BlockFormat::BC1 : BlockFormat::BC3;
+
+    std::vector<std::vector<uint8_t>> levels;
+    BuildMipLevels(rgba.data(), width, height, 4, semantic == TextureSemantic::Color, pool, levels);
+
+    out.levelSizes.clear();
+    out.data.clear();
+    out.file.Close();
+    out.fileOffset = 0;
+    for (const std::vector<uint8_t>& level : levels)
+    {
+        size_t size = static_cast<size_t>((width + 3) / 4) * ((height + 3) / 4) * BlockBytes(out.format);
+        size_t offset = out.data.size();
+        out.data.resize(offset + size);
+        out.levelSizes.emplace_back(size);
+        CompressLevel(level.data(), width, height, out.format, pool, out.data.data() + offset);
+
+        width = std::max(width / 2, 1);
+        height = std::max(height / 2, 1);
+    }
+}
+
+static bool LoadDds(const std::string& path, uint64_t hash, CompressedTexture& out)
+{
+    const size_t headerSize = sizeof(DdsMagic) + sizeof(DdsHeader) + sizeof(DdsHeaderDx10);
+    if (!out.file.Open(path) || out.file.GetSize() < headerSize)
+        return false;
+
+    uint32_t magic = 0;
+    DdsHeader header;
+    DdsHeaderDx10 dx10;
+    const uint8_t* bytes = out.file.GetData();
+    std::memcpy(&magic, bytes, sizeof(magic));
+    std::memcpy(&header, bytes + sizeof(magic), sizeof(header));
+    std::memcpy(&dx10, bytes + sizeof(magic) + sizeof(header), sizeof(dx10));
+    if (magic != DdsMagic || header.fourCC != 0x30315844 /* "DX10" */ ||
+        header.reserved1[2] != DdsCacheVersion || (static_cast<uint64_t>(header.reserved1[1]) << 32 | header.reserved1[0]) != hash)
+        return false;
+
+    const BlockFormat formats[] = { BlockFormat::BC1, BlockFormat::BC3, BlockFormat::BC4, BlockFormat::BC5, BlockFormat::BC7 };
+    auto format = std::find_if(std::begin(formats), std::end(formats), [&dx10](BlockFormat f) { return DxgiFormat(f) == dx10.dxgiFormat; });
+    if (format == std::end(formats))
+        return false;
+
+    out.format = *format;
+    out.width = static_cast<int>(header.width);
+    out.height = static_cast<int>(header.height);
+    out.grey = header.reserved1[3] != 0;
+    out.fileOffset = headerSize;
+    out.data.clear();
+    out.levelSizes.clear();
+    for (uint32_t level = 0; level < header.mipMapCount; level++)
+    {
+        int w = std::max(out.width >> level, 1), h = std::max(out.height >> level, 1);
+        out.levelSizes.emplace_back(static_cast<size_t>((w + 3) / 4) * ((h + 3) / 4) * BlockBytes(out.format));
+    }
+    return out.file.GetSize() >= out.fileOffset + out.GetSize();
+}
+
+static void SaveDds(const std::string& path, uint64_t hash, const CompressedTexture& texture)
+{
+    std::ofstream os(path, std::ios::binary);
+    if (!os.is_open())
+    {
+        fmt::print(stderr, "[TEXTURE-ERROR] Failed to write \"{}\"\n", path);
+        return;
+    }
+
+    DdsHeader header;
+    header.flags = 0x1 | 0x2 | 0x4 | 0x1000 | 0x20000 | 0x80000;  // caps, height, width, pixel format, mip count, linear size
+    header.height = static_cast<uint32_t>(texture.height);
+    header.width = static_cast<uint32_t>(texture.width);
+    header.linearSize = static_cast<uint32_t>(texture.levelSizes[0]);
+    header.mipMapCount = static_cast<uint32_t>(texture.levelSizes.size());
+    header.reserved1[0] = static_cast<uint32_t>(hash);
+    header.reserved1[1] = static_cast<uint32_t>(hash >> 32);
+    header.reserved1[2] = DdsCacheVersion;
+    header.reserved1[3] = texture.grey ? 1 : 0;
+    header.pixelFormatFlags = 0x4;  // four cc
+    header.fourCC = 0x30315844;     // "DX10"
+    header.caps = 0x1000 | 0x8 | 0x400000;  // texture, complex, mipmap
+
+    DdsHeaderDx10 dx10;
+    dx10.dxgiFormat = DxgiFormat(texture.format);
+
+    os.write(reinterpret_cast<const char*>(&DdsMagic), sizeof(DdsMagic));
+    os.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    os.write(reinterpret_cast<const char*>(&dx10), sizeof(dx10));
+    os.write(reinterpret_cast<const char*>(texture.data.data()), texture.data.size());
+}
+
+bool LoadOrCompressTexture(const TextureSource& source, TextureCompression compression, ThreadPool& pool, CompressedTexture& out,
+    bool quiet)
+{
+    // a different setting is a different cache
+    uint64_t hash;
+    if (!HashTextureSource(source, hash))
+        return false;
+    hash = (hash ^ static_cast<uint64_t>(compression)) * 1099511628211ull;
+
+    std::string cachePath = source.GetName() + ".dds";
+    if (LoadDds(cachePath, hash, out))
+    {
+        if (!quiet)
+            fmt::print("[TEXTURE-INFO] Mapped cached {} \"{}\"\n", FormatName(out.format), cachePath);
+        return true;
+    }
+    out.file.Close();
+
+    TextureImage image;
+    if (!DecodeTextureSource(source, image))
+        return false;
+
+    auto start = std::chrono::steady_clock::now();
+    CompressTexture(image, source.semantic, compression, pool, out);
+    auto end = std::chrono::steady_clock::now();
+
+    SaveDds(cachePath, hash, out);
+    fmt::print("[TEXTURE] Compressed \"{}\" to {} in {:.1f} ms, {} KB\n",
+        source.GetName(), FormatName(out.format), std::chrono::duration<float, std::milli>(end - start).count(), out.data.size() / 1024);
+    return true;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <gl/gl3w.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "MappedFile.h"
+#include "TextureSource.h"
+
+class ThreadPool;
+
+enum class TextureCompression
+{
+    None,  // RGBA8 with the CPU mip chain of MipChain.h
+    Fast,  // BC1 opaque color, BC3 color with alpha
+    High,  // BC7 for all color textures
+};
+
+// 4x4 block formats, BC4 / BC5 only hold the channels of single and two channel sources
+enum class BlockFormat
+{
+    BC1,  // rgb, 8 bytes per block
+    BC3,  // BC1 rgb + BC4 alpha, 16 bytes
+    BC4,  // one channel, 8 bytes
+    BC5,  // two BC4 channels, 16 bytes
+    BC7,  // rgba, mode 6 only, 16 bytes
+};
+
+// full mip chain of one texture, largest level first
+struct CompressedTexture
+{
+    BlockFormat format = BlockFormat::BC1;
+    int width = 0;
+    int height = 0;
+    bool grey = false;  // source was grey (+ alpha), sample with a r,r,r(,g) swizzle
+    std::vector<size_t> levelSizes;
+    std::vector<uint8_t> data;  // encoded this run
+    MappedFile file;            // warm load, the blocks start "fileOffset" bytes in
+    size_t fileOffset = 0;
+
+    const uint8_t* GetData() const { return file.IsOpen() ? file.GetData() + fileOffset : data.data(); }
+    size_t GetSize() const;
+};
+
+// picks the format from the channels in use, encodes every level of the mip chain (MipChain.h) on "pool",
+// color is filtered in linear space. CPU only, no GL context needed
+void CompressTexture(const TextureImage& image, TextureSemantic semantic, TextureCompression compression,
+    ThreadPool& pool, CompressedTexture& out);
+
+// maps "<name>.dds" while it was encoded from the current file contents and the same setting,
+// otherwise decodes and compresses the source and writes the cache. false if a file can't be read.
+// "quiet": no line for a mapped cache, for reloads
+bool LoadOrCompressTexture(const TextureSource& source, TextureCompression compression, ThreadPool& pool, CompressedTexture& out,
+    bool quiet = false);
+
+// "srgb" picks the sRGB variant where the format has one
+GLenum GetCompressedFormat(BlockFormat format, bool srgb = false);
+// false when the current context can't sample every format "compression" may pick: BC4 / BC5 / BC7 are core,
+// BC1 / BC3 need GL_EXT_texture_compression_s3tc. GL thread only
+bool IsCompressionSupported(TextureCompression compression);
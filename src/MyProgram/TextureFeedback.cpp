@@ -0,0 +1,81 @@
+#include "TextureFeedback.h"
+
+#include <gl/gl3w.h>
+
+#include <cstdint>
+#include <vector>
+
+// in flight at once, a readback is typically ready two frames later
+static constexpr size_t ReadbackCount = 3;
+
+TextureFeedback::TextureFeedback(GLuint binding, size_t capacity)
+    : mBinding(binding)
+    , mCapacity(capacity)
+{
+    GLsizeiptr size = static_cast<GLsizeiptr>(capacity * sizeof(uint32_t));
+    glCreateBuffers(1, &mBuffer);
+    glNamedBufferStorage(mBuffer, size, nullptr, GL_DYNAMIC_STORAGE_BIT);
+    const uint32_t clear = NoRequest;
+    glClearNamedBufferData(mBuffer, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &clear);
+
+    // coherent, a signaled fence is all it takes before reading
+    const GLbitfield flags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    mReadbacks.resize(ReadbackCount);
+    for (Readback& readback : mReadbacks)
+    {
+        glCreateBuffers(1, &readback.buffer);
+        glNamedBufferStorage(readback.buffer, size, nullptr, flags | GL_CLIENT_STORAGE_BIT);
+        readback.mapped = static_cast<const uint32_t*>(glMapNamedBufferRange(readback.buffer, 0, size, flags));
+    }
+}
+
+TextureFeedback::~TextureFeedback()
+{
+    for (Readback& readback : mReadbacks)
+    {
+        if (readback.fence)
+            glDeleteSync(readback.fence);
+        glUnmapNamedBuffer(readback.buffer);
+        glDeleteBuffers(1, &readback.buffer);
+    }
+    glDeleteBuffers(1, &mBuffer);
+}
+
+bool TextureFeedback::Update(GLuint shaderId, std::vector<uint32_t>& levels)
+{
+    // the oldest readback, without waiting
+    bool arrived = false;
+    if (mPending > 0)
+    {
+        Readback& oldest = mReadbacks[(mNext + ReadbackCount - mPending) % ReadbackCount];
+        if (glClientWaitSync(oldest.fence, 0, 0) != GL_TIMEOUT_EXPIRED)
+        {
+            glDeleteSync(oldest.fence);
+            oldest.fence = nullptr;
+            levels.assign(oldest.mapped, oldest.mapped + mCapacity);
+            mLatency = mFrame - oldest.frame;
+            mPending--;
+            arrived = true;
+        }
+    }
+
+    // last frame's requests out, a cleared buffer in. with every readback in flight they keep accumulating
+    if (mPending < ReadbackCount)
+    {
+        Readback& readback = mReadbacks[mNext];
+        glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+        glCopyNamedBufferSubData(mBuffer, readback.buffer, 0, 0, static_cast<GLsizeiptr>(mCapacity * sizeof(uint32_t)));
+        readback.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        readback.frame = mFrame;
+        mNext = (mNext + 1) % ReadbackCount;
+        mPending++;
+
+        const uint32_t clear = NoRequest;
+        glClearNamedBufferData(mBuffer, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &clear);
+    }
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, mBinding, mBuffer);
+    glProgramUniform1i(shaderId, glGetUniformLocation(shaderId, "feedbackPhase"), static_cast<GLint>(mFrame % 16));
+    mFrame++;
+    return arrived;
+}
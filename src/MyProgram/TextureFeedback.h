@@ -0,0 +1,52 @@
+#pragma once
+
+#include <gl/gl3w.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// sampler feedback for mip streaming. shader.frag atomicMin's the mip level it would sample, measured against
+// the full resolution texture, into "Feedback[texture_diffuse1_feedback]". once per frame the buffer is copied to
+// one of a few persistently mapped readback buffers and cleared, the CPU reads a copy once its fence has signaled,
+// so nothing waits on the GPU. only one pixel of every 4x4 writes per frame, the pixel rotating with "Update"
+class TextureFeedback
+{
+public:
+    TextureFeedback(GLuint binding, size_t capacity = 1024);
+    ~TextureFeedback();
+
+    TextureFeedback(const TextureFeedback&) = delete;
+    TextureFeedback& operator=(const TextureFeedback&) = delete;
+
+public:
+    // before drawing: queues a readback of the last frame's requests and binds a cleared buffer.
+    // true when an older readback arrived in "levels", one per id, NoRequest where nothing sampled it
+    bool Update(GLuint shaderId, std::vector<uint32_t>& levels);
+
+    const size_t GetCapacity() const { return mCapacity; }
+    // frames between a request and the CPU seeing it, of the last readback
+    const uint64_t GetLatency() const { return mLatency; }
+
+public:
+    static constexpr uint32_t NoRequest = 0xFFFFFFFFu;
+
+private:
+    struct Readback
+    {
+        GLuint buffer = 0;
+        const uint32_t* mapped = nullptr;
+        GLsync fence = nullptr;
+        uint64_t frame = 0;
+    };
+
+private:
+    GLuint mBinding;
+    size_t mCapacity;
+    GLuint mBuffer = 0;
+    std::vector<Readback> mReadbacks;
+    size_t mNext = 0;     // next readback to fill
+    size_t mPending = 0;  // filled and not read yet, the oldest is mNext - mPending
+    uint64_t mFrame = 0;
+    uint64_t mLatency = 0;
+};
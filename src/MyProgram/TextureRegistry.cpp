@@ -0,0 +1,206 @@
+#include "TextureRegistry.h"
+
+#include <gl/gl3w.h>
+
+#include <fmt/core.h>
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <system_error>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "ThreadPool.h"
+#include "TextureUploader.h"
+
+TextureHandle::TextureHandle(TextureHandle&& other) noexcept
+    : mRegistry(other.mRegistry)
+    , mSlot(other.mSlot)
+{
+    other.mRegistry = nullptr;
+    other.mSlot = nullptr;
+}
+
+TextureHandle& TextureHandle::operator=(TextureHandle&& other) noexcept
+{
+    if (this != &other)
+    {
+        Reset();
+        std::swap(mRegistry, other.mRegistry);
+        std::swap(mSlot, other.mSlot);
+    }
+    return *this;
+}
+
+void TextureHandle::Reset()
+{
+    if (mRegistry && mSlot)
+        mRegistry->Release(mSlot);
+    mRegistry = nullptr;
+    mSlot = nullptr;
+}
+
+// the semantic and every file resolved, "a/../b.png" and "./b.png" meet here
+static std::string PathKey(const TextureSource& source)
+{
+    auto canonical = [](const std::string& file)
+    {
+        std::error_code error;
+        std::filesystem::path path = std::filesystem::weakly_canonical(file, error);
+        return error ? file : path.generic_string();
+    };
+
+    std::string key = source.semantic == TextureSemantic::Color ? "color:" : "data:";
+    if (!source.IsPacked())
+        return key + canonical(source.file);
+
+    for (size_t ch = 0; ch < source.packedFiles.size(); ch++)
+        key += fmt::format("{}{}={}", ch == 0 ? "" : "|", source.packedDefaults[ch],
+            source.packedFiles[ch].empty() ? "" : canonical(source.packedFiles[ch]));
+    return key;
+}
+
+TextureRegistry::TextureRegistry(ThreadPool& pool, TextureUploader& uploader, TextureResidency& residency)
+    : mPool(pool)
+    , mUploader(uploader)
+    , mResidency(residency)
+{
+}
+
+TextureRegistry::~TextureRegistry()
+{
+    if (!mEntries.empty())
+        fmt::print(stderr, "[TEXTURE-ERROR] {} textures still referenced at shutdown\n", mEntries.size());
+    for (auto& [slot, entry] : mEntries)
+        mResidency.Remove(slot);
+}
+
+void TextureRegistry::Acquire(const std::vector<TextureSource>& sources, std::vector<TextureHandle>& handles, const std::vector<char>& streamed)
+{
+    handles.clear();
+    handles.resize(sources.size());
+    std::vector<TextureSlot*> slots(sources.size(), nullptr);
+    std::vector<std::string> keys(sources.size());
+    mRequestCount += sources.size();
+
+    // known paths cost no file access at all
+    std::vector<size_t> misses;
+    for (size_t i = 0; i < sources.size(); i++)
+    {
+        keys[i] = PathKey(sources[i]);
+        auto search = mByPath.find(keys[i]);
+        if (search != mByPath.end())
+            slots[i] = search->second;
+        else
+            misses.emplace_back(i);
+    }
+
+    // the rest are hashed in parallel, equal contents found under another path are shared as well
+    std::vector<uint64_t> hashes(misses.size());
+    std::vector<char> hashed(misses.size());
+    mPool.ParallelFor(misses.size(), [&](size_t i)
+        {
+            hashed[i] = HashTextureSource(sources[misses[i]], hashes[i]);
+        });
+
+    std::vector<TextureSource> uploads;
+    std::vector<uint64_t> uploadHashes;
+    std::vector<char> uploadStreamed;
+    std::vector<size_t> uploadOf(misses.size(), SIZE_MAX);
+    std::unordered_map<uint64_t, size_t> batch;
+    for (size_t i = 0; i < misses.size(); i++)
+    {
+        if (!hashed[i])
+            continue;
+
+        size_t index = misses[i];
+        auto search = mByHash.find(hashes[i]);
+        if (search != mByHash.end())
+        {
+            slots[index] = search->second;
+            AddKey(keys[index], search->second);
+            continue;
+        }
+
+        // duplicates within this batch go up once too
+        auto [slot, added] = batch.emplace(hashes[i], uploads.size());
+        if (added)
+        {
+            uploads.emplace_back(sources[index]);
+            uploadHashes.emplace_back(hashes[i]);
+            uploadStreamed.emplace_back(0);
+        }
+        if (index < streamed.size() && streamed[index])
+            uploadStreamed[slot->second] = 1;
+        uploadOf[i] = slot->second;
+    }
+
+    // streamed textures go up coarse, the residency brings in the rest on demand. the others at their finest tier
+    std::vector<int> maxSizes(uploads.size(), 0);
+    for (size_t i = 0; i < uploads.size(); i++)
+        maxSizes[i] = uploadStreamed[i] ? mResidency.GetStartSize() : 0;
+    std::vector<UploadedTexture> textures;
+    if (!uploads.empty())
+        mUploader.Load(uploads, textures, maxSizes);
+    std::vector<TextureSlot*> uploaded(uploads.size(), nullptr);
+    size_t uploadCount = 0;
+    for (size_t i = 0; i < uploads.size(); i++)
+    {
+        if (textures[i].texture == 0)
+            continue;
+        uploaded[i] = mResidency.Add(uploads[i], textures[i], uploadStreamed[i]);
+        mEntries[uploaded[i]].hash = uploadHashes[i];
+        mByHash.emplace(uploadHashes[i], uploaded[i]);
+        uploadCount++;
+    }
+    for (size_t i = 0; i < misses.size(); i++)
+    {
+        if (uploadOf[i] == SIZE_MAX || !uploaded[uploadOf[i]])
+            continue;
+        slots[misses[i]] = uploaded[uploadOf[i]];
+        AddKey(keys[misses[i]], slots[misses[i]]);
+    }
+
+    size_t found = 0;
+    for (size_t i = 0; i < sources.size(); i++)
+    {
+        if (!slots[i])
+            continue;
+        AddRef(slots[i]);
+        handles[i] = TextureHandle(this, slots[i]);
+        found++;
+    }
+    mSharedCount += found - uploadCount;
+
+    fmt::print("[TEXTURE] {} textures requested, {} uploaded, {} shared, {} resident\n",
+        sources.size(), uploadCount, found - uploadCount, mEntries.size());
+    fmt::print("[TEXTURE] {:.1f} MB of texture memory resident, {:.1f} MB saved over RGBA8\n",
+        mResidency.GetUsedBytes() / (1024.0f * 1024.0f), (mResidency.GetRgba8Bytes() - mResidency.GetUsedBytes()) / (1024.0f * 1024.0f));
+}
+
+void TextureRegistry::AddRef(TextureSlot* slot)
+{
+    mEntries[slot].refCount++;
+}
+
+void TextureRegistry::Release(TextureSlot* slot)
+{
+    auto search = mEntries.find(slot);
+    if (search == mEntries.end() || --search->second.refCount > 0)
+        return;
+
+    // the last reference, the paths and the content are free to load again
+    for (const std::string& key : search->second.keys)
+        mByPath.erase(key);
+    mByHash.erase(search->second.hash);
+    mEntries.erase(search);
+    mResidency.Remove(slot);
+}
+
+void TextureRegistry::AddKey(const std::string& key, TextureSlot* slot)
+{
+    if (mByPath.emplace(key, slot).second)
+        mEntries[slot].keys.emplace_back(key);
+}
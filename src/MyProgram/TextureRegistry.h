@@ -0,0 +1,90 @@
+#pragma once
+
+#include <gl/gl3w.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "TextureResidency.h"
+#include "TextureSource.h"
+
+class ThreadPool;
+class TextureUploader;
+class TextureRegistry;
+
+// one reference to a registry texture, released when destroyed. move only
+class TextureHandle
+{
+public:
+    TextureHandle() = default;
+    TextureHandle(TextureRegistry* registry, TextureSlot* slot) : mRegistry(registry), mSlot(slot) {}
+    ~TextureHandle() { Reset(); }
+
+    TextureHandle(const TextureHandle&) = delete;
+    TextureHandle& operator=(const TextureHandle&) = delete;
+    TextureHandle(TextureHandle&& other) noexcept;
+    TextureHandle& operator=(TextureHandle&& other) noexcept;
+
+public:
+    void Reset();
+    // the GL name can change while the handle lives, read it through the slot when binding
+    TextureSlot* Get() const { return mSlot; }
+    explicit operator bool() const { return mSlot != nullptr; }
+
+private:
+    TextureRegistry* mRegistry = nullptr;
+    TextureSlot* mSlot = nullptr;
+};
+
+// process-wide texture cache. a source is looked up by its canonical path(s) first, then by content hash,
+// so the same image reached through different relative paths, or copied under another name, is uploaded once.
+// textures are reference counted through TextureHandle and leave "residency" when the last handle goes. GL thread only
+class TextureRegistry
+{
+public:
+    TextureRegistry(ThreadPool& pool, TextureUploader& uploader, TextureResidency& residency);
+    ~TextureRegistry();
+
+    TextureRegistry(const TextureRegistry&) = delete;
+    TextureRegistry& operator=(const TextureRegistry&) = delete;
+
+public:
+    // handles[i] is empty where "sources[i]" failed to load. misses are uploaded in one batch.
+    // streamed[i]: a shader reports the mips "sources[i]" needs, it starts coarse. empty: none are
+    void Acquire(const std::vector<TextureSource>& sources, std::vector<TextureHandle>& handles, const std::vector<char>& streamed = {});
+
+public:
+    const size_t GetTextureCount() const { return mEntries.size(); }
+    // of every Acquire: sources asked for, and the ones that found an uploaded texture
+    const size_t GetRequestCount() const { return mRequestCount; }
+    const size_t GetSharedCount() const { return mSharedCount; }
+
+private:
+    friend class TextureHandle;
+
+    struct Entry
+    {
+        size_t refCount = 0;
+        uint64_t hash = 0;
+        std::vector<std::string> keys;  // every path key pointing here
+    };
+
+private:
+    void AddRef(TextureSlot* slot);
+    void Release(TextureSlot* slot);
+    void AddKey(const std::string& key, TextureSlot* slot);
+
+private:
+    ThreadPool& mPool;
+    TextureUploader& mUploader;
+    TextureResidency& mResidency;
+    std::unordered_map<TextureSlot*, Entry> mEntries;
+    std::unordered_map<std::string, TextureSlot*> mByPath;
+    std::unordered_map<uint64_t, TextureSlot*> mByHash;
+
+    size_t mRequestCount = 0;
+    size_t mSharedCount = 0;
+};
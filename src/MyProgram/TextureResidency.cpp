@@ -0,0 +1,352 @@
+#include "TextureResidency.h"
+
+#include <gl/gl3w.h>
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "TextureFeedback.h"
+#include "TextureUploader.h"
+
+// no texture is cut below this size
+static constexpr int FloorSize = 64;
+// reloads per frame, each one maps a cache and uploads a whole chain
+static constexpr size_t MaxRestoresPerFrame = 4;
+// streamed textures start out this large, small enough for a quick first frame
+static constexpr int StreamStartSize = 128;
+// frames a streamed texture keeps levels nobody asks for, so a turning camera doesn't reload them
+static constexpr uint64_t GraceFrames = 300;
+
+#ifndef GL_COMPRESSED_SRGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_SRGB_S3TC_DXT1_EXT 0x8C4C
+#endif
+#ifndef GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT 0x8C4F
+#endif
+
+TextureResidency::TextureResidency(TextureUploader& uploader, size_t budgetBytes, size_t feedbackCapacity, bool streaming)
+    : mUploader(uploader)
+    , mBudgetBytes(budgetBytes)
+    , mStreaming(streaming)
+{
+    // handed out from the back, lowest first
+    mFeedbackSlots.resize(feedbackCapacity, nullptr);
+    for (size_t i = feedbackCapacity; i > 0; i--)
+        mFreeFeedbackIds.emplace_back(static_cast<int>(i - 1));
+}
+
+TextureResidency::~TextureResidency()
+{
+    for (auto& [slot, resident] : mResidents)
+        glDeleteTextures(1, &slot->texture);
+}
+
+int TextureResidency::GetStartSize() const
+{
+    return mStreaming ? StreamStartSize : 0;
+}
+
+TextureSlot* TextureResidency::Add(const TextureSource& source, const UploadedTexture& uploaded, bool streamed)
+{
+    Resident resident;
+    resident.slot = std::make_unique<TextureSlot>();
+    resident.slot->texture = uploaded.texture;
+    resident.slot->generation = 1;
+    resident.slot->lastUsedFrame = mFrame;
+    resident.slot->frame = &mFrame;
+    resident.slot->width = uploaded.width;
+    resident.slot->height = uploaded.height;
+    resident.source = source;
+
+    GLint format;
+    glGetTextureLevelParameteriv(uploaded.texture, 0, GL_TEXTURE_INTERNAL_FORMAT, &format);
+    resident.format = static_cast<GLenum>(format);
+    resident.width = uploaded.width;
+    resident.height = uploaded.height;
+    resident.levels = uploaded.levelCount;
+    resident.tier = uploaded.skippedLevels;
+
+    // the global size limit is as fine as it gets, the floor as coarse
+    int size = std::max(uploaded.width, uploaded.height);
+    int maxSize = mUploader.GetMaxSize();
+    while (maxSize > 0 && resident.minTier + 1 < resident.levels && size >> resident.minTier > maxSize)
+        resident.minTier++;
+    while (resident.maxTier + 1 < resident.levels && size >> (resident.maxTier + 1) >= FloorSize)
+        resident.maxTier++;
+    resident.maxTier = std::max({ resident.maxTier, resident.minTier, resident.tier });
+    UpdateBytes(resident);
+
+    // streamed ones wait for the feedback at the tier they started at
+    if (mStreaming && streamed && !mFreeFeedbackIds.empty())
+    {
+        resident.slot->feedbackId = mFreeFeedbackIds.back();
+        mFreeFeedbackIds.pop_back();
+        mFeedbackSlots[resident.slot->feedbackId] = resident.slot.get();
+    }
+    resident.neededTier = resident.slot->feedbackId >= 0 ? resident.tier : resident.minTier;
+    resident.neededFrame = mFrame;
+
+    TextureSlot* slot = resident.slot.get();
+    mResidents.emplace(slot, std::move(resident));
+    return slot;
+}
+
+void TextureResidency::Remove(TextureSlot* slot)
+{
+    auto search = mResidents.find(slot);
+    if (search == mResidents.end())
+        return;
+
+    if (slot->feedbackId >= 0)
+    {
+        mFeedbackSlots[slot->feedbackId] = nullptr;
+        mFreeFeedbackIds.emplace_back(slot->feedbackId);
+    }
+    glDeleteTextures(1, &slot->texture);
+    mUsedBytes -= search->second.bytes;
+    mRgba8Bytes -= search->second.rgba8Bytes;
+    mResidents.erase(search);
+}
+
+void TextureResidency::Require(const std::vector<TextureSlot*>& slots)
+{
+    std::vector<Resident*> restores;
+    for (TextureSlot* slot : slots)
+    {
+        auto search = mResidents.find(slot);
+        if (search == mResidents.end())
+            continue;
+
+        Resident& resident = search->second;
+        resident.neededTier = resident.minTier;
+        resident.neededFrame = mFrame;
+        if (resident.tier > resident.minTier && std::find(restores.begin(), restores.end(), &resident) == restores.end())
+            restores.emplace_back(&resident);
+    }
+    if (!restores.empty())
+        Restore(restores);
+}
+
+void TextureResidency::Reserve(const void* owner, size_t bytes, size_t rgba8Bytes)
+{
+    Reservation& reservation = mReservations[owner];
+    mUsedBytes = mUsedBytes - reservation.bytes + bytes;
+    mRgba8Bytes = mRgba8Bytes - reservation.rgba8Bytes + rgba8Bytes;
+    reservation = { bytes, rgba8Bytes };
+    if (bytes == 0)
+        mReservations.erase(owner);
+}
+
+void TextureResidency::ApplyFeedback(const std::vector<uint32_t>& levels)
+{
+    for (size_t id = 0; id < std::min(levels.size(), mFeedbackSlots.size()); id++)
+    {
+        TextureSlot* slot = mFeedbackSlots[id];
+        if (!slot || levels[id] == TextureFeedback::NoRequest)
+            continue;
+
+        // the finest level sampled anywhere, requests past the floor stop there
+        Resident& resident = mResidents.at(slot);
+        int level = static_cast<int>(std::min(levels[id], static_cast<uint32_t>(resident.maxTier)));
+        resident.neededTier = std::max(level, resident.minTier);
+        if (resident.neededTier <= resident.tier)
+            resident.neededFrame = mFrame;
+    }
+}
+
+const size_t TextureResidency::GetReducedCount() const
+{
+    return std::count_if(mResidents.begin(), mResidents.end(), [](const auto& entry) { return entry.second.tier > entry.second.neededTier; });
+}
+
+void TextureResidency::Update()
+{
+    // streamed levels nobody asked for in a while go, textures not drawn at all down to the floor
+    for (auto& [slot, resident] : mResidents)
+    {
+        if (slot->feedbackId < 0)
+            continue;
+        if (!mFeedbackActive)
+        {
+            resident.neededTier = resident.minTier;
+            resident.neededFrame = mFrame;
+            continue;
+        }
+        if (mFrame - slot->lastUsedFrame > GraceFrames)
+            resident.neededTier = resident.maxTier;
+        if (resident.tier < resident.neededTier && mFrame - resident.neededFrame > GraceFrames)
+            Downgrade(resident, resident.neededTier);
+    }
+
+    // drawn last frame and coarser than needed: streamed in where the budget allows
+    std::vector<Resident*> restores;
+    size_t usedBytes = mUsedBytes;
+    for (auto& [slot, resident] : mResidents)
+    {
+        if (resident.tier <= resident.neededTier || slot->lastUsedFrame != mFrame || restores.size() == MaxRestoresPerFrame)
+            continue;
+
+        size_t neededBytes = GetBytes(resident, resident.neededTier);
+        if (usedBytes - resident.bytes + neededBytes > mBudgetBytes)
+            continue;
+        usedBytes += neededBytes - resident.bytes;
+        restores.emplace_back(&resident);
+    }
+    if (!restores.empty())
+        Restore(restores);
+
+    // over budget: least recently used first, large ones first among equals, each cut as far as needed
+    if (mUsedBytes > mBudgetBytes)
+    {
+        std::vector<Resident*> candidates;
+        for (auto& [slot, resident] : mResidents)
+        {
+            if (resident.tier < resident.maxTier)
+                candidates.emplace_back(&resident);
+        }
+        std::sort(candidates.begin(), candidates.end(), [](const Resident* a, const Resident* b)
+            {
+                if (a->slot->lastUsedFrame != b->slot->lastUsedFrame)
+                    return a->slot->lastUsedFrame < b->slot->lastUsedFrame;
+                return a->bytes > b->bytes;
+            });
+
+        for (Resident* resident : candidates)
+        {
+            if (mUsedBytes <= mBudgetBytes)
+                break;
+
+            int tier = resident->tier;
+            size_t bytes = resident->bytes;
+            while (tier < resident->maxTier && mUsedBytes - resident->bytes + bytes > mBudgetBytes)
+                bytes = GetBytes(*resident, ++tier);
+            Downgrade(*resident, tier);
+        }
+    }
+
+    mFrame++;
+}
+
+void TextureResidency::Downgrade(Resident& resident, int tier)
+{
+    int drop = tier - resident.tier;
+    int levels = resident.levels - tier;
+    GLsizei width = std::max(resident.width >> tier, 1);
+    GLsizei height = std::max(resident.height >> tier, 1);
+    GLuint old = resident.slot->texture;
+
+    // same sampling state as the original
+    GLuint texture;
+    glCreateTextures(GL_TEXTURE_2D, 1, &texture);
+    for (GLenum parameter : { GL_TEXTURE_WRAP_S, GL_TEXTURE_WRAP_T, GL_TEXTURE_MIN_FILTER, GL_TEXTURE_MAG_FILTER })
+    {
+        GLint value;
+        glGetTextureParameteriv(old, parameter, &value);
+        glTextureParameteri(texture, parameter, value);
+    }
+    GLint swizzle[4];
+    glGetTextureParameteriv(old, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+    glTextureParameteriv(texture, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+    glTextureStorage2D(texture, levels, resident.format, width, height);
+
+    // the smaller levels are already there, copied on the GPU without a round trip
+    for (int level = 0; level < levels; level++)
+    {
+        glCopyImageSubData(old, GL_TEXTURE_2D, level + drop, 0, 0, 0, texture, GL_TEXTURE_2D, level, 0, 0, 0,
+            std::max(width >> level, 1), std::max(height >> level, 1), 1);
+    }
+    glDeleteTextures(1, &old);
+
+    resident.tier = tier;
+    resident.slot->texture = texture;
+    resident.slot->generation++;
+    UpdateBytes(resident);
+    mDowngradeCount++;
+}
+
+void TextureResidency::Restore(std::vector<Resident*>& residents)
+{
+    std::vector<TextureSource> sources;
+    std::vector<int> maxSizes;
+    for (Resident* resident : residents)
+    {
+        sources.emplace_back(resident->source);
+        maxSizes.emplace_back(resident->neededTier > 0 ? std::max(resident->width, resident->height) >> resident->neededTier : 0);
+    }
+
+    // through the caches the first load wrote, nothing is decoded again. every frame may do this, no log
+    std::vector<UploadedTexture> uploaded;
+    mUploader.Load(sources, uploaded, maxSizes, true);
+    for (size_t i = 0; i < residents.size(); i++)
+    {
+        if (uploaded[i].texture == 0)
+            continue;
+
+        Resident& resident = *residents[i];
+        glDeleteTextures(1, &resident.slot->texture);
+        resident.slot->texture = uploaded[i].texture;
+        resident.slot->generation++;
+        resident.tier = uploaded[i].skippedLevels;
+        // the size limit got in the way, no point asking again
+        if (resident.tier > resident.neededTier)
+            resident.minTier = resident.neededTier = resident.tier;
+        resident.neededFrame = mFrame;
+
+        UpdateBytes(resident);
+        mRestoreCount++;
+    }
+}
+
+size_t TextureResidency::GetBytes(const Resident& resident, int tier) const
+{
+    // bytes per 4x4 block for the block formats, per texel otherwise
+    size_t blockBytes = 0, texelBytes = 4;
+    switch (resident.format)
+    {
+        case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+        case GL_COMPRESSED_SRGB_S3TC_DXT1_EXT:
+        case GL_COMPRESSED_RED_RGTC1:
+            blockBytes = 8;
+            break;
+        case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+        case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT:
+        case GL_COMPRESSED_RG_RGTC2:
+        case GL_COMPRESSED_RGBA_BPTC_UNORM:
+        case GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM:
+            blockBytes = 16;
+            break;
+        case GL_R8: texelBytes = 1; break;
+        case GL_RG8: texelBytes = 2; break;
+        default: break;  // RGB8 is padded to 4 bytes by drivers
+    }
+
+    size_t bytes = 0;
+    for (int level = tier; level < resident.levels; level++)
+    {
+        size_t w = std::max(resident.width >> level, 1), h = std::max(resident.height >> level, 1);
+        bytes += blockBytes ? (w + 3) / 4 * ((h + 3) / 4) * blockBytes : w * h * texelBytes;
+    }
+    return bytes;
+}
+
+size_t TextureResidency::GetRgba8Bytes(const Resident& resident, int tier) const
+{
+    size_t bytes = 0;
+    for (int level = tier; level < resident.levels; level++)
+        bytes += static_cast<size_t>(std::max(resident.width >> level, 1)) * std::max(resident.height >> level, 1) * 4;
+    return bytes;
+}
+
+void TextureResidency::UpdateBytes(Resident& resident)
+{
+    size_t bytes = GetBytes(resident, resident.tier);
+    size_t rgba8Bytes = GetRgba8Bytes(resident, resident.tier);
+    mUsedBytes = mUsedBytes - resident.bytes + bytes;
+    mRgba8Bytes = mRgba8Bytes - resident.rgba8Bytes + rgba8Bytes;
+    resident.bytes = bytes;
+    resident.rgba8Bytes = rgba8Bytes;
+}
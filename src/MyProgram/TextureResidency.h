@@ -0,0 +1,133 @@
+#pragma once
+
+#include <gl/gl3w.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "TextureSource.h"
+
+class TextureUploader;
+struct UploadedTexture;
+
+// stable reference to a resident texture. the GL name changes when the residency manager swaps the storage,
+// draws read it through Use() every time, which also marks the texture as used this frame
+struct TextureSlot
+{
+    GLuint texture = 0;
+    uint32_t generation = 0;          // bumped with every texture put behind the slot, GL names get reused
+    uint64_t lastUsedFrame = 0;
+    const uint64_t* frame = nullptr;  // the manager's frame counter
+    int feedbackId = -1;              // TextureFeedback entry, -1: not streamed
+    int width = 0;                    // at full resolution, for the feedback's mip level
+    int height = 0;
+
+    GLuint Use()
+    {
+        lastUsedFrame = *frame;
+        return texture;
+    }
+};
+
+// keeps texture memory under a byte budget. once over it, the least recently used textures are cut down to
+// lower resolution tiers (the top mip levels dropped, the rest copied on the GPU), as far as the floor tier.
+// a reduced texture drawn in the last frame is reloaded at the tier it needs as soon as it fits again.
+// with streaming, textures start out at GetStartSize() and the tier they need comes from TextureFeedback:
+// finer levels are streamed in when sampled, and dropped again once unused for a while. GL thread only
+class TextureResidency
+{
+public:
+    TextureResidency(TextureUploader& uploader, size_t budgetBytes, size_t feedbackCapacity, bool streaming = true);
+    ~TextureResidency();
+
+    TextureResidency(const TextureResidency&) = delete;
+    TextureResidency& operator=(const TextureResidency&) = delete;
+
+public:
+    // largest size a texture is first loaded at, 0: full resolution
+    int GetStartSize() const;
+    // takes over the texture, uploaded from "source" with immutable storage. "streamed": loaded at GetStartSize()
+    // and a shader reports its mips, the others stay at their finest tier unless the budget says otherwise
+    TextureSlot* Add(const TextureSource& source, const UploadedTexture& uploaded, bool streamed);
+    // deletes the texture
+    void Remove(TextureSlot* slot);
+    // reloads "slots" at their finest tier right away, for rendering from them once, e.g. baking.
+    // streamed ones go back down when nothing asks for them
+    void Require(const std::vector<TextureSlot*>& slots);
+    // texture memory held outside the residency, e.g. material arrays: counted against the budget, never trimmed.
+    // replaces what "owner" reserved before, 0 bytes releases it
+    void Reserve(const void* owner, size_t bytes, size_t rgba8Bytes);
+
+    // mip levels requested per feedback id, from TextureFeedback::Update
+    void ApplyFeedback(const std::vector<uint32_t>& levels);
+    // false while nothing draws with feedback: streamed textures then need their finest tier like the others
+    void SetFeedbackActive(bool active) { mFeedbackActive = active; }
+    // once per frame before drawing: streams in what was drawn last frame, then trims down to the budget
+    void Update();
+
+public:
+    void SetBudget(size_t bytes) { mBudgetBytes = bytes; }
+    const bool IsStreaming() const { return mStreaming; }
+    const size_t GetBudget() const { return mBudgetBytes; }
+    // texture memory of everything resident right now, the one place that counts it
+    const size_t GetUsedBytes() const { return mUsedBytes; }
+    // the same textures at the same tiers as RGBA8
+    const size_t GetRgba8Bytes() const { return mRgba8Bytes; }
+    const size_t GetTextureCount() const { return mResidents.size(); }
+    // textures below the resolution they need right now
+    const size_t GetReducedCount() const;
+    const size_t GetDowngradeCount() const { return mDowngradeCount; }
+    const size_t GetRestoreCount() const { return mRestoreCount; }
+
+private:
+    struct Resident
+    {
+        std::unique_ptr<TextureSlot> slot;
+        TextureSource source;
+        GLenum format = 0;
+        int width = 0;  // at full resolution
+        int height = 0;
+        int levels = 0;
+        int tier = 0;              // top levels dropped
+        int minTier = 0;           // the uploader's size limit
+        int maxTier = 0;           // the floor tier
+        int neededTier = 0;        // from the feedback, minTier without
+        uint64_t neededFrame = 0;  // last frame the current tier was still needed
+        size_t bytes = 0;
+        size_t rgba8Bytes = 0;
+    };
+
+    struct Reservation
+    {
+        size_t bytes = 0;
+        size_t rgba8Bytes = 0;
+    };
+
+private:
+    void Downgrade(Resident& resident, int tier);
+    // reloads each resident at its needed tier
+    void Restore(std::vector<Resident*>& residents);
+    size_t GetBytes(const Resident& resident, int tier) const;
+    size_t GetRgba8Bytes(const Resident& resident, int tier) const;
+    // the totals follow a change of "resident.tier"
+    void UpdateBytes(Resident& resident);
+
+private:
+    TextureUploader& mUploader;
+    size_t mBudgetBytes;
+    bool mStreaming;
+    bool mFeedbackActive = true;
+    std::vector<int> mFreeFeedbackIds;
+    std::vector<TextureSlot*> mFeedbackSlots;
+    size_t mUsedBytes = 0;
+    size_t mRgba8Bytes = 0;
+    uint64_t mFrame = 1;
+    std::unordered_map<TextureSlot*, Resident> mResidents;
+    std::unordered_map<const void*, Reservation> mReservations;
+
+    size_t mDowngradeCount = 0;
+    size_t mRestoreCount = 0;
+};
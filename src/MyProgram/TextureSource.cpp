@@ -0,0 +1,119 @@
+#include "TextureSource.h"
+
+#include <stb_image.h>
+#include <fmt/core.h>
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "MappedFile.h"
+
+static void HashBytes(uint64_t& hash, const uint8_t* bytes, size_t size)
+{
+    for (size_t i = 0; i < size; i++)
+        hash = (hash ^ bytes[i]) * 1099511628211ull;
+}
+
+// stbi straight from the mapped file, "channels" 0 keeps the file's own count
+static uint8_t* DecodeFile(const std::string& file, int& width, int& height, int& channels, int wantedChannels)
+{
+    MappedFile mapped;
+    if (!mapped.Open(file))
+    {
+        fmt::print(stderr, "[TEXTURE-ERROR] Failed to load {}\n", file);
+        return nullptr;
+    }
+
+    uint8_t* pixels = stbi_load_from_memory(mapped.GetData(), static_cast<int>(mapped.GetSize()), &width, &height, &channels, wantedChannels);
+    if (!pixels)
+        fmt::print(stderr, "[TEXTURE-ERROR] Failed to decode {}\n", file);
+    else if (wantedChannels != 0)
+        channels = wantedChannels;
+    return pixels;
+}
+
+std::string TextureSource::GetName() const
+{
+    if (!IsPacked())
+        return file;
+    for (const std::string& packed : packedFiles)
+        if (!packed.empty())
+            return packed + ".packed";
+    return ".packed";
+}
+
+bool HashTextureSource(const TextureSource& source, uint64_t& hash)
+{
+    hash = 14695981039346656037ull;
+    uint8_t layout[5] = { static_cast<uint8_t>(source.semantic), static_cast<uint8_t>(source.IsPacked()),
+        source.packedDefaults[0], source.packedDefaults[1], source.packedDefaults[2] };
+    HashBytes(hash, layout, sizeof(layout));
+
+    const std::string* files = source.IsPacked() ? source.packedFiles.data() : &source.file;
+    size_t fileCount = source.IsPacked() ? source.packedFiles.size() : 1;
+    for (size_t i = 0; i < fileCount; i++)
+    {
+        // a missing channel hashes differently from an empty file
+        uint8_t present = !files[i].empty();
+        HashBytes(hash, &present, 1);
+        if (!present)
+            continue;
+
+        MappedFile mapped;
+        if (!mapped.Open(files[i]))
+        {
+            fmt::print(stderr, "[TEXTURE-ERROR] Failed to load {}\n", files[i]);
+            return false;
+        }
+        HashBytes(hash, mapped.GetData(), mapped.GetSize());
+    }
+    return true;
+}
+
+bool DecodeTextureSource(const TextureSource& source, TextureImage& image)
+{
+    if (!source.IsPacked())
+    {
+        uint8_t* pixels = DecodeFile(source.file, image.width, image.height, image.channels, 0);
+        if (!pixels)
+            return false;
+        image.pixels.assign(pixels, pixels + static_cast<size_t>(image.width) * image.height * image.channels);
+        stbi_image_free(pixels);
+        return true;
+    }
+
+    image.width = image.height = 0;
+    image.channels = 3;
+    for (size_t ch = 0; ch < source.packedFiles.size(); ch++)
+    {
+        if (source.packedFiles[ch].empty())
+            continue;
+
+        int width, height, channels;
+        uint8_t* pixels = DecodeFile(source.packedFiles[ch], width, height, channels, 1);
+        if (!pixels)
+            continue;
+
+        if (image.width == 0)
+        {
+            image.width = width;
+            image.height = height;
+            image.pixels.resize(static_cast<size_t>(width) * height * 3);
+            for (size_t i = 0; i < image.pixels.size(); i++)
+                image.pixels[i] = source.packedDefaults[i % 3];
+        }
+        if (width != image.width || height != image.height)
+        {
+            fmt::print(stderr, "[TEXTURE-ERROR] {} is {}x{}, packed with {}x{}\n", source.packedFiles[ch], width, height, image.width, image.height);
+            stbi_image_free(pixels);
+            continue;
+        }
+
+        for (size_t i = 0; i < static_cast<size_t>(width) * height; i++)
+            image.pixels[i * 3 + ch] = pixels[i];
+        stbi_image_free(pixels);
+    }
+    return image.width != 0;
+}
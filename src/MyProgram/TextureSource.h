@@ -0,0 +1,39 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+enum class TextureSemantic
+{
+    Color,  // authored in sRGB, filtered in linear space
+    Data,   // roughness, metalness, AO, masks: stored and filtered as is
+};
+
+// what one GL texture is made of: an image file, or grey images packed into the r, g, b channels
+struct TextureSource
+{
+    TextureSemantic semantic = TextureSemantic::Color;
+    std::string file;
+    std::array<std::string, 3> packedFiles;  // used when "file" is empty, empty entries take their default
+    std::array<uint8_t, 3> packedDefaults = { 255, 255, 0 };
+
+    bool IsPacked() const { return file.empty(); }
+    // caches are named after it: the file, or the first packed file + ".packed"
+    std::string GetName() const;
+};
+
+// decoded pixels, "channels" bytes per pixel, rows tightly packed
+struct TextureImage
+{
+    int width = 0;
+    int height = 0;
+    int channels = 0;
+    std::vector<uint8_t> pixels;
+};
+
+// FNV-1a over the contents of every file, the packing and the semantic. false if a file can't be read
+bool HashTextureSource(const TextureSource& source, uint64_t& hash);
+// packed sources come out with 3 channels, a file whose size differs from the first packed one keeps its default
+bool DecodeTextureSource(const TextureSource& source, TextureImage& image);
@@ -0,0 +1,333 @@
+#include "TextureUploader.h"
+
+#include <gl/gl3w.h>
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "ThreadPool.h"
+#include "MipChain.h"
+
+// ranges start on this boundary
+static constexpr GLsizeiptr RingAlignment = 256;
+
+TextureUploader::TextureUploader(ThreadPool& pool, TextureCompression compression, bool srgbColor, GLsizeiptr ringSize)
+    : mPool(pool)
+    , mCompression(compression)
+    , mSrgbColor(srgbColor)
+    , mRingSize(ringSize)
+{
+    // S3TC is an extension even in 4.5, without it the RGBA8 path takes over
+    if (!IsCompressionSupported(mCompression))
+    {
+        fmt::print("[TEXTURE] No GL_EXT_texture_compression_s3tc, textures are uploaded uncompressed\n");
+        mCompression = TextureCompression::None;
+    }
+
+    // coherent, so worker writes need no flush before the GL thread reads the range
+    const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glCreateBuffers(1, &mBuffer);
+    glNamedBufferStorage(mBuffer, mRingSize, nullptr, flags);
+    mMapped = static_cast<unsigned char*>(glMapNamedBufferRange(mBuffer, 0, mRingSize, flags));
+}
+
+TextureUploader::~TextureUploader()
+{
+    for (Fence& fence : mFences)
+        glDeleteSync(fence.sync);
+    glUnmapNamedBuffer(mBuffer);
+    glDeleteBuffers(1, &mBuffer);
+}
+
+void TextureUploader::Load(const std::vector<TextureSource>& sources, std::vector<UploadedTexture>& textures, const std::vector<int>& maxSizes,
+    bool quiet)
+{
+    textures.assign(sources.size(), UploadedTexture());
+    mUploadedBytes = 0;
+    mStallCount = 0;
+    mStallMs = 0.0f;
+    mFenceWaitMs = 0.0f;
+    auto start = std::chrono::steady_clock::now();
+
+    for (size_t i = 0; i < sources.size(); i++)
+    {
+        // the tighter of both limits
+        int maxSize = i < maxSizes.size() ? maxSizes[i] : 0;
+        if (mMaxSize > 0 && (maxSize <= 0 || mMaxSize < maxSize))
+            maxSize = mMaxSize;
+        mPool.Submit([this, i, source = sources[i], maxSize, quiet]() { Decode(i, source, maxSize, quiet); });
+    }
+
+    // upload in the order the decodes finish, retire fences in between
+    for (size_t done = 0; done < sources.size();)
+    {
+        Decoded decoded;
+        bool haveDecoded = false;
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            // with fences in flight, waiting on the oldest one is what frees workers stuck on a full ring
+            if (mDecoded.empty() && mFences.empty())
+                mDecodedCondition.wait(lock, [this]() { return !mDecoded.empty(); });
+            if (!mDecoded.empty())
+            {
+                decoded = std::move(mDecoded.front());
+                mDecoded.pop_front();
+                haveDecoded = true;
+            }
+        }
+
+        if (haveDecoded)
+        {
+            if (decoded.width > 0)
+            {
+                UploadedTexture& texture = textures[decoded.index];
+                texture.texture = Upload(decoded, texture.bytes);
+                texture.width = decoded.fullWidth;
+                texture.height = decoded.fullHeight;
+                texture.levelCount = decoded.fullLevelCount;
+                texture.skippedLevels = decoded.skippedLevels;
+            }
+            done++;
+        }
+        RetireFences(!haveDecoded);
+    }
+    RetireFences(false);
+
+    auto end = std::chrono::steady_clock::now();
+    mLoadMs = std::chrono::duration<float, std::milli>(end - start).count();
+
+    if (!quiet)
+    {
+        fmt::print("[TEXTURE] Streamed {} textures, {:.1f} MB in {:.1f} ms ({:.0f} MB/s), {} ring stalls ({:.1f} ms), {:.1f} ms fence waits\n",
+            sources.size(), mUploadedBytes / (1024.0f * 1024.0f), mLoadMs, GetMegabytesPerSecond(), mStallCount, mStallMs, mFenceWaitMs);
+    }
+}
+
+void TextureUploader::Decode(size_t index, const TextureSource& source, int maxSize, bool quiet)
+{
+    Decoded decoded;
+    decoded.index = index;
+    decoded.srgb = mSrgbColor && source.semantic == TextureSemantic::Color;
+
+    // both sources come as a whole mip chain, built this run or mapped from their cache
+    auto take = [this, &decoded, maxSize](auto& levels)
+    {
+        // low memory profiles and streamed textures leave out the levels above the size limit
+        size_t skip = 0, skippedBytes = 0;
+        while (maxSize > 0 && skip + 1 < levels.levelSizes.size() &&
+            std::max(levels.width >> skip, levels.height >> skip) > maxSize)
+            skippedBytes += levels.levelSizes[skip++];
+
+        decoded.fullWidth = levels.width;
+        decoded.fullHeight = levels.height;
+        decoded.fullLevelCount = static_cast<int>(levels.levelSizes.size());
+        decoded.skippedLevels = static_cast<int>(skip);
+        decoded.width = std::max(levels.width >> skip, 1);
+        decoded.height = std::max(levels.height >> skip, 1);
+        decoded.levelSizes.assign(levels.levelSizes.begin() + skip, levels.levelSizes.end());
+
+        size_t size = levels.GetSize() - skippedBytes;
+        decoded.offset = Acquire(static_cast<GLsizeiptr>(size));
+        if (decoded.offset >= 0)
+        {
+            std::memcpy(mMapped + decoded.offset, levels.GetData() + skippedBytes, size);
+            return;
+        }
+
+        // handed over, the buffers and the mapping stay where they are when moved
+        size_t fileOffset = levels.fileOffset;
+        decoded.data = std::move(levels.data);
+        decoded.file = std::move(levels.file);
+        decoded.client = (decoded.file.IsOpen() ? decoded.file.GetData() + fileOffset : decoded.data.data()) + skippedBytes;
+    };
+
+    if (mCompression != TextureCompression::None)
+    {
+        // a cache miss encodes right here, the block rows spread over the pool
+        CompressedTexture texture;
+        if (LoadOrCompressTexture(source, mCompression, mPool, texture, quiet))
+        {
+            decoded.compressed = true;
+            decoded.format = texture.format;
+            decoded.grey = texture.grey;
+            take(texture);
+        }
+    }
+    else
+    {
+        MipChain chain;
+        if (LoadOrBuildMipChain(source, mPool, chain, quiet))
+        {
+            decoded.channels = chain.channels;
+            decoded.grey = chain.channels <= 2;
+            take(chain);
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mDecoded.emplace_back(std::move(decoded));
+    }
+    mDecodedCondition.notify_one();
+}
+
+GLintptr TextureUploader::Acquire(GLsizeiptr size)
+{
+    size = (size + RingAlignment - 1) / RingAlignment * RingAlignment;
+    if (size > mRingSize)
+        return -1;
+
+    std::unique_lock<std::mutex> lock(mMutex);
+    auto fits = [this, size](GLintptr& offset)
+    {
+        // a range never wraps, the end of the ring is skipped instead
+        offset = mHead + size <= mRingSize ? mHead : 0;
+        if (mRanges.empty())
+            return true;
+
+        GLintptr tail = mRanges.front().offset;
+        if (mHead > tail)
+            return offset == mHead || size <= tail;
+        // wrapped, the free space ends at the tail. mHead == tail is a full ring
+        return offset == mHead && mHead + size <= tail;
+    };
+
+    GLintptr offset;
+    if (!fits(offset))
+    {
+        auto start = std::chrono::steady_clock::now();
+        mSpaceCondition.wait(lock, [&]() { return fits(offset); });
+        auto end = std::chrono::steady_clock::now();
+        mStallCount++;
+        mStallMs += std::chrono::duration<float, std::milli>(end - start).count();
+    }
+
+    mRanges.push_back({ offset, size, false });
+    mHead = offset + size;
+    return offset;
+}
+
+void TextureUploader::Release(GLintptr offset)
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        for (Range& range : mRanges)
+        {
+            if (range.offset == offset && !range.released)
+            {
+                range.released = true;
+                break;
+            }
+        }
+
+        // out of order releases wait for the ranges before them
+        while (!mRanges.empty() && mRanges.front().released)
+            mRanges.pop_front();
+        if (mRanges.empty())
+            mHead = 0;
+    }
+    mSpaceCondition.notify_all();
+}
+
+// uncompressed storage with the source's channels, internal format and the matching pixel format
+static void UncompressedFormat(int channels, bool srgb, GLenum& format, GLenum& pixelFormat)
+{
+    switch (channels)
+    {
+        case 1: format = GL_R8; pixelFormat = GL_RED; break;
+        case 2: format = GL_RG8; pixelFormat = GL_RG; break;
+        case 3: format = srgb ? GL_SRGB8 : GL_RGB8; pixelFormat = GL_RGB; break;
+        default: format = srgb ? GL_SRGB8_ALPHA8 : GL_RGBA8; pixelFormat = GL_RGBA; break;
+    }
+}
+
+GLuint TextureUploader::Upload(Decoded& decoded, size_t& bytes)
+{
+    GLenum format, pixelFormat = GL_RGBA;
+    if (decoded.compressed)
+        format = GetCompressedFormat(decoded.format, decoded.srgb);
+    else
+        UncompressedFormat(decoded.channels, decoded.srgb, format, pixelFormat);
+    // grey + alpha sits in the second channel of both RG8 and BC5
+    bool greyAlpha = decoded.compressed ? decoded.format == BlockFormat::BC5 : decoded.channels == 2;
+
+    GLuint texture;
+    glCreateTextures(GL_TEXTURE_2D, 1, &texture);
+    glTextureParameteri(texture, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTextureParameteri(texture, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    if (decoded.grey)
+    {
+        // BC4 / R8 hold grey, BC5 / RG8 grey + alpha
+        GLint swizzle[4] = { GL_RED, GL_RED, GL_RED, greyAlpha ? GL_GREEN : GL_ONE };
+        glTextureParameteriv(texture, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+    }
+    glTextureStorage2D(texture, static_cast<GLsizei>(decoded.levelSizes.size()), format, decoded.width, decoded.height);
+
+    // every level comes from the CPU chain, nothing for glGenerateMipmap to do
+    bool inRing = decoded.offset >= 0;
+    if (inRing)
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, mBuffer);
+    // 1 to 3 byte texels leave rows unaligned
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    size_t levelOffset = 0;
+    for (size_t level = 0; level < decoded.levelSizes.size(); level++)
+    {
+        GLsizei width = std::max(decoded.width >> level, 1);
+        GLsizei height = std::max(decoded.height >> level, 1);
+        const void* data = inRing ? reinterpret_cast<const void*>(decoded.offset + levelOffset) : decoded.client + levelOffset;
+        if (decoded.compressed)
+            glCompressedTextureSubImage2D(texture, static_cast<GLint>(level), 0, 0, width, height, format,
+                static_cast<GLsizei>(decoded.levelSizes[level]), data);
+        else
+            glTextureSubImage2D(texture, static_cast<GLint>(level), 0, 0, width, height, pixelFormat, GL_UNSIGNED_BYTE, data);
+        levelOffset += decoded.levelSizes[level];
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    if (inRing)
+    {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        mFences.push_back({ glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0), decoded.offset });
+    }
+
+    mUploadedBytes += levelOffset;
+    bytes = levelOffset;
+    return texture;
+}
+
+void TextureUploader::RetireFences(bool block)
+{
+    // fences signal in submission order
+    while (!mFences.empty())
+    {
+        Fence& fence = mFences.front();
+        GLenum result;
+        if (block)
+        {
+            auto start = std::chrono::steady_clock::now();
+            result = glClientWaitSync(fence.sync, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+            auto end = std::chrono::steady_clock::now();
+            mFenceWaitMs += std::chrono::duration<float, std::milli>(end - start).count();
+        }
+        else
+        {
+            result = glClientWaitSync(fence.sync, 0, 0);
+        }
+
+        if (result == GL_TIMEOUT_EXPIRED)
+            return;
+
+        glDeleteSync(fence.sync);
+        Release(fence.offset);
+        mFences.pop_front();
+        block = false;
+    }
+}
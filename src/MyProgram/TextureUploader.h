@@ -0,0 +1,140 @@
+#pragma once
+
+#include <gl/gl3w.h>
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "MappedFile.h"
+#include "TextureCompressor.h"
+#include "TextureSource.h"
+
+class ThreadPool;
+
+// one texture of a Load, and where it starts in its full mip chain
+struct UploadedTexture
+{
+    GLuint texture = 0;  // 0: failed to decode
+    int width = 0;       // of the full chain, before levels were left out
+    int height = 0;
+    int levelCount = 0;
+    int skippedLevels = 0;
+    size_t bytes = 0;    // allocated for the levels uploaded
+};
+
+// streams image files into GL textures through one persistently mapped pixel unpack buffer used as a ring.
+// workers map the file's cache, or decode and build it (MipChain.h, or TextureCompressor.h with compression on),
+// and copy the whole mip chain straight into the mapped ring. the GL thread creates the textures with
+// glTextureSubImage2D / glCompressedTextureSubImage2D from the buffer and fences every upload. a ring range is
+// reused once its fence has signaled, workers wait for space when the GPU falls behind.
+// chains larger than the ring go up from client memory.
+// storage is immutable and sized by the source: R8 / RG8 for grey, RGB8 without alpha, sRGB formats for color
+// only with "srgbColor", which needs the shading to output through GL_FRAMEBUFFER_SRGB
+class TextureUploader
+{
+public:
+    TextureUploader(ThreadPool& pool, TextureCompression compression = TextureCompression::High, bool srgbColor = false,
+        GLsizeiptr ringSize = 64 * 1024 * 1024);
+    ~TextureUploader();
+
+    TextureUploader(const TextureUploader&) = delete;
+    TextureUploader& operator=(const TextureUploader&) = delete;
+
+public:
+    // blocks until every source is uploaded. "maxSizes[i]" caps the size of "sources[i]" like SetMaxSize,
+    // 0 or no entry: only the global limit. "quiet" logs nothing, for the residency's reloads. GL thread only
+    void Load(const std::vector<TextureSource>& sources, std::vector<UploadedTexture>& textures, const std::vector<int>& maxSizes = {},
+        bool quiet = false);
+
+    // textures larger than "size" in either dimension start at the first mip level that fits, 0: no limit.
+    // for low memory profiles, takes effect with the next Load
+    void SetMaxSize(int size) { mMaxSize = size; }
+    const int GetMaxSize() const { return mMaxSize; }
+
+public:
+    // of the last Load
+    const size_t GetUploadedBytes() const { return mUploadedBytes; }
+    const float GetLoadMs() const { return mLoadMs; }
+    const float GetMegabytesPerSecond() const { return mLoadMs > 0.0f ? mUploadedBytes / (1024.0f * 1024.0f) / (mLoadMs / 1000.0f) : 0.0f; }
+    // workers waiting for ring space
+    const size_t GetStallCount() const { return mStallCount; }
+    const float GetStallMs() const { return mStallMs; }
+    // GL thread blocked on the oldest fence with nothing to upload
+    const float GetFenceWaitMs() const { return mFenceWaitMs; }
+
+private:
+    struct Decoded
+    {
+        size_t index;
+        int width = 0;  // 0: failed
+        int height = 0;
+        int fullWidth = 0;
+        int fullHeight = 0;
+        int fullLevelCount = 0;
+        int skippedLevels = 0;
+        bool compressed = false;
+        BlockFormat format = BlockFormat::BC1;
+        bool grey = false;
+        int channels = 4;  // uncompressed only
+        bool srgb = false;
+        std::vector<size_t> levelSizes;
+
+        GLintptr offset = -1;             // into the ring, -1: not in the ring
+        const uint8_t* client = nullptr;  // the levels when the chain didn't fit, in "data" or "file"
+        std::vector<uint8_t> data;
+        MappedFile file;
+    };
+
+    struct Range
+    {
+        GLintptr offset;
+        GLsizeiptr size;
+        bool released;
+    };
+
+    struct Fence
+    {
+        GLsync sync;
+        GLintptr offset;
+    };
+
+private:
+    void Decode(size_t index, const TextureSource& source, int maxSize, bool quiet);
+    // -1 if "size" can never fit
+    GLintptr Acquire(GLsizeiptr size);
+    void Release(GLintptr offset);
+    GLuint Upload(Decoded& decoded, size_t& bytes);
+    // frees the ranges of signaled fences, "block" waits for the oldest one
+    void RetireFences(bool block);
+
+private:
+    ThreadPool& mPool;
+    TextureCompression mCompression;
+    bool mSrgbColor;
+    int mMaxSize = 0;
+    GLuint mBuffer = 0;
+    unsigned char* mMapped = nullptr;
+    GLsizeiptr mRingSize;
+
+    // ring ranges in allocation order, the oldest unreleased one is the tail
+    std::deque<Range> mRanges;
+    GLintptr mHead = 0;
+    std::deque<Decoded> mDecoded;
+    std::mutex mMutex;
+    std::condition_variable mSpaceCondition;
+    std::condition_variable mDecodedCondition;
+
+    // GL thread only, in submission order
+    std::deque<Fence> mFences;
+
+    size_t mUploadedBytes = 0;
+    float mLoadMs = 0.0f;
+    size_t mStallCount = 0;
+    float mStallMs = 0.0f;
+    float mFenceWaitMs = 0.0f;
+};
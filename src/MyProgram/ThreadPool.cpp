@@ -0,0 +1,97 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+ThreadPool::ThreadPool(size_t threadCount)
+{
+    if (threadCount == 0)
+    {
+        size_t cores = std::thread::hardware_concurrency();
+        threadCount = cores > 1 ? cores - 1 : 1;
+    }
+
+    for (size_t i = 0; i < threadCount; i++)
+        mThreads.emplace_back([this]() { WorkerLoop(); });
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStopping = true;
+    }
+    mCondition.notify_all();
+
+    for (std::thread& thread : mThreads)
+        thread.join();
+}
+
+void ThreadPool::WorkerLoop()
+{
+    for (;;)
+    {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mCondition.wait(lock, [this]() { return mStopping || !mTasks.empty(); });
+            if (mStopping && mTasks.empty())
+                return;
+
+            task = std::move(mTasks.front());
+            mTasks.pop();
+        }
+        task();
+    }
+}
+
+void ThreadPool::ParallelFor(size_t count, const std::function<void(size_t)>& fn)
+{
+    if (count == 0)
+        return;
+
+    // helpers that start late find no work left, so the state outlives this call
+    struct Job
+    {
+        std::function<void(size_t)> fn;
+        std::atomic<size_t> next{ 0 };
+        std::atomic<size_t> done{ 0 };
+        size_t count = 0;
+        std::mutex mutex;
+        std::condition_variable finished;
+    };
+    auto job = std::make_shared<Job>();
+    job->fn = fn;
+    job->count = count;
+
+    auto run = [](Job& job)
+    {
+        for (size_t i = job.next++; i < job.count; i = job.next++)
+        {
+            job.fn(i);
+            if (++job.done == job.count)
+            {
+                std::lock_guard<std::mutex> lock(job.mutex);
+                job.finished.notify_all();
+            }
+        }
+    };
+
+    size_t helpers = std::min(count - 1, mThreads.size());
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        for (size_t i = 0; i < helpers; i++)
+            mTasks.emplace([job, run]() { run(*job); });
+    }
+    mCondition.notify_all();
+
+    run(*job);
+
+    // wait only for indices other threads already claimed
+    std::unique_lock<std::mutex> lock(job->mutex);
+    job->finished.wait(lock, [&job]() { return job->done == job->count; });
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+// fixed set of worker threads for CPU side frame work and asset loading
+class ThreadPool
+{
+public:
+    // 0 -> one thread per core, minus the main thread
+    ThreadPool(size_t threadCount = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+public:
+    template <typename F>
+    auto Submit(F&& fn) -> std::future<decltype(fn())>
+    {
+        using R = decltype(fn());
+        auto task = std::make_shared<std::packaged_task<R()>>(std::forward<F>(fn));
+        std::future<R> result = task->get_future();
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mTasks.emplace([task]() { (*task)(); });
+        }
+        mCondition.notify_one();
+        return result;
+    }
+
+    // calls fn(i) for every i in [0, count), the calling thread helps.
+    // returns once all calls are finished, safe to call from a worker
+    void ParallelFor(size_t count, const std::function<void(size_t)>& fn);
+
+public:
+    const size_t GetThreadCount() const { return mThreads.size(); }
+
+private:
+    void WorkerLoop();
+
+private:
+    std::vector<std::thread> mThreads;
+    std::queue<std::function<void()>> mTasks;
+    std::mutex mMutex;
+    std::condition_variable mCondition;
+    bool mStopping = false;
+};
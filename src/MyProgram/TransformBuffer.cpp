@@ -0,0 +1,196 @@
+#include "TransformBuffer.h"
+
+#include <gl/gl3w.h>
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TRANSFORM_USE_SSE
+#include <xmmintrin.h>
+#include <emmintrin.h>
+#endif
+
+// normal matrix = transpose(inverse(mat3(model))) = cofactor(mat3(model)) / det
+static void ComputeNormalMatrix(const glm::mat4& model, ObjectTransform& out)
+{
+    glm::vec3 c0 = glm::vec3(model[0]);
+    glm::vec3 c1 = glm::vec3(model[1]);
+    glm::vec3 c2 = glm::vec3(model[2]);
+
+    glm::vec3 n0 = glm::cross(c1, c2);
+    glm::vec3 n1 = glm::cross(c2, c0);
+    glm::vec3 n2 = glm::cross(c0, c1);
+    float invDet = 1.0f / glm::dot(c0, n0);
+
+    out.model = model;
+    out.normal[0] = glm::vec4(n0 * invDet, 0.0f);
+    out.normal[1] = glm::vec4(n1 * invDet, 0.0f);
+    out.normal[2] = glm::vec4(n2 * invDet, 0.0f);
+}
+
+#ifdef TRANSFORM_USE_SSE
+// same math as ComputeNormalMatrix, 4 objects at a time in SoA form
+static void ComputeNormalMatrices4(const glm::mat4* models, ObjectTransform* out)
+{
+    __m128 cx[3], cy[3], cz[3];
+    for (int c = 0; c < 3; c++)
+    {
+        __m128 r0 = _mm_loadu_ps(&models[0][c].x);
+        __m128 r1 = _mm_loadu_ps(&models[1][c].x);
+        __m128 r2 = _mm_loadu_ps(&models[2][c].x);
+        __m128 r3 = _mm_loadu_ps(&models[3][c].x);
+        _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+        cx[c] = r0;
+        cy[c] = r1;
+        cz[c] = r2;
+    }
+
+    // n[i] = cross(c[i + 1], c[i + 2])
+    __m128 nx[3], ny[3], nz[3];
+    for (int i = 0; i < 3; i++)
+    {
+        int a = (i + 1) % 3;
+        int b = (i + 2) % 3;
+        nx[i] = _mm_sub_ps(_mm_mul_ps(cy[a], cz[b]), _mm_mul_ps(cz[a], cy[b]));
+        ny[i] = _mm_sub_ps(_mm_mul_ps(cz[a], cx[b]), _mm_mul_ps(cx[a], cz[b]));
+        nz[i] = _mm_sub_ps(_mm_mul_ps(cx[a], cy[b]), _mm_mul_ps(cy[a], cx[b]));
+    }
+
+    __m128 det = _mm_add_ps(
+        _mm_add_ps(_mm_mul_ps(cx[0], nx[0]), _mm_mul_ps(cy[0], ny[0])),
+        _mm_mul_ps(cz[0], nz[0]));
+    __m128 invDet = _mm_div_ps(_mm_set1_ps(1.0f), det);
+
+    for (int i = 0; i < 3; i++)
+    {
+        __m128 x = _mm_mul_ps(nx[i], invDet);
+        __m128 y = _mm_mul_ps(ny[i], invDet);
+        __m128 z = _mm_mul_ps(nz[i], invDet);
+        __m128 w = _mm_setzero_ps();
+        _MM_TRANSPOSE4_PS(x, y, z, w);
+        _mm_storeu_ps(&out[0].normal[i].x, x);
+        _mm_storeu_ps(&out[1].normal[i].x, y);
+        _mm_storeu_ps(&out[2].normal[i].x, z);
+        _mm_storeu_ps(&out[3].normal[i].x, w);
+    }
+
+    for (int k = 0; k < 4; k++)
+        out[k].model = models[k];
+}
+#endif
+
+static void ComputeNormalMatrices(const glm::mat4* models, const glm::vec4* colors, ObjectTransform* out, size_t count)
+{
+    size_t i = 0;
+#ifdef TRANSFORM_USE_SSE
+    for (; i + 4 <= count; i += 4)
+        ComputeNormalMatrices4(models + i, out + i);
+#endif
+    for (; i < count; i++)
+        ComputeNormalMatrix(models[i], out[i]);
+
+    for (i = 0; i < count; i++)
+        out[i].color = colors[i];
+}
+
+TransformBuffer::TransformBuffer(GLuint binding)
+    : mBinding(binding)
+{
+    glGenBuffers(1, &mId);
+}
+
+TransformBuffer::~TransformBuffer()
+{
+    glDeleteBuffers(1, &mId);
+}
+
+GLuint TransformBuffer::Add(const glm::mat4& model, const glm::vec4& color)
+{
+    GLuint index = static_cast<GLuint>(mModels.size());
+    mModels.emplace_back(model);
+    mColors.emplace_back(color);
+    mObjects.emplace_back();
+    MarkDirty(index, index + 1);
+
+    return index;
+}
+
+void TransformBuffer::Set(GLuint index, const glm::mat4& model)
+{
+    mModels[index] = model;
+    MarkDirty(index, index + 1);
+}
+
+void TransformBuffer::SetColor(GLuint index, const glm::vec4& color)
+{
+    mColors[index] = color;
+    MarkDirty(index, index + 1);
+}
+
+void TransformBuffer::Resize(size_t count)
+{
+    size_t oldCount = mModels.size();
+    mModels.resize(count, glm::mat4(1.0f));
+    mColors.resize(count, glm::vec4(1.0f));
+    mObjects.resize(count);
+
+    if (count > oldCount)
+        MarkDirty(oldCount, count);
+}
+
+void TransformBuffer::MarkDirty(size_t begin, size_t end)
+{
+    if (mDirtyBegin == mDirtyEnd)
+    {
+        mDirtyBegin = begin;
+        mDirtyEnd = end;
+        return;
+    }
+
+    mDirtyBegin = std::min(mDirtyBegin, begin);
+    mDirtyEnd = std::max(mDirtyEnd, end);
+}
+
+void TransformBuffer::Update()
+{
+    // range may point past the end after shrinking Resize()
+    mDirtyEnd = std::min(mDirtyEnd, mModels.size());
+    if (mDirtyBegin >= mDirtyEnd)
+    {
+        mDirtyBegin = mDirtyEnd = 0;
+        return;
+    }
+
+    ComputeNormalMatrices(
+        mModels.data() + mDirtyBegin,
+        mColors.data() + mDirtyBegin,
+        mObjects.data() + mDirtyBegin,
+        mDirtyEnd - mDirtyBegin);
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, mId);
+    if (mObjects.size() > mCapacity)
+    {
+        // grow geometrically and re-upload everything
+        mCapacity = std::max(mObjects.size(), mCapacity * 2);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, mCapacity * sizeof(ObjectTransform), nullptr, GL_DYNAMIC_DRAW);
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, mObjects.size() * sizeof(ObjectTransform), mObjects.data());
+    }
+    else
+    {
+        glBufferSubData(GL_SHADER_STORAGE_BUFFER,
+            mDirtyBegin * sizeof(ObjectTransform),
+            (mDirtyEnd - mDirtyBegin) * sizeof(ObjectTransform),
+            mObjects.data() + mDirtyBegin);
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    mDirtyBegin = mDirtyEnd = 0;
+}
+
+void TransformBuffer::Bind() const
+{
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, mBinding, mId);
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <gl/gl3w.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+
+// one entry of the "Transforms" SSBO (std430 layout)
+struct ObjectTransform
+{
+    glm::mat4 model;
+    glm::vec4 normal[3];  // mat3 columns are padded to vec4 in std430
+    glm::vec4 color;      // per object/instance tint
+};
+
+// CPU side world/normal matrices of every object, uploaded as an SSBO
+// vertex shaders index it with "objectIndex + gl_InstanceID" instead of a per-draw "model" uniform,
+// so instanced draws read a contiguous range of objects
+class TransformBuffer
+{
+public:
+    TransformBuffer(GLuint binding);
+    ~TransformBuffer();
+
+    TransformBuffer(const TransformBuffer&) = delete;
+    TransformBuffer& operator=(const TransformBuffer&) = delete;
+
+public:
+    // returns index of the new object
+    GLuint Add(const glm::mat4& model = glm::mat4(1.0f), const glm::vec4& color = glm::vec4(1.0f));
+    void Set(GLuint index, const glm::mat4& model);
+    void SetColor(GLuint index, const glm::vec4& color);
+    void Resize(size_t count);
+
+    // computes normal matrices of changed objects and uploads them
+    void Update();
+    void Bind() const;
+
+public:
+    const glm::mat4& Get(GLuint index) const { return mModels[index]; }
+    const size_t GetCount() const { return mModels.size(); }
+    const GLuint GetId() const { return mId; }
+    const GLuint GetBinding() const { return mBinding; }
+
+private:
+    void MarkDirty(size_t begin, size_t end);
+
+private:
+    GLuint mId = 0;
+    GLuint mBinding;
+    size_t mCapacity = 0;
+
+    std::vector<glm::mat4> mModels;
+    std::vector<glm::vec4> mColors;
+    std::vector<ObjectTransform> mObjects;
+
+    // [mDirtyBegin, mDirtyEnd) needs recompute + upload
+    size_t mDirtyBegin = 0;
+    size_t mDirtyEnd = 0;
+};
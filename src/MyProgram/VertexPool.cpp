@@ -0,0 +1,123 @@
+#include "VertexPool.h"
+
+#include <gl/gl3w.h>
+
+#include <glm/glm.hpp>
+
+#include <fmt/core.h>
+
+#include <cstdint>
+#include <vector>
+
+#include "Mesh.h"
+#include "Model.h"
+
+static GLuint PackUnorm16x2(float a, float b)
+{
+    GLuint x = static_cast<GLuint>(glm::round(glm::clamp(a, 0.0f, 1.0f) * 65535.0f));
+    GLuint y = static_cast<GLuint>(glm::round(glm::clamp(b, 0.0f, 1.0f) * 65535.0f));
+    return x | (y << 16);
+}
+
+static GLuint PackSnorm16x2(float a, float b)
+{
+    // two's complement halves, like GLSL packSnorm2x16
+    uint16_t x = static_cast<uint16_t>(static_cast<int16_t>(glm::round(glm::clamp(a, -1.0f, 1.0f) * 32767.0f)));
+    uint16_t y = static_cast<uint16_t>(static_cast<int16_t>(glm::round(glm::clamp(b, -1.0f, 1.0f) * 32767.0f)));
+    return static_cast<GLuint>(x) | (static_cast<GLuint>(y) << 16);
+}
+
+// unit vector -> [-1, 1]^2, z up octahedron. decoded by OctahedralNormal in shader.vert
+static glm::vec2 OctahedralEncode(const glm::vec3& n)
+{
+    glm::vec3 d = n / (glm::abs(n.x) + glm::abs(n.y) + glm::abs(n.z));
+    glm::vec2 e = glm::vec2(d.x, d.y);
+    if (d.z < 0.0f)
+    {
+        e = glm::vec2(
+            (1.0f - glm::abs(d.y)) * (d.x >= 0.0f ? 1.0f : -1.0f),
+            (1.0f - glm::abs(d.x)) * (d.y >= 0.0f ? 1.0f : -1.0f));
+    }
+    return e;
+}
+
+VertexPool::VertexPool(GLuint floatBinding, GLuint quantizedBinding)
+    : mFloatBinding(floatBinding)
+    , mQuantizedBinding(quantizedBinding)
+{
+    // no attributes at all, the element buffer is bound per draw
+    glGenVertexArrays(1, &mVAO);
+    glGenBuffers(1, &mFloatBuffer);
+    glGenBuffers(1, &mQuantizedBuffer);
+}
+
+VertexPool::~VertexPool()
+{
+    glDeleteVertexArrays(1, &mVAO);
+    glDeleteBuffers(1, &mFloatBuffer);
+    glDeleteBuffers(1, &mQuantizedBuffer);
+}
+
+void VertexPool::AddModel(Model& model)
+{
+    for (Mesh& mesh : model.GetMeshes())
+        AddMesh(mesh);
+    Upload();
+
+    fmt::print("[VERTEX] Pooled {} meshes of \"{}\", {} vertices: {} KB float, {} KB quantized\n",
+        model.GetMeshes().size(), model.GetPath(), GetVertexCount(), GetFloatBytes() / 1024, GetQuantizedBytes() / 1024);
+}
+
+void VertexPool::AddMesh(Mesh& mesh)
+{
+    if (mesh.vertices.empty())
+        return;
+
+    VertexDecode decode;
+    decode.positionMin = mesh.boundsMin;
+    // flat meshes still divide by something
+    decode.positionExtent = glm::max(mesh.boundsMax - mesh.boundsMin, glm::vec3(1e-20f));
+
+    glm::vec2 texCoordMin = mesh.vertices[0].texCoords;
+    glm::vec2 texCoordMax = texCoordMin;
+    for (const Vertex& v : mesh.vertices)
+    {
+        texCoordMin = glm::min(texCoordMin, v.texCoords);
+        texCoordMax = glm::max(texCoordMax, v.texCoords);
+    }
+    decode.texCoordRange = glm::vec4(texCoordMin, glm::max(texCoordMax - texCoordMin, glm::vec2(1e-20f)));
+
+    GLint baseVertex = static_cast<GLint>(mQuantized.size());
+    for (const Vertex& v : mesh.vertices)
+    {
+        mFloats.insert(mFloats.end(), {
+            v.position.x, v.position.y, v.position.z,
+            v.normal.x, v.normal.y, v.normal.z,
+            v.texCoords.x, v.texCoords.y });
+
+        glm::vec3 position = (v.position - decode.positionMin) / decode.positionExtent;
+        float normalLength = glm::length(v.normal);
+        glm::vec2 normal = normalLength > 0.0f ? OctahedralEncode(v.normal / normalLength) : glm::vec2(0.0f);
+        glm::vec2 texCoords = (v.texCoords - texCoordMin) / glm::vec2(decode.texCoordRange.z, decode.texCoordRange.w);
+
+        mQuantized.emplace_back(
+            PackUnorm16x2(position.x, position.y),
+            PackUnorm16x2(position.z, 0.0f),
+            PackSnorm16x2(normal.x, normal.y),
+            PackUnorm16x2(texCoords.x, texCoords.y));
+    }
+
+    mesh.SetVertexPool(this, baseVertex, decode);
+}
+
+void VertexPool::Upload()
+{
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, mFloatBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, mFloats.size() * sizeof(float), mFloats.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, mQuantizedBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, mQuantized.size() * sizeof(glm::uvec4), mQuantized.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, mFloatBinding, mFloatBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, mQuantizedBinding, mQuantizedBuffer);
+}
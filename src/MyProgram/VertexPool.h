@@ -0,0 +1,67 @@
+#pragma once
+
+#include <gl/gl3w.h>
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <vector>
+
+class Mesh;
+class Model;
+
+// how shader.vert / depth.vert get their vertex attributes
+enum class VertexFetch
+{
+    Attributes = 0,       // per mesh VAO, fixed-function fetch
+    Pulled = 1,           // "FloatVertices" SSBO, the 32 byte Vertex as is
+    PulledQuantized = 2,  // "QuantizedVertices" SSBO, 16 bytes: unorm16 position, octahedral snorm16 normal, unorm16 uv
+};
+
+// decode ranges of one mesh's quantized vertices
+struct VertexDecode
+{
+    glm::vec3 positionMin;  // mesh AABB
+    glm::vec3 positionExtent;
+    glm::vec4 texCoordRange;  // xy: min, zw: extent
+};
+
+// vertices of every registered mesh in two storage buffers, fetched by the vertex shaders themselves
+// from gl_VertexID + "vertexBase". pulled draws all use the one VAO without attributes,
+// only the element buffer is switched per mesh. the VertexFetch mode is a shader-side branch,
+// so it can change every frame without touching the meshes
+class VertexPool
+{
+public:
+    VertexPool(GLuint floatBinding, GLuint quantizedBinding);
+    ~VertexPool();
+
+    VertexPool(const VertexPool&) = delete;
+    VertexPool& operator=(const VertexPool&) = delete;
+
+public:
+    // meshes of models drawn with shader.vert and depth.vert only
+    void AddModel(Model& model);
+
+    void SetFetch(VertexFetch fetch) { mFetch = fetch; }
+    const VertexFetch GetFetch() const { return mFetch; }
+    const bool IsPulling() const { return mFetch != VertexFetch::Attributes; }
+    const GLuint GetVAO() const { return mVAO; }
+
+    const size_t GetVertexCount() const { return mQuantized.size(); }
+    const size_t GetFloatBytes() const { return mFloats.size() * sizeof(float); }
+    const size_t GetQuantizedBytes() const { return mQuantized.size() * sizeof(glm::uvec4); }
+
+private:
+    void AddMesh(Mesh& mesh);
+    void Upload();
+
+private:
+    GLuint mFloatBinding, mQuantizedBinding;
+    VertexFetch mFetch = VertexFetch::Attributes;
+
+    GLuint mVAO = 0;
+    GLuint mFloatBuffer = 0, mQuantizedBuffer = 0;
+
+    std::vector<float> mFloats;  // 8 per vertex, a float array avoids std430 vec3 padding
+    std::vector<glm::uvec4> mQuantized;
+};
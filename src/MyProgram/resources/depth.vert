@@ -1,10 +1,69 @@
 #version 450 core
 layout(location = 0) in vec3 aPos;
 
-uniform mat4 lightSpaceMatrix;
-uniform mat4 model;
+struct ObjectTransform
+{
+    mat4 model;
+    mat3 normal;
+    vec4 color;
+};
+
+layout(std430, binding = 0) readonly buffer Transforms
+{
+    ObjectTransform transforms[];
+};
+
+// copies kept by the impostor split, x: copy, y: mesh fade as float bits
+layout(std430, binding = 10) readonly buffer InstanceList
+{
+    uvec2 instanceList[];
+};
+
+// vertex pulling, see VertexPool. vertices are fetched from gl_VertexID + vertexBase
+layout(std430, binding = 11) readonly buffer FloatVertices
+{
+    float floatVertices[];  // Vertex: position, normal, texCoords
+};
+
+layout(std430, binding = 12) readonly buffer QuantizedVertices
+{
+    uvec4 quantizedVertices[];  // unorm16 position xy, z, only these are read here
+};
+
+uniform int vertexFetch = 0;  // 0: attributes, 1: float SSBO, 2: quantized SSBO
+uniform int vertexBase;
+uniform vec3 positionMin;
+uniform vec3 positionExtent;
+
+// light matrix for shadow maps, camera matrix for the depth pre-pass
+uniform mat4 viewProjection;
+uniform int objectIndex;
+uniform int instanceStride = 1;  // node count of the drawn model
+uniform int instanceListBase = -1;  // -1: consecutive copies
+
+// must match shader.vert exactly, the main pass tests against these depths with GL_EQUAL
+invariant gl_Position;
+
+// must match shader.vert, both shaders compute the same position
+vec3 FetchPosition()
+{
+    int v = gl_VertexID + vertexBase;
+    if (vertexFetch == 1)
+        return vec3(floatVertices[v * 8], floatVertices[v * 8 + 1], floatVertices[v * 8 + 2]);
+    if (vertexFetch == 2)
+    {
+        uvec4 q = quantizedVertices[v];
+        return positionMin + vec3(unpackUnorm2x16(q.x), unpackUnorm2x16(q.y).x) * positionExtent;
+    }
+    return aPos;
+}
 
 void main()
 {
-    gl_Position = lightSpaceMatrix * model * vec4(aPos, 1.0);
+    int copy = gl_InstanceID;
+    if (instanceListBase >= 0)
+        copy = int(instanceList[instanceListBase + gl_InstanceID].x);
+
+    vec4 worldPos = transforms[objectIndex + copy * instanceStride].model * vec4(FetchPosition(), 1.0);
+    gl_Position = viewProjection * worldPos;
 }
\ No newline at end of file
@@ -0,0 +1,142 @@
+#version 450 core
+
+in vec2 fUV;
+in vec3 fRootPos;
+flat in vec3 fViewDir;
+flat in ivec4 fFrames;
+flat in vec2 fFrameBlend;
+flat in int fObject;
+flat in float fFade;
+
+out vec4 fragColor;
+
+struct ObjectTransform
+{
+    mat4 model;
+    mat3 normal;
+    vec4 color;
+};
+
+layout(std430, binding = 0) readonly buffer Transforms
+{
+    ObjectTransform transforms[];
+};
+
+struct Light
+{
+    vec4 positionRadius;
+    vec4 color;
+    vec4 direction;
+    vec4 params;  // x: spot inner cos, y: spot outer cos, z: shadow map index (-1: none)
+};
+
+layout(std430, binding = 1) readonly buffer Lights
+{
+    Light lights[];
+};
+
+layout(std430, binding = 2) readonly buffer ClusterGrid
+{
+    uvec2 clusters[];
+};
+
+layout(std430, binding = 3) readonly buffer LightIndices
+{
+    uint lightIndices[];
+};
+
+uniform uvec3 clusterCount;
+uniform vec2 clusterTileSize;
+uniform vec2 clusterDepthParams;
+uniform vec2 nearFar;
+
+uniform vec3 lightColor;  // ambient
+uniform vec3 camPos;
+uniform mat4 viewProjection;
+uniform float boundsRadius;
+uniform int frameGrid;
+
+uniform sampler2D albedoAtlas;
+uniform sampler2D normalDepthAtlas;
+
+// 4x4 ordered dither, must match shader.frag
+float DitherThreshold()
+{
+    const float bayer[16] = float[](0, 8, 2, 10, 12, 4, 14, 6, 3, 11, 1, 9, 15, 7, 13, 5);
+    ivec2 p = ivec2(gl_FragCoord.xy) & 3;
+    return (bayer[p.y * 4 + p.x] + 0.5) / 16.0;
+}
+
+uint ClusterIndex(float windowDepth)
+{
+    float ndcZ = windowDepth * 2.0 - 1.0;
+    float depth = 2.0 * nearFar.x * nearFar.y / (nearFar.y + nearFar.x - ndcZ * (nearFar.y - nearFar.x));
+
+    uint slice = uint(clamp(log(depth) * clusterDepthParams.x + clusterDepthParams.y, 0.0, float(clusterCount.z - 1)));
+    uvec2 tile = min(uvec2(gl_FragCoord.xy / clusterTileSize), clusterCount.xy - 1);
+    return tile.x + clusterCount.x * (tile.y + clusterCount.y * slice);
+}
+
+void main()
+{
+    // the mesh copy keeps the other pixels of the crossfade
+    if (fFade >= DitherThreshold())
+        discard;
+
+    vec2 frames[4] = vec2[](vec2(fFrames.xy), vec2(fFrames.zy), vec2(fFrames.xw), vec2(fFrames.zw));
+    float weights[4] = float[](
+        (1.0 - fFrameBlend.x) * (1.0 - fFrameBlend.y),
+        fFrameBlend.x * (1.0 - fFrameBlend.y),
+        (1.0 - fFrameBlend.x) * fFrameBlend.y,
+        fFrameBlend.x * fFrameBlend.y);
+
+    // coverage weighted blend, empty texels of one view don't darken the others
+    vec4 albedo = vec4(0.0);
+    vec4 normalDepth = vec4(0.0);
+    for (int i = 0; i < 4; i++)
+    {
+        vec2 uv = (frames[i] + fUV) / float(frameGrid);
+        vec4 frameAlbedo = texture(albedoAtlas, uv);
+        albedo += frameAlbedo * weights[i];
+        normalDepth += texture(normalDepthAtlas, uv) * (weights[i] * frameAlbedo.a);
+    }
+    if (albedo.a < 0.5)
+        discard;
+    albedo.rgb /= albedo.a;
+    normalDepth /= albedo.a;
+
+    // stored depth runs from the eye plane (0) through the sphere (1)
+    ObjectTransform object = transforms[fObject];
+    vec3 rootPos = fRootPos + fViewDir * boundsRadius * (1.0 - 2.0 * normalDepth.a);
+    vec3 fragPos = vec3(object.model * vec4(rootPos, 1.0));
+    vec4 clipPos = viewProjection * vec4(fragPos, 1.0);
+    float windowDepth = clipPos.z / clipPos.w * 0.5 + 0.5;
+    gl_FragDepth = windowDepth;
+
+    vec3 normal = normalize(object.normal * (normalDepth.xyz * 2.0 - 1.0));
+    vec3 viewDir = normalize(camPos - fragPos);
+
+    // clustered lights like shader.frag, distant impostors skip the shadow lookups
+    vec3 lighting = vec3(0.0);
+    uvec2 cluster = clusters[ClusterIndex(windowDepth)];
+    for (uint i = 0; i < cluster.y; i++)
+    {
+        Light light = lights[lightIndices[cluster.x + i]];
+
+        vec3 toLight = light.positionRadius.xyz - fragPos;
+        float dist = length(toLight);
+        vec3 lightDir = toLight / dist;
+
+        float window = clamp(1.0 - pow(dist / light.positionRadius.w, 4.0), 0.0, 1.0);
+        float spot = smoothstep(light.params.y, light.params.x, dot(-lightDir, light.direction.xyz));
+        float attenuation = window * window * spot;
+        if (attenuation <= 0.0)
+            continue;
+
+        vec3 diffuse = max(dot(normal, lightDir), 0.0) * light.color.rgb;
+        float spec = pow(max(dot(normal, normalize(lightDir + viewDir)), 0.0), 64.0);
+        lighting += (diffuse + spec * light.color.rgb) * attenuation;
+    }
+
+    fragColor = vec4((0.1 * lightColor + lighting) * albedo.rgb * object.color.rgb, 1.0);
+}
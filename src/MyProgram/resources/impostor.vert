@@ -0,0 +1,78 @@
+#version 450 core
+
+out vec2 fUV;
+out vec3 fRootPos;
+flat out vec3 fViewDir;
+flat out ivec4 fFrames;  // xy: lower frame, zw: upper frame of the 2x2 around the view direction
+flat out vec2 fFrameBlend;
+flat out int fObject;
+flat out float fFade;
+
+struct ObjectTransform
+{
+    mat4 model;
+    mat3 normal;
+    vec4 color;
+};
+
+layout(std430, binding = 0) readonly buffer Transforms
+{
+    ObjectTransform transforms[];
+};
+
+// copies kept by the impostor split, x: copy, y: mesh fade as float bits
+layout(std430, binding = 10) readonly buffer InstanceList
+{
+    uvec2 instanceList[];
+};
+
+uniform int objectIndex;         // root node of the first copy
+uniform int instanceStride = 1;  // node count of the model
+uniform int instanceListBase;
+uniform vec3 boundsCenter;       // bounding sphere, root node space
+uniform float boundsRadius;
+uniform int frameGrid;
+uniform vec3 camPos;
+uniform mat4 viewProjection;
+
+// view direction -> [-1, 1] octahedral coordinate, inverse of OctahedralDecode in ImpostorRenderer.cpp
+vec2 OctahedralEncode(vec3 d)
+{
+    d /= abs(d.x) + abs(d.y) + abs(d.z);
+    vec2 p = d.xz;
+    if (d.y < 0.0)
+    {
+        vec2 signs = vec2(p.x >= 0.0 ? 1.0 : -1.0, p.y >= 0.0 ? 1.0 : -1.0);
+        p = (1.0 - abs(p.yx)) * signs;
+    }
+    return p;
+}
+
+void main()
+{
+    uvec2 entry = instanceList[instanceListBase + gl_InstanceID];
+    fObject = objectIndex + int(entry.x) * instanceStride;
+    fFade = uintBitsToFloat(entry.y);
+    ObjectTransform object = transforms[fObject];
+
+    // everything in root node space, the quad faces the camera like the baked frames faced their eye
+    vec3 worldCenter = vec3(object.model * vec4(boundsCenter, 1.0));
+    vec3 viewDir = normalize(inverse(mat3(object.model)) * (camPos - worldCenter));
+    vec3 up = abs(viewDir.y) > 0.999 ? vec3(0.0, 0.0, 1.0) : vec3(0.0, 1.0, 0.0);
+    vec3 right = normalize(cross(up, viewDir));
+    up = cross(viewDir, right);
+
+    vec2 corner = vec2(gl_VertexID & 1, gl_VertexID >> 1) * 2.0 - 1.0;
+    fRootPos = boundsCenter + (right * corner.x + up * corner.y) * boundsRadius;
+    fUV = corner * 0.5 + 0.5;
+    fViewDir = viewDir;
+
+    // the four frames around the view direction, bilinear weights between them
+    vec2 grid = (OctahedralEncode(viewDir) * 0.5 + 0.5) * frameGrid - 0.5;
+    ivec2 lower = clamp(ivec2(floor(grid)), ivec2(0), ivec2(frameGrid - 1));
+    ivec2 upper = min(lower + 1, ivec2(frameGrid - 1));
+    fFrames = ivec4(lower, upper);
+    fFrameBlend = clamp(grid - vec2(lower), 0.0, 1.0);
+
+    gl_Position = viewProjection * object.model * vec4(fRootPos, 1.0);
+}
@@ -0,0 +1,18 @@
+#version 450 core
+
+in vec2 fTex;
+in vec3 fNorm;
+
+layout(location = 0) out vec4 albedo;
+layout(location = 1) out vec4 normalDepth;
+
+uniform sampler2D texture_diffuse1;
+
+void main()
+{
+    // unlit, impostor.frag shades with the stored normal
+    albedo = vec4(texture(texture_diffuse1, fTex).rgb, 1.0);
+
+    // orthographic depth is linear across the bounding sphere
+    normalDepth = vec4(normalize(fNorm) * 0.5 + 0.5, gl_FragCoord.z);
+}
@@ -0,0 +1,34 @@
+#version 450 core
+
+layout(location = 0) in vec3 vPos;
+layout(location = 1) in vec3 vNorm;
+layout(location = 2) in vec2 vTex;
+
+out vec2 fTex;
+out vec3 fNorm;
+
+struct ObjectTransform
+{
+    mat4 model;
+    mat3 normal;
+    vec4 color;
+};
+
+// root node space matrices of the baked model
+layout(std430, binding = 0) readonly buffer Transforms
+{
+    ObjectTransform transforms[];
+};
+
+uniform int objectIndex;
+uniform int instanceStride = 1;
+uniform mat4 viewProjection;  // orthographic view of one atlas frame
+
+void main()
+{
+    ObjectTransform object = transforms[objectIndex];
+    gl_Position = viewProjection * object.model * vec4(vPos, 1.0);
+
+    fNorm = object.normal * vNorm;
+    fTex = vTex;
+}
@@ -4,11 +4,25 @@ layout(location = 0) in vec3 vPos;
 layout(location = 1) in vec3 vNorm;
 layout(location = 2) in vec2 vTex;
 
-uniform mat4 model;
+struct ObjectTransform
+{
+    mat4 model;
+    mat3 normal;
+    vec4 color;
+};
+
+layout(std430, binding = 0) readonly buffer Transforms
+{
+    ObjectTransform transforms[];
+};
+
+uniform int objectIndex;
+uniform int instanceStride = 1;
 uniform mat4 view;
 uniform mat4 projection;
 
 void main()
 {
+    mat4 model = transforms[objectIndex + gl_InstanceID * instanceStride].model;
     gl_Position = projection * view * model * vec4(vPos, 1.0);
 }
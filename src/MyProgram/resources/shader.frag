@@ -1,20 +1,102 @@
 #version 450 core
+#extension GL_ARB_bindless_texture : enable
+
+#ifdef TEXTURE_FEEDBACK
+// the feedback atomics would move the depth test after the shader otherwise, hidden fragments would be shaded
+// and request mips. only used where nothing relies on a late test: the pass after the depth pre-pass
+// (GL_EQUAL, no depth writes) and GPU-driven draws (no dithered copies)
+layout(early_fragment_tests) in;
+#endif
 
 in vec2 fTex;
 in vec3 fNorm;
 in vec3 fFragPos;
-in vec4 fFragPosLightSpace;
+flat in vec4 fColor;
+flat in float fFade;
+flat in int fMaterialLayer;
 
 out vec4 fragColor;
 
 uniform vec3 camPos;
-uniform vec3 lightPos;
 
-uniform vec3 lightColor;
+uniform vec3 lightColor;  // ambient
+
+struct Light
+{
+    vec4 positionRadius;
+    vec4 color;
+    vec4 direction;
+    vec4 params;  // x: spot inner cos, y: spot outer cos, z: shadow map index (-1: none)
+};
+
+layout(std430, binding = 1) readonly buffer Lights
+{
+    Light lights[];
+};
+
+// offset/count into lightIndices per cluster
+layout(std430, binding = 2) readonly buffer ClusterGrid
+{
+    uvec2 clusters[];
+};
+
+layout(std430, binding = 3) readonly buffer LightIndices
+{
+    uint lightIndices[];
+};
+
+struct Shadow
+{
+    mat4 viewProjection;
+    vec4 rect;  // xy: uv offset, zw: uv scale of the light's shadow atlas tile
+};
+
+layout(std430, binding = 4) readonly buffer Shadows
+{
+    Shadow shadows[];
+};
+
+uniform uvec3 clusterCount;
+uniform vec2 clusterTileSize;     // in pixels
+uniform vec2 clusterDepthParams;  // slice = log(depth) * x + y
+uniform vec2 nearFar;
 
 uniform sampler2D texture_diffuse1;
+// GPU-driven draws of meshes packed by MaterialArrays, the layer comes with the draw
+uniform bool materialArray = false;
+uniform sampler2DArray materialLayers;
 uniform sampler2D shadowMap;
 
+// mip streaming feedback, see TextureFeedback.h, with TEXTURE_FEEDBACK only. -1: the texture isn't streamed
+uniform int texture_diffuse1_feedback = -1;
+uniform vec2 texture_diffuse1_size;  // at full resolution
+uniform int feedbackPhase;           // the pixel of each 4x4 that writes this frame
+
+#ifdef TEXTURE_FEEDBACK
+layout(std430, binding = 13) buffer Feedback
+{
+    uint requestedLevels[];
+};
+#endif
+
+#ifdef GL_ARB_bindless_texture
+// bindless material textures, see BindlessMaterials.h. -1: the textures are bound
+uniform int materialIndex = -1;
+
+struct Material
+{
+    uvec2 diffuse;  // texture handle
+    int feedbackId;
+    int padding;
+    vec2 size;
+};
+
+layout(std430, binding = 14) readonly buffer Materials
+{
+    Material materials[];
+};
+#endif
+
 vec2 poissonDisk[16] = vec2[](
     vec2(-0.94201624, -0.39906216),
     vec2(0.94558609, -0.76890725),
@@ -41,9 +123,65 @@ float random(vec3 seed, int i)
     return fract(sin(dot_product) * 43758.5453);
 }
 
+// the mip level the hardware would pick at full resolution, on a sparse rotating pixel subset
+void WriteFeedback()
+{
+#ifdef TEXTURE_FEEDBACK
+    int feedbackId = texture_diffuse1_feedback;
+    vec2 size = texture_diffuse1_size;
+#ifdef GL_ARB_bindless_texture
+    if (materialIndex >= 0)
+    {
+        feedbackId = materials[materialIndex].feedbackId;
+        size = materials[materialIndex].size;
+    }
+#endif
+
+    vec2 dx = dFdx(fTex * size);
+    vec2 dy = dFdy(fTex * size);
+    float level = 0.5 * log2(max(max(dot(dx, dx), dot(dy, dy)), 1.0));
+
+    ivec2 p = ivec2(gl_FragCoord.xy) & 3;
+    if (feedbackId >= 0 && p.y * 4 + p.x == feedbackPhase)
+        atomicMin(requestedLevels[feedbackId], uint(level));
+#endif
+}
+
+vec3 SampleDiffuse()
+{
+    if (materialArray)
+        return texture(materialLayers, vec3(fTex, fMaterialLayer)).rgb;
+#ifdef GL_ARB_bindless_texture
+    if (materialIndex >= 0)
+        return texture(sampler2D(materials[materialIndex].diffuse), fTex).rgb;
+#endif
+    return texture(texture_diffuse1, fTex).rgb;
+}
+
+// 4x4 ordered dither, must match impostor.frag
+float DitherThreshold()
+{
+    const float bayer[16] = float[](0, 8, 2, 10, 12, 4, 14, 6, 3, 11, 1, 9, 15, 7, 13, 5);
+    ivec2 p = ivec2(gl_FragCoord.xy) & 3;
+    return (bayer[p.y * 4 + p.x] + 0.5) / 16.0;
+}
+
+uint ClusterIndex()
+{
+    // linear view depth from the window depth
+    float ndcZ = gl_FragCoord.z * 2.0 - 1.0;
+    float depth = 2.0 * nearFar.x * nearFar.y / (nearFar.y + nearFar.x - ndcZ * (nearFar.y - nearFar.x));
+
+    uint slice = uint(clamp(log(depth) * clusterDepthParams.x + clusterDepthParams.y, 0.0, float(clusterCount.z - 1)));
+    uvec2 tile = min(uvec2(gl_FragCoord.xy / clusterTileSize), clusterCount.xy - 1);
+    return tile.x + clusterCount.x * (tile.y + clusterCount.y * slice);
+}
 
-float ShadowCalc(vec4 fragPosLightSpace)
+float ShadowCalc(int shadowIndex, vec3 lightDir)
 {
+    Shadow tile = shadows[shadowIndex];
+    vec4 fragPosLightSpace = tile.viewProjection * vec4(fFragPos, 1.0);
+
     // perform perspective divide
     vec3 projCoords = fragPosLightSpace.xyz / fragPosLightSpace.w;
     if (projCoords.z > 1.0)
@@ -53,24 +191,31 @@ float ShadowCalc(vec4 fragPosLightSpace)
 
     // transform to [0,1] range
     projCoords = projCoords * 0.5 + 0.5;
-    // get closest depth value from light's perspective (using [0,1] range fragPosLight as coords)
-    float closestDepth = texture(shadowMap, projCoords.xy).r;
+    if (any(lessThan(projCoords.xy, vec2(0.0))) || any(greaterThan(projCoords.xy, vec2(1.0))))
+    {
+        return 0.0;
+    }
+
+    // into the tile, PCF taps must not read the neighbouring tiles
+    vec2 texelSize = 1.0 / textureSize(shadowMap, 0);
+    vec2 tileMin = tile.rect.xy + 0.5 * texelSize;
+    vec2 tileMax = tile.rect.xy + tile.rect.zw - 0.5 * texelSize;
+    projCoords.xy = tile.rect.xy + projCoords.xy * tile.rect.zw;
 
     // get depth of current fragment from light's perspective
     float currentDepth = projCoords.z;
 
     // check whether current frag pos is in shadow
-    vec3 lightDir = normalize(lightPos - fFragPos);
     float bias = max(0.05 * (1.0 - dot(fNorm, lightDir)), 0.005);
     float shadow = 0.0;
-    vec2 texelSize = 1.0 / textureSize(shadowMap, 0);
     int pcfCount = 2;
 
     for (int x = -pcfCount; x <= pcfCount; ++x)
     {
         for (int y = -pcfCount; y <= pcfCount; ++y)
         {
-            float pcfDepth = texture(shadowMap, projCoords.xy + vec2(x, y) * texelSize).r;
+            vec2 uv = clamp(projCoords.xy + vec2(x, y) * texelSize, tileMin, tileMax);
+            float pcfDepth = texture(shadowMap, uv).r;
             shadow += currentDepth - bias > pcfDepth ? 1.0 : 0.0;
         }
     }
@@ -81,23 +226,48 @@ float ShadowCalc(vec4 fragPosLightSpace)
 
 void main()
 {
-    vec3 objectColor = texture(texture_diffuse1, fTex).rgb;
+    // derivatives are taken before any pixel of the quad discards
+    WriteFeedback();
+
+    // copies crossfading to their impostor keep the complementary pixels
+    if (fFade < DitherThreshold())
+        discard;
+
+    vec3 objectColor = SampleDiffuse() * fColor.rgb;
 
     vec3 ambient = 0.1 * lightColor;
+    vec3 viewDir = normalize(0.0 - fFragPos);
 
-    vec3 lightDir = normalize(lightPos - fFragPos);
+    // only the lights touching this fragment's cluster
+    vec3 lighting = vec3(0.0);
+    uvec2 cluster = clusters[ClusterIndex()];
+    for (uint i = 0; i < cluster.y; i++)
+    {
+        Light light = lights[lightIndices[cluster.x + i]];
 
-    vec3 diffuse = max(dot(fNorm, lightDir), 0.0) * lightColor;
+        vec3 toLight = light.positionRadius.xyz - fFragPos;
+        float dist = length(toLight);
+        vec3 lightDir = toLight / dist;
 
-    vec3 viewDir = normalize(0.0 - fFragPos);
-    float spec = 0.0;
-    vec3 halfwayDir = normalize(lightDir + viewDir);
-    spec = pow(max(dot(fNorm, halfwayDir), 0.0), 64.0);
-    vec3 specular = spec * lightColor;
+        // smooth cut-off at the light's radius, the cluster assignment ignores everything beyond
+        float window = clamp(1.0 - pow(dist / light.positionRadius.w, 4.0), 0.0, 1.0);
+        float spot = smoothstep(light.params.y, light.params.x, dot(-lightDir, light.direction.xyz));
+        float attenuation = window * window * spot;
+        if (attenuation <= 0.0)
+            continue;
+
+        vec3 diffuse = max(dot(fNorm, lightDir), 0.0) * light.color.rgb;
 
-    float shadow = ShadowCalc(fFragPosLightSpace);
+        vec3 halfwayDir = normalize(lightDir + viewDir);
+        float spec = pow(max(dot(fNorm, halfwayDir), 0.0), 64.0);
+        vec3 specular = spec * light.color.rgb;
+
+        float shadow = light.params.z >= 0.0 ? ShadowCalc(int(light.params.z), lightDir) : 0.0;
+
+        lighting += (1 - shadow) * (diffuse + specular) * attenuation;
+    }
 
     fragColor = vec4(
-        (ambient + (1 - shadow) * (diffuse + specular)) * objectColor,
+        (ambient + lighting) * objectColor,
         1.0);
 }
\ No newline at end of file
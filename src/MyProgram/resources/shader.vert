@@ -3,25 +3,125 @@
 layout(location = 0) in vec3 vPos;
 layout(location = 1) in vec3 vNorm;
 layout(location = 2) in vec2 vTex;
+layout(location = 3) in uvec2 vObject;  // GPU-driven draws only, per draw through baseInstance. x: transform, y: material layer
 
 out vec2 fTex;
 out vec3 fNorm;
 out vec3 fFragPos;
-out vec4 fFragPosLightSpace;
+flat out vec4 fColor;
+flat out float fFade;
+flat out int fMaterialLayer;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
-uniform mat4 lightSpaceMatrix;
+struct ObjectTransform
+{
+    mat4 model;
+    mat3 normal;
+    vec4 color;
+};
+
+layout(std430, binding = 0) readonly buffer Transforms
+{
+    ObjectTransform transforms[];
+};
+
+// copies kept by the impostor split, x: copy, y: mesh fade as float bits
+layout(std430, binding = 10) readonly buffer InstanceList
+{
+    uvec2 instanceList[];
+};
+
+// vertex pulling, see VertexPool. vertices are fetched from gl_VertexID + vertexBase
+layout(std430, binding = 11) readonly buffer FloatVertices
+{
+    float floatVertices[];  // Vertex: position, normal, texCoords
+};
+
+layout(std430, binding = 12) readonly buffer QuantizedVertices
+{
+    uvec4 quantizedVertices[];  // unorm16 position xy, z | octahedral snorm16 normal | unorm16 uv
+};
+
+uniform int vertexFetch = 0;  // 0: attributes, 1: float SSBO, 2: quantized SSBO
+uniform int vertexBase;
+uniform vec3 positionMin;
+uniform vec3 positionExtent;
+uniform vec4 texCoordRange;  // xy: min, zw: extent
+
+uniform int objectIndex;
+uniform int instanceStride = 1;  // node count of the drawn model
+uniform int instanceListBase = -1;  // -1: consecutive copies
+uniform bool drawObjectAttribute = false;
+uniform mat4 viewProjection;
 
+// must match depth.vert exactly, the depth pre-pass is tested with GL_EQUAL
+invariant gl_Position;
+
+// must match depth.vert, both shaders compute the same position
+vec3 FetchPosition()
+{
+    int v = gl_VertexID + vertexBase;
+    if (vertexFetch == 1)
+        return vec3(floatVertices[v * 8], floatVertices[v * 8 + 1], floatVertices[v * 8 + 2]);
+    if (vertexFetch == 2)
+    {
+        uvec4 q = quantizedVertices[v];
+        return positionMin + vec3(unpackUnorm2x16(q.x), unpackUnorm2x16(q.y).x) * positionExtent;
+    }
+    return vPos;
+}
+
+vec3 OctahedralNormal(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (n.z < 0.0)
+        n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+    return normalize(n);
+}
+
+void FetchNormalTexCoords(out vec3 normal, out vec2 texCoords)
+{
+    int v = gl_VertexID + vertexBase;
+    if (vertexFetch == 1)
+    {
+        normal = vec3(floatVertices[v * 8 + 3], floatVertices[v * 8 + 4], floatVertices[v * 8 + 5]);
+        texCoords = vec2(floatVertices[v * 8 + 6], floatVertices[v * 8 + 7]);
+    }
+    else if (vertexFetch == 2)
+    {
+        uvec4 q = quantizedVertices[v];
+        normal = OctahedralNormal(unpackSnorm2x16(q.z));
+        texCoords = texCoordRange.xy + unpackUnorm2x16(q.w) * texCoordRange.zw;
+    }
+    else
+    {
+        normal = vNorm;
+        texCoords = vTex;
+    }
+}
 
 void main()
 {
-    gl_Position = projection * view * model * vec4(vPos, 1.0);
+    // instanced draws read consecutive objects or the listed ones, GPU-driven draws carry their own index
+    int copy = gl_InstanceID;
+    fFade = 1.0;
+    if (instanceListBase >= 0)
+    {
+        uvec2 entry = instanceList[instanceListBase + gl_InstanceID];
+        copy = int(entry.x);
+        fFade = uintBitsToFloat(entry.y);
+    }
+    int index = drawObjectAttribute ? int(vObject.x) : objectIndex + copy * instanceStride;
+    ObjectTransform object = transforms[index];
+    vec4 worldPos = object.model * vec4(FetchPosition(), 1.0);
+
+    gl_Position = viewProjection * worldPos;
 
-    fFragPos = vec3(model * vec4(vPos, 1.0));
-    fNorm = mat3(transpose(inverse(model))) * vNorm;
-    fFragPosLightSpace = lightSpaceMatrix * vec4(fFragPos, 1.0);
+    fFragPos = vec3(worldPos);
+    // normal matrix is computed on the CPU, once per object
+    vec3 normal;
+    FetchNormalTexCoords(normal, fTex);
+    fNorm = object.normal * normal;
 
-    fTex = vTex;
+    fColor = object.color;
+    fMaterialLayer = drawObjectAttribute ? int(vObject.y) : 0;
 }
@@ -0,0 +1,236 @@
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "OcclusionCuller.h"
+#include "ThreadPool.h"
+
+// OcclusionCuller checks against known occluders, then timings of a larger scene.
+// CPU only, no window or GL. exits with the number of failed checks
+// OcclusionCullerTest --benchmark: more occluders and repetitions
+
+static int sFailures = 0;
+
+static void Check(bool condition, const char* name)
+{
+    fmt::print("[{}] {}\n", condition ? "PASS" : "FAIL", name);
+    if (!condition)
+        sFailures++;
+}
+
+// camera at z = 5 looking down -z, 2:1 like the culler's default buffer
+static glm::mat4 MakeViewProjection()
+{
+    glm::mat4 projection = glm::perspective(glm::radians(60.0f), 2.0f, 0.1f, 100.0f);
+    glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 0.0f, 5.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    return projection * view;
+}
+
+// quad in the z = "z" plane, counter-clockwise towards the camera unless "backFacing"
+static void AddWall(OcclusionCuller& culler, float z, float halfWidth, float halfHeight, bool backFacing = false)
+{
+    const glm::vec3 positions[] = {
+        glm::vec3(-halfWidth, -halfHeight, z),
+        glm::vec3(halfWidth, -halfHeight, z),
+        glm::vec3(halfWidth, halfHeight, z),
+        glm::vec3(-halfWidth, halfHeight, z),
+    };
+    const uint32_t front[] = { 0, 1, 2, 0, 2, 3 };
+    const uint32_t back[] = { 0, 2, 1, 0, 3, 2 };
+    culler.AddOccluder(positions, 4, backFacing ? back : front, 6, glm::mat4(1.0f));
+}
+
+static bool IsBoxVisible(OcclusionCuller& culler, const glm::vec3& center, const glm::vec3& halfSize)
+{
+    return culler.IsVisible(center - halfSize, center + halfSize);
+}
+
+// edge and depth equations of a screen space triangle, set up the way AddOccluder does
+static OccluderTriangle MakeTriangle(const float* x, const float* y, const float* z, int width, int height)
+{
+    OccluderTriangle tri;
+    tri.minX = std::max(0, static_cast<int>(std::floor(std::min({ x[0], x[1], x[2] }))));
+    tri.maxX = std::min(width - 1, static_cast<int>(std::ceil(std::max({ x[0], x[1], x[2] }))));
+    tri.minY = std::max(0, static_cast<int>(std::floor(std::min({ y[0], y[1], y[2] }))));
+    tri.maxY = std::min(height - 1, static_cast<int>(std::ceil(std::max({ y[0], y[1], y[2] }))));
+    for (int k = 0; k < 3; k++)
+    {
+        int n = (k + 1) % 3;
+        tri.edgeA[k] = -(y[n] - y[k]);
+        tri.edgeB[k] = x[n] - x[k];
+        tri.edgeC[k] = -(tri.edgeA[k] * x[k] + tri.edgeB[k] * y[k]);
+    }
+    float invArea = 1.0f / ((x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]));
+    tri.depthA = (tri.edgeA[1] * z[0] + tri.edgeA[2] * z[1] + tri.edgeA[0] * z[2]) * invArea;
+    tri.depthB = (tri.edgeB[1] * z[0] + tri.edgeB[2] * z[1] + tri.edgeB[0] * z[2]) * invArea;
+    tri.depthC = (tri.edgeC[1] * z[0] + tri.edgeC[2] * z[1] + tri.edgeC[0] * z[2]) * invArea;
+    return tri;
+}
+
+static void TestVisibility(ThreadPool& pool)
+{
+    OcclusionCuller culler;
+    glm::mat4 viewProjection = MakeViewProjection();
+    const glm::vec3 small(0.25f);
+
+    culler.BeginFrame(viewProjection);
+    culler.Rasterize(pool);
+    Check(IsBoxVisible(culler, glm::vec3(0.0f, 0.0f, -3.0f), small), "nothing rasterized, everything visible");
+
+    culler.BeginFrame(viewProjection);
+    AddWall(culler, 0.0f, 2.0f, 1.0f);
+    culler.Rasterize(pool);
+    Check(culler.GetOccluderTriangleCount() == 2, "wall adds two triangles");
+    Check(!IsBoxVisible(culler, glm::vec3(0.0f, 0.0f, -3.0f), small), "box behind the wall is culled");
+    Check(!IsBoxVisible(culler, glm::vec3(1.0f, 0.5f, -0.5f), glm::vec3(0.2f)), "box just behind the wall, off center, is culled");
+    Check(IsBoxVisible(culler, glm::vec3(0.0f, 0.0f, 2.0f), small), "box in front of the wall is visible");
+    Check(IsBoxVisible(culler, glm::vec3(0.0f, 0.0f, -0.1f), small), "box crossing the wall is visible");
+    Check(IsBoxVisible(culler, glm::vec3(6.0f, 0.0f, -3.0f), small), "box beside the wall is visible");
+    // the wall's edge is at x = 3.2 this far back
+    Check(IsBoxVisible(culler, glm::vec3(3.2f, 0.0f, -3.0f), small), "box behind the wall's edge is visible");
+    Check(IsBoxVisible(culler, glm::vec3(0.0f, 0.0f, -3.0f), glm::vec3(4.0f, 0.25f, 0.25f)), "box wider than the wall is visible");
+    Check(IsBoxVisible(culler, glm::vec3(0.0f, 0.0f, 5.0f), small), "box around the camera is visible");
+    Check(culler.GetTestedCount() == 8 && culler.GetCulledCount() == 2, "tested and culled counts");
+
+    // an occluder may only under-cover: faces pointing away and faces through the near plane are dropped
+    culler.BeginFrame(viewProjection);
+    AddWall(culler, 0.0f, 2.0f, 1.0f, true);
+    culler.Rasterize(pool);
+    Check(culler.GetOccluderTriangleCount() == 0, "back facing wall is dropped");
+    Check(IsBoxVisible(culler, glm::vec3(0.0f, 0.0f, -3.0f), small), "box behind a back facing wall is visible");
+
+    culler.BeginFrame(viewProjection);
+    AddWall(culler, 5.0f, 2.0f, 1.0f);
+    culler.Rasterize(pool);
+    Check(culler.GetOccluderTriangleCount() == 0, "wall through the near plane is dropped");
+
+    // the nearest occluder wins where two overlap
+    culler.BeginFrame(viewProjection);
+    AddWall(culler, -4.0f, 4.0f, 2.0f);
+    AddWall(culler, 0.0f, 0.5f, 0.5f);
+    culler.Rasterize(pool);
+    Check(!IsBoxVisible(culler, glm::vec3(0.0f, 0.0f, -2.0f), glm::vec3(0.1f)), "box between two walls, behind the small one, is culled");
+    Check(IsBoxVisible(culler, glm::vec3(1.5f, 0.0f, -2.0f), glm::vec3(0.1f)), "box between two walls, beside the small one, is visible");
+    Check(!IsBoxVisible(culler, glm::vec3(1.5f, 0.0f, -6.0f), glm::vec3(0.1f)), "box behind the large wall is culled");
+}
+
+static void TestKernels()
+{
+    // the AVX2 kernel has to write what the scalar one writes, up to the rounding of its fused multiply-adds
+    const int width = 64;
+    const int height = 32;
+    std::vector<float> scalar(width * height, 1.0f);
+    std::vector<float> avx2(width * height, 1.0f);
+
+    const float x[][3] = { { 1.0f, 60.5f, 30.2f }, { 7.3f, 20.1f, 9.9f }, { 40.0f, 63.9f, 63.9f } };
+    const float y[][3] = { { 1.0f, 3.5f, 30.7f }, { 2.2f, 5.0f, 28.4f }, { 0.0f, 0.0f, 31.9f } };
+    const float z[][3] = { { 0.3f, 0.6f, 0.9f }, { 0.2f, 0.2f, 0.2f }, { 0.8f, 0.1f, 0.5f } };
+    bool avx2Available = OcclusionCuller().IsUsingAVX2();
+    for (int i = 0; i < 3; i++)
+    {
+        OccluderTriangle tri = MakeTriangle(x[i], y[i], z[i], width, height);
+        RasterizeOccluderScalar(tri, scalar.data(), width, 0, height - 1);
+        if (avx2Available)
+            RasterizeOccluderAVX2(tri, avx2.data(), width, 0, height - 1);
+    }
+
+    size_t covered = std::count_if(scalar.begin(), scalar.end(), [](float depth) { return depth < 1.0f; });
+    Check(covered > 0 && covered < scalar.size(), "scalar kernel covers part of the buffer");
+    if (avx2Available)
+    {
+        bool same = true;
+        for (size_t i = 0; i < scalar.size(); i++)
+            same &= std::abs(scalar[i] - avx2[i]) < 1e-5f;
+        Check(same, "AVX2 kernel matches the scalar kernel");
+    }
+    else
+    {
+        fmt::print("[SKIP] no AVX2, kernel comparison\n");
+    }
+}
+
+static void Benchmark(ThreadPool& pool, bool large)
+{
+    // a grid of wall pieces in front of a field of boxes, half of them behind the walls
+    int grid = large ? 128 : 32;
+    int repetitions = large ? 200 : 20;
+    int boxCount = large ? 100000 : 10000;
+
+    std::vector<glm::vec3> positions;
+    std::vector<uint32_t> indices;
+    for (int j = 0; j < grid; j++)
+    {
+        for (int i = 0; i < grid; i++)
+        {
+            float x0 = -4.0f + 4.0f * i / grid;
+            float y0 = -2.0f + 4.0f * j / grid;
+            float x1 = -4.0f + 4.0f * (i + 1) / grid;
+            float y1 = -2.0f + 4.0f * (j + 1) / grid;
+            uint32_t first = static_cast<uint32_t>(positions.size());
+            positions.insert(positions.end(), { glm::vec3(x0, y0, 0.0f), glm::vec3(x1, y0, 0.0f), glm::vec3(x1, y1, 0.0f), glm::vec3(x0, y1, 0.0f) });
+            indices.insert(indices.end(), { first, first + 1, first + 2, first, first + 2, first + 3 });
+        }
+    }
+
+    std::vector<glm::vec3> boxes(boxCount);
+    uint32_t seed = 12345;
+    auto random = [&seed]()
+    {
+        seed = seed * 1664525u + 1013904223u;
+        return static_cast<float>(seed >> 8) / static_cast<float>(1 << 24);
+    };
+    for (glm::vec3& box : boxes)
+        box = glm::vec3(-4.0f + 8.0f * random(), -2.0f + 4.0f * random(), -1.0f - 4.0f * random());
+
+    OcclusionCuller culler;
+    glm::mat4 viewProjection = MakeViewProjection();
+    using Clock = std::chrono::steady_clock;
+    double setupMs = 0.0, rasterizeMs = 0.0, testMs = 0.0;
+    size_t culled = 0;
+    for (int r = 0; r < repetitions; r++)
+    {
+        Clock::time_point start = Clock::now();
+        culler.BeginFrame(viewProjection);
+        culler.AddOccluder(positions.data(), positions.size(), indices.data(), indices.size(), glm::mat4(1.0f));
+        Clock::time_point added = Clock::now();
+        culler.Rasterize(pool);
+        Clock::time_point rasterized = Clock::now();
+        for (const glm::vec3& box : boxes)
+            culler.IsVisible(box - glm::vec3(0.05f), box + glm::vec3(0.05f));
+        Clock::time_point tested = Clock::now();
+
+        setupMs += std::chrono::duration<double, std::milli>(added - start).count();
+        rasterizeMs += std::chrono::duration<double, std::milli>(rasterized - added).count();
+        testMs += std::chrono::duration<double, std::milli>(tested - rasterized).count();
+        culled = culler.GetCulledCount();
+    }
+
+    fmt::print("[BENCH] {} occluder triangles, {} boxes, {} threads, {}\n",
+        culler.GetOccluderTriangleCount(), boxes.size(), pool.GetThreadCount() + 1, culler.IsUsingAVX2() ? "AVX2" : "scalar");
+    fmt::print("[BENCH] setup {:.3f} ms, rasterize {:.3f} ms, test {:.3f} ms ({:.1f} ns per box), {} culled\n",
+        setupMs / repetitions, rasterizeMs / repetitions, testMs / repetitions, testMs / repetitions * 1e6 / boxes.size(), culled);
+
+    // the wall covers x in [-4, 0], boxes behind it go, the others stay
+    Check(culled > 0 && culled < boxes.size(), "benchmark scene culls part of the boxes");
+}
+
+int main(int argc, char** argv)
+{
+    bool large = argc > 1 && std::string(argv[1]) == "--benchmark";
+
+    ThreadPool pool;
+    TestVisibility(pool);
+    TestKernels();
+    Benchmark(pool, large);
+
+    fmt::print("{} failed\n", sFailures);
+    return sFailures;
+}